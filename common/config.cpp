@@ -26,10 +26,50 @@ const std::string kCfgListenIp("listen_ip");
 const std::string kCfgListenPort("listen_port");
 const std::string kCfgWorkThreadNum("work_thread_num");
 
+const std::string kCfgScheduleWeightHigh("schedule_weight_high");
+const std::string kCfgScheduleWeightMiddle("schedule_weight_middle");
+const std::string kCfgScheduleWeightLow("schedule_weight_low");
+const std::string kCfgScheduleAgingTime("schedule_aging_time");
+
+const std::string kCfgAdmissionQueueSoftLimit("admission_queue_soft_limit");
+const std::string kCfgAdmissionQueueHardLimit("admission_queue_hard_limit");
+const std::string kCfgAdmissionMemorySoftLimit("admission_memory_soft_limit");
+const std::string kCfgAdmissionMemoryHardLimit("admission_memory_hard_limit");
+const std::string kCfgAdmissionPauseNum("admission_pause_num");
+const std::string kCfgSlowDownTime("slow_down_time");
+
+const std::string kCfgInlineCpuBudget("inline_cpu_budget");
+
+const std::string kCfgReactorCpus("reactor_cpus");
+
+const std::string kCfgBroadcastFanout("broadcast_fanout");
+const std::string kCfgBroadcastTtl("broadcast_ttl");
+const std::string kCfgBroadcastSeenTime("broadcast_seen_time");
+const std::string kCfgBroadcastMode("broadcast_mode");
+
+const std::string kCfgPublicNodeProbeTimeout("public_node_probe_timeout");
+const std::string kCfgPublicNodeReselectTime("public_node_reselect_time");
+const std::string kCfgPublicNodeSwitchRatio("public_node_switch_ratio");
+
+const std::string kCfgPeerCacheSaveTime("peer_cache_save_time");
+const std::string kCfgPeerCacheExpireTime("peer_cache_expire_time");
+
+const std::string kCfgHeightAnnounceInterval("height_announce_interval");
+const std::string kCfgFeeAnnounceInterval("fee_announce_interval");
+const std::string kCfgStateHeartbeatPiggyback("state_heartbeat_piggyback");
+
+const std::string kCfgBucketRefreshTime("bucket_refresh_time");
+
 const std::string kCfgPublicNode("public_node");
 const std::string kCfgPublicNodeIp("ip");
 const std::string kCfgPublicNodePort("port");
 
+const std::string kCfgWorkPool("work_pool");
+const std::string kCfgWorkPoolThreadNum("thread_num");
+const std::string kCfgWorkPoolQueueLimit("queue_limit");
+const std::string kCfgWorkPoolMaxThreadNum("max_thread_num");
+const std::string kCfgWorkPoolCpus("cpus");
+
 void from_json(const nlohmann::json &json, PublicNode &public_node)
 {
     json.at(kCfgPublicNodeIp).get_to(public_node.ip);
@@ -41,6 +81,21 @@ void to_json(nlohmann::json &json, const PublicNode &public_node)
     json[kCfgPublicNodePort] = public_node.port;
 }
 
+void from_json(const nlohmann::json &json, WorkPoolConfig &work_pool)
+{
+    json.at(kCfgWorkPoolThreadNum).get_to(work_pool.thread_num);
+    json.at(kCfgWorkPoolQueueLimit).get_to(work_pool.queue_limit);
+    work_pool.max_thread_num = json.value(kCfgWorkPoolMaxThreadNum, work_pool.thread_num);
+    work_pool.cpus = json.value(kCfgWorkPoolCpus, std::string());
+}
+void to_json(nlohmann::json &json, const WorkPoolConfig &work_pool)
+{
+    json[kCfgWorkPoolThreadNum] = work_pool.thread_num;
+    json[kCfgWorkPoolQueueLimit] = work_pool.queue_limit;
+    json[kCfgWorkPoolMaxThreadNum] = work_pool.max_thread_num;
+    json[kCfgWorkPoolCpus] = work_pool.cpus;
+}
+
 Config::Config()
 {
     SetDefaultVal();
@@ -92,6 +147,17 @@ void Config::add_public_node(const PublicNode &public_node)
     public_node_list_.insert(public_node);
 }
 
+bool Config::work_pool(const std::string &name, WorkPoolConfig &out_conf) const
+{
+    auto it = work_pools_.find(name);
+    if (work_pools_.end() == it)
+    {
+        return false;
+    }
+    out_conf = it->second;
+    return true;
+}
+
 bool Config::ReadFile()
 {
     std::ifstream fconf(file_name_);
@@ -126,6 +192,44 @@ void Config::SetDefaultVal()
     listen_ip_ = "0.0.0.0";
     work_thread_num_ = 10;
 
+    schedule_weight_high_ = 16;
+    schedule_weight_middle_ = 4;
+    schedule_weight_low_ = 1;
+    schedule_aging_time_ = 1000;
+
+    work_pools_.clear();
+    work_pools_["control"] = WorkPoolConfig{2, 10000, 2, ""};
+    work_pools_["RegisterNodeReq"] = WorkPoolConfig{2, 10000, 4, ""};
+
+    admission_queue_soft_limit_ = 50000;
+    admission_queue_hard_limit_ = 150000;
+    admission_memory_soft_limit_ = 0;
+    admission_memory_hard_limit_ = 0;
+    admission_pause_num_ = 2;
+    slow_down_time_ = 1000;
+
+    inline_cpu_budget_ = 2000;
+
+    reactor_cpus_.clear();
+
+    broadcast_fanout_ = 6;
+    broadcast_ttl_ = 4;
+    broadcast_seen_time_ = 300;
+    broadcast_mode_ = "tree";
+
+    public_node_probe_timeout_ = 2000;
+    public_node_reselect_time_ = 600;
+    public_node_switch_ratio_ = 50;
+
+    peer_cache_save_time_ = 60;
+    peer_cache_expire_time_ = 86400;
+
+    height_announce_interval_ = 1000;
+    fee_announce_interval_ = 5000;
+    state_heartbeat_piggyback_ = false;
+
+    bucket_refresh_time_ = 3600;
+
     std::vector<std::string> public_node_ip;
 #ifdef PRIMARYCHAIN
     public_node_ip.push_back("115.29.149.102");
@@ -218,6 +322,40 @@ bool Config::UpdateToJson()
     config_json_[kCfgListenPort] = listen_port_;
     config_json_[kCfgWorkThreadNum] = work_thread_num_;
 
+    config_json_[kCfgScheduleWeightHigh] = schedule_weight_high_;
+    config_json_[kCfgScheduleWeightMiddle] = schedule_weight_middle_;
+    config_json_[kCfgScheduleWeightLow] = schedule_weight_low_;
+    config_json_[kCfgScheduleAgingTime] = schedule_aging_time_;
+
+    config_json_[kCfgAdmissionQueueSoftLimit] = admission_queue_soft_limit_;
+    config_json_[kCfgAdmissionQueueHardLimit] = admission_queue_hard_limit_;
+    config_json_[kCfgAdmissionMemorySoftLimit] = admission_memory_soft_limit_;
+    config_json_[kCfgAdmissionMemoryHardLimit] = admission_memory_hard_limit_;
+    config_json_[kCfgAdmissionPauseNum] = admission_pause_num_;
+    config_json_[kCfgSlowDownTime] = slow_down_time_;
+
+    config_json_[kCfgInlineCpuBudget] = inline_cpu_budget_;
+
+    config_json_[kCfgReactorCpus] = reactor_cpus_;
+
+    config_json_[kCfgBroadcastFanout] = broadcast_fanout_;
+    config_json_[kCfgBroadcastTtl] = broadcast_ttl_;
+    config_json_[kCfgBroadcastSeenTime] = broadcast_seen_time_;
+    config_json_[kCfgBroadcastMode] = broadcast_mode_;
+
+    config_json_[kCfgPublicNodeProbeTimeout] = public_node_probe_timeout_;
+    config_json_[kCfgPublicNodeReselectTime] = public_node_reselect_time_;
+    config_json_[kCfgPublicNodeSwitchRatio] = public_node_switch_ratio_;
+
+    config_json_[kCfgPeerCacheSaveTime] = peer_cache_save_time_;
+    config_json_[kCfgPeerCacheExpireTime] = peer_cache_expire_time_;
+
+    config_json_[kCfgHeightAnnounceInterval] = height_announce_interval_;
+    config_json_[kCfgFeeAnnounceInterval] = fee_announce_interval_;
+    config_json_[kCfgStateHeartbeatPiggyback] = state_heartbeat_piggyback_;
+
+    config_json_[kCfgBucketRefreshTime] = bucket_refresh_time_;
+
     nlohmann::json public_node_list_json;
     nlohmann::json public_node_json;
     for (auto &public_node : public_node_list_)
@@ -226,6 +364,13 @@ bool Config::UpdateToJson()
         public_node_list_json.push_back(public_node_json);
     }
     config_json_[kCfgPublicNode] = public_node_list_json;
+
+    nlohmann::json work_pool_json;
+    for (auto &item : work_pools_)
+    {
+        work_pool_json[item.first] = item.second;
+    }
+    config_json_[kCfgWorkPool] = work_pool_json;
     return true;
 }
 
@@ -296,6 +441,106 @@ bool Config::UpdateToVar()
     {
         config_json_.at(kCfgWorkThreadNum).get_to(work_thread_num_);
     }
+    if (config_json_.end() != config_json_.find(kCfgScheduleWeightHigh))
+    {
+        config_json_.at(kCfgScheduleWeightHigh).get_to(schedule_weight_high_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgScheduleWeightMiddle))
+    {
+        config_json_.at(kCfgScheduleWeightMiddle).get_to(schedule_weight_middle_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgScheduleWeightLow))
+    {
+        config_json_.at(kCfgScheduleWeightLow).get_to(schedule_weight_low_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgScheduleAgingTime))
+    {
+        config_json_.at(kCfgScheduleAgingTime).get_to(schedule_aging_time_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgAdmissionQueueSoftLimit))
+    {
+        config_json_.at(kCfgAdmissionQueueSoftLimit).get_to(admission_queue_soft_limit_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgAdmissionQueueHardLimit))
+    {
+        config_json_.at(kCfgAdmissionQueueHardLimit).get_to(admission_queue_hard_limit_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgAdmissionMemorySoftLimit))
+    {
+        config_json_.at(kCfgAdmissionMemorySoftLimit).get_to(admission_memory_soft_limit_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgAdmissionMemoryHardLimit))
+    {
+        config_json_.at(kCfgAdmissionMemoryHardLimit).get_to(admission_memory_hard_limit_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgAdmissionPauseNum))
+    {
+        config_json_.at(kCfgAdmissionPauseNum).get_to(admission_pause_num_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgSlowDownTime))
+    {
+        config_json_.at(kCfgSlowDownTime).get_to(slow_down_time_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgInlineCpuBudget))
+    {
+        config_json_.at(kCfgInlineCpuBudget).get_to(inline_cpu_budget_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgReactorCpus))
+    {
+        config_json_.at(kCfgReactorCpus).get_to(reactor_cpus_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgBroadcastFanout))
+    {
+        config_json_.at(kCfgBroadcastFanout).get_to(broadcast_fanout_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgBroadcastTtl))
+    {
+        config_json_.at(kCfgBroadcastTtl).get_to(broadcast_ttl_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgBroadcastSeenTime))
+    {
+        config_json_.at(kCfgBroadcastSeenTime).get_to(broadcast_seen_time_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgBroadcastMode))
+    {
+        config_json_.at(kCfgBroadcastMode).get_to(broadcast_mode_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgPublicNodeProbeTimeout))
+    {
+        config_json_.at(kCfgPublicNodeProbeTimeout).get_to(public_node_probe_timeout_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgPublicNodeReselectTime))
+    {
+        config_json_.at(kCfgPublicNodeReselectTime).get_to(public_node_reselect_time_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgPublicNodeSwitchRatio))
+    {
+        config_json_.at(kCfgPublicNodeSwitchRatio).get_to(public_node_switch_ratio_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgPeerCacheSaveTime))
+    {
+        config_json_.at(kCfgPeerCacheSaveTime).get_to(peer_cache_save_time_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgPeerCacheExpireTime))
+    {
+        config_json_.at(kCfgPeerCacheExpireTime).get_to(peer_cache_expire_time_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgHeightAnnounceInterval))
+    {
+        config_json_.at(kCfgHeightAnnounceInterval).get_to(height_announce_interval_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgFeeAnnounceInterval))
+    {
+        config_json_.at(kCfgFeeAnnounceInterval).get_to(fee_announce_interval_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgStateHeartbeatPiggyback))
+    {
+        config_json_.at(kCfgStateHeartbeatPiggyback).get_to(state_heartbeat_piggyback_);
+    }
+    if (config_json_.end() != config_json_.find(kCfgBucketRefreshTime))
+    {
+        config_json_.at(kCfgBucketRefreshTime).get_to(bucket_refresh_time_);
+    }
     if (config_json_.end() != config_json_.find(kCfgPublicNode))
     {
         public_node_list_.clear();
@@ -315,6 +560,23 @@ bool Config::UpdateToVar()
             }
         }
     }
+    if (config_json_.end() != config_json_.find(kCfgWorkPool))
+    {
+        work_pools_.clear();
+        WorkPoolConfig work_pool;
+        for (auto &item : config_json_.at(kCfgWorkPool).items())
+        {
+            try
+            {
+                item.value().get_to(work_pool);
+                work_pools_[item.key()] = work_pool;
+            }
+            catch (...)
+            {
+                continue;
+            }
+        }
+    }
     if (public_node_list_.empty())
     {
         return false;
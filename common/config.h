@@ -2,6 +2,7 @@
 #define UENC_COMMON_CONFIG_H_
 
 #include <nlohmann/json.hpp>
+#include <map>
 #include <set>
 #include <mutex>
 
@@ -22,6 +23,14 @@ struct PublicNode
     }
 };
 
+struct WorkPoolConfig
+{
+    uint32_t thread_num;     //最少线程数量
+    uint32_t queue_limit;    //队列最大长度,0表示不限制
+    uint32_t max_thread_num; //负载高时最多增加到的线程数量,不大于thread_num时线程数固定
+    std::string cpus;        //线程绑定的cpu,如"0-3,8"或"node0",为空时不绑定
+};
+
 class Config
 {
 public:
@@ -56,8 +65,34 @@ public:
     const std::string &listen_ip() const { return listen_ip_; }
     uint16_t listen_port() const { return listen_port_; }
     uint16_t work_thread_num() const { return work_thread_num_; }
+    uint32_t schedule_weight_high() const { return schedule_weight_high_; }
+    uint32_t schedule_weight_middle() const { return schedule_weight_middle_; }
+    uint32_t schedule_weight_low() const { return schedule_weight_low_; }
+    uint32_t schedule_aging_time() const { return schedule_aging_time_; }
+    uint32_t admission_queue_soft_limit() const { return admission_queue_soft_limit_; }
+    uint32_t admission_queue_hard_limit() const { return admission_queue_hard_limit_; }
+    uint32_t admission_memory_soft_limit() const { return admission_memory_soft_limit_; }
+    uint32_t admission_memory_hard_limit() const { return admission_memory_hard_limit_; }
+    uint32_t admission_pause_num() const { return admission_pause_num_; }
+    uint32_t slow_down_time() const { return slow_down_time_; }
+    uint32_t inline_cpu_budget() const { return inline_cpu_budget_; }
+    const std::string &reactor_cpus() const { return reactor_cpus_; }
+    uint32_t broadcast_fanout() const { return broadcast_fanout_; }
+    uint32_t broadcast_ttl() const { return broadcast_ttl_; }
+    uint32_t broadcast_seen_time() const { return broadcast_seen_time_; }
+    const std::string &broadcast_mode() const { return broadcast_mode_; }
+    uint32_t public_node_probe_timeout() const { return public_node_probe_timeout_; }
+    uint32_t public_node_reselect_time() const { return public_node_reselect_time_; }
+    uint32_t public_node_switch_ratio() const { return public_node_switch_ratio_; }
+    uint32_t peer_cache_save_time() const { return peer_cache_save_time_; }
+    uint32_t peer_cache_expire_time() const { return peer_cache_expire_time_; }
+    uint32_t height_announce_interval() const { return height_announce_interval_; }
+    uint32_t fee_announce_interval() const { return fee_announce_interval_; }
+    bool state_heartbeat_piggyback() const { return state_heartbeat_piggyback_; }
+    uint32_t bucket_refresh_time() const { return bucket_refresh_time_; }
     bool public_node_list(std::vector<PublicNode> &public_nodes);
     void add_public_node(const PublicNode &public_node);
+    bool work_pool(const std::string &name, WorkPoolConfig &out_conf) const;
 
 private:
     bool ReadFile();
@@ -89,8 +124,44 @@ private:
     uint16_t listen_port_;     //用于protobuf通信的端口
     uint32_t work_thread_num_; //工作线程的数量
 
+    uint32_t schedule_weight_high_;   //高优先级消息的调度权重
+    uint32_t schedule_weight_middle_; //中优先级消息的调度权重
+    uint32_t schedule_weight_low_;    //低优先级消息的调度权重
+    uint32_t schedule_aging_time_;    //消息排队超过该时间(毫秒)后优先调度
+
+    uint32_t admission_queue_soft_limit_;  //待处理消息数超过该值后拒绝低优先级消息
+    uint32_t admission_queue_hard_limit_;  //待处理消息数超过该值后暂停读取流量最大的连接
+    uint32_t admission_memory_soft_limit_; //进程内存(MB)超过该值后拒绝低优先级消息,0表示不限制
+    uint32_t admission_memory_hard_limit_; //进程内存(MB)超过该值后暂停读取流量最大的连接,0表示不限制
+    uint32_t admission_pause_num_;         //同时暂停读取的连接数上限
+    uint32_t slow_down_time_;              //通知对端暂停发送低优先级消息的时间(毫秒)
+
+    uint32_t inline_cpu_budget_; //网络线程每次回调中直接处理消息的CPU时间预算(微秒),处理每条消息前检查
+
+    std::string reactor_cpus_; //网络线程绑定的cpu,格式同work_pool的cpus
+
+    uint32_t broadcast_fanout_;    //flood方式随机转发的公网节点数,0表示全部
+    uint32_t broadcast_ttl_;       //flood方式在公网节点间转发的最大跳数
+    uint32_t broadcast_seen_time_; //广播消息id的保留时间(秒),期间重复收到的消息不再处理
+    std::string broadcast_mode_;   //公网节点间的广播方式,tree为沿广播树推送,flood为随机转发
+
+    uint32_t public_node_probe_timeout_; //探测公网节点建立连接时间的超时(毫秒)
+    uint32_t public_node_reselect_time_; //下属节点重新选择公网节点的间隔(秒),0表示不切换
+    uint32_t public_node_switch_ratio_;  //其他公网节点的延迟比当前低该百分比以上时切换
+
+    uint32_t peer_cache_save_time_;   //节点表保存到数据库的间隔(秒),0表示不保存
+    uint32_t peer_cache_expire_time_; //保存的节点超过该时间(秒)未出现时丢弃
+
+    uint32_t height_announce_interval_; //自身高度广播的最小间隔(毫秒),期间的多次变化合并为一次
+    uint32_t fee_announce_interval_;    //自身手续费广播的最小间隔(毫秒)
+    bool state_heartbeat_piggyback_;    //心跳中附带自身的高度和手续费
+
+    uint32_t bucket_refresh_time_; //路由表中的桶超过该时间(秒)未更新时查找其中的随机key刷新
+
     std::mutex public_node_list_mutex_;
     std::set<PublicNode> public_node_list_;
+
+    std::map<std::string, WorkPoolConfig> work_pools_; //各消息处理线程池的配置
 };
 
 #endif
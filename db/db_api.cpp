@@ -13,6 +13,7 @@ const std::string kTxHash2BlockHashKey = "TxHash2BlockHash_";
 const std::string kUsePledeUtxo2TxHashKey = "UsePledgeUtxo2TxHash_";
 const std::string kUseUtxo2TxHashKey = "UseUtxo2TxHash_";
 const std::string kAwardTotalKey = "AwardTotal_";
+const std::string kPeerNodeCacheKey = "PeerNodeCache_";
 
 bool DBInit()
 {
@@ -49,6 +50,11 @@ DBStatus DBReader::GetNodeHeight(uint64_t &node_height)
     return ret;
 }
 
+DBStatus DBReader::GetPeerNodeCache(std::string &value)
+{
+    return ReadData(kPeerNodeCacheKey, value);
+}
+
 DBStatus DBReader::MultiReadData(const std::vector<std::string> &keys, std::vector<std::string> &values)
 {
     if (keys.empty())
@@ -174,6 +180,11 @@ DBStatus DBReadWriter::SetNodeHeight(uint64_t node_height)
     return WriteData(kNodeHeightKey, std::to_string(node_height));
 }
 
+DBStatus DBReadWriter::SetPeerNodeCache(const std::string &value)
+{
+    return WriteData(kPeerNodeCacheKey, value);
+}
+
 DBStatus DBReadWriter::TransactionRollBack()
 {
     if (auto_oper_trans)
@@ -29,6 +29,8 @@ public:
 
     //获取节点最高高度
     DBStatus GetNodeHeight(uint64_t &node_height);
+    //获取保存的节点表
+    DBStatus GetPeerNodeCache(std::string &value);
 
     virtual DBStatus MultiReadData(const std::vector<std::string> &keys, std::vector<std::string> &values);
     virtual DBStatus ReadData(const std::string &key, std::string &value);
@@ -52,6 +54,8 @@ public:
 
     //设置节点最高高度
     DBStatus SetNodeHeight(uint64_t node_height);
+    //保存节点表
+    DBStatus SetPeerNodeCache(const std::string &value);
 
 private:
     DBStatus TransactionRollBack();
@@ -1,8 +1,14 @@
 
 #include "http_server.h"
 #include "../common/config.h"
+#include "node/bootstrap.h"
+#include "node/identity_cache.h"
 #include "node/peer_node.h"
+#include "socket/admission_control.h"
+#include "socket/msg_metrics.h"
+#include "socket/socket_api.h"
 #include "utils/net_utils.h"
+#include <algorithm>
 #include <functional>
 #include <unistd.h>
 
@@ -40,18 +46,36 @@ void HttpServer::start()
 void HttpServer::registerAllCallback()
 {
     registerCallback("/info", api_info);
+    registerCallback("/schedule", api_schedule);
+    registerCallback("/msg_stats", api_msg_stats);
+    registerCallback("/admission", api_admission);
+    registerCallback("/handler_stats", api_handler_stats);
+    registerCallback("/bootstrap", api_bootstrap);
 }
 
 void api_info(const Request &req, Response &res)
 {
     std::ostringstream oss;
-    std::vector<Node> nodes;
-    Singleton<PeerNode>::instance()->GetAllNodes(nodes);
-    nodes.insert(nodes.begin(), Singleton<PeerNode>::instance()->self_node());
+    auto peer_node = Singleton<PeerNode>::instance();
+    auto table = peer_node->nodes();
+    std::vector<std::shared_ptr<const Node>> nodes;
+    nodes.reserve(table->nodes.size() + 1);
+    nodes.push_back(std::make_shared<const Node>(peer_node->self_node()));
+    for (auto &item : table->nodes)
+    {
+        nodes.push_back(item.second);
+    }
+    auto identity_cache = Singleton<IdentityCache>::instance();
+    oss
+        << "time_to_first_peer_ms(" << Bootstrap::time_to_first_peer() << ")"
+        << "  verified_identities(" << identity_cache->size() << ")"
+        << "  identity_cache_hits(" << identity_cache->hit_num() << ")"
+        << std::endl;
     std::string public_ip;
     std::string local_ip;
-    for (auto &item : nodes)
+    for (auto &node : nodes)
     {
+        const Node &item = *node;
         if (!Int2StrIPv4(item.public_ip, public_ip))
         {
             public_ip.clear();
@@ -63,17 +87,159 @@ void api_info(const Request &req, Response &res)
         oss
             << "  public_ip(" << public_ip << ")"
             << "  public_port(" << item.public_port << ")"
-            << "  public_base58addr(" << item.public_base58addr << ")"
+            << "  public_base58addr(" << item.public_id.ToBase58() << ")"
             << "  local_ip(" << local_ip << ")"
             << "  listen_port(" << item.listen_port << ")"
             << "  base58addr(" << item.base58addr << ")"
             << "  is_public(" << std::boolalpha << item.is_public_node << ")"
-            << "  height( " << item.height << " )"
-            << "  sign_fee(" << item.sign_fee << ")"
-            << "  package_fee(" << item.package_fee << ")"
+            << "  height( " << item.runtime->height << " )"
+            << "  sign_fee(" << item.runtime->sign_fee << ")"
+            << "  package_fee(" << item.runtime->package_fee << ")"
             << "  is_connected(" << std::boolalpha << item.is_connected() << ")"
-            << "  version(" << item.version << ")"
+            << "  rtt_us(" << item.runtime->rtt << ")"
+            << "  rtt_var_us(" << item.runtime->rtt_var << ")"
+            << "  version(" << item.version.str() << ")"
+            << std::endl;
+    }
+    res.set_content(oss.str(), "text/plain");
+}
+
+void api_schedule(const Request &req, Response &res)
+{
+    std::ostringstream oss;
+    std::vector<WorkPoolStats> pools;
+    Singleton<ProtobufProcess>::instance()->GetWorkPoolStats(pools);
+    uint64_t inline_handled = 0;
+    uint64_t inline_overflow = 0;
+    Singleton<ProtobufProcess>::instance()->GetInlineStats(inline_handled, inline_overflow);
+    oss
+        << "inline"
+        << "  handled(" << inline_handled << ")"
+        << "  overflow(" << inline_overflow << ")"
+        << std::endl;
+    oss
+        << "connection order"
+        << "  waiting(" << Singleton<ProtobufProcess>::instance()->order_waiting() << ")"
+        << std::endl;
+    for (auto &pool : pools)
+    {
+        oss
+            << "pool(" << pool.name << ")"
+            << "  thread_num(" << pool.thread_num << ")"
+            << "  min_thread_num(" << pool.min_thread_num << ")"
+            << "  max_thread_num(" << pool.max_thread_num << ")"
+            << "  queue_limit(" << pool.queue_limit << ")"
+            << "  rejected(" << pool.rejected << ")"
+            << std::endl;
+        for (auto &worker : pool.workers)
+        {
+            oss
+                << "  worker(" << worker.id << ")"
+                << "  busy_us(" << worker.busy_us << ")"
+                << "  idle_us(" << worker.idle_us << ")"
+                << std::endl;
+        }
+        for (size_t i = 0; i < pool.bands.size(); ++i)
+        {
+            auto &item = pool.bands.at(i);
+            oss
+                << "  band(" << PriorityBandName((PriorityBand)i) << ")"
+                << "  weight(" << item.weight << ")"
+                << "  queued(" << item.queued << ")"
+                << "  dispatched(" << item.dispatched << ")"
+                << "  aged(" << item.aged << ")"
+                << "  avg_wait_us(" << (0 == item.dispatched ? 0 : item.total_wait_us / item.dispatched) << ")"
+                << "  max_wait_us(" << item.max_wait_us << ")"
+                << std::endl;
+        }
+    }
+    res.set_content(oss.str(), "text/plain");
+}
+
+void api_msg_stats(const Request &req, Response &res)
+{
+    std::ostringstream oss;
+    std::vector<MsgTypeStats> stats;
+    Singleton<MsgMetrics>::instance()->GetStats(stats);
+    for (auto &item : stats)
+    {
+        oss
+            << "  type(" << item.type << ")"
+            << "  priority(" << (uint32_t)item.priority << ")"
+            << "  dispatched(" << item.dispatched << ")"
+            << "  expired(" << item.expired << ")"
+            << "  wait_p50_us(" << item.wait_p50_us << ")"
+            << "  wait_p99_us(" << item.wait_p99_us << ")"
+            << "  wait_p999_us(" << item.wait_p999_us << ")"
+            << "  wait_max_us(" << item.wait_max_us << ")"
             << std::endl;
     }
     res.set_content(oss.str(), "text/plain");
 }
+
+void api_admission(const Request &req, Response &res)
+{
+    std::ostringstream oss;
+    AdmissionStats stats;
+    Singleton<AdmissionControl>::instance()->GetStats(stats);
+    oss
+        << "  level(" << AdmissionLevelName(stats.level) << ")"
+        << "  queued(" << stats.queued << ")"
+        << "  memory(" << stats.memory << ")"
+        << "  rejected(" << stats.rejected << ")"
+        << "  slow_down(" << stats.slow_down << ")"
+        << "  paused(" << stats.paused << ")"
+        << std::endl;
+    res.set_content(oss.str(), "text/plain");
+}
+
+void api_handler_stats(const Request &req, Response &res)
+{
+    std::ostringstream oss;
+    std::vector<HandlerStats> stats;
+    Singleton<MsgMetrics>::instance()->GetHandlerStats(stats);
+    std::sort(stats.begin(), stats.end(), [](const HandlerStats &a, const HandlerStats &b)
+              { return a.latency_total_us > b.latency_total_us; });
+    for (auto &item : stats)
+    {
+        oss
+            << "  type(" << item.type << ")"
+            << "  calls(" << item.calls << ")"
+            << "  latency_p50_us(" << item.latency_p50_us << ")"
+            << "  latency_p99_us(" << item.latency_p99_us << ")"
+            << "  latency_p999_us(" << item.latency_p999_us << ")"
+            << "  latency_max_us(" << item.latency_max_us << ")"
+            << "  latency_total_us(" << item.latency_total_us << ")"
+            << "  msgs_in(" << item.msgs_in << ")"
+            << "  bytes_in(" << item.bytes_in << ")"
+            << "  msgs_out(" << item.msgs_out << ")"
+            << "  bytes_out(" << item.bytes_out << ")"
+            << "  rpc_calls(" << item.rpc_calls << ")"
+            << "  rpc_failed(" << item.rpc_failed << ")"
+            << "  rpc_p50_us(" << item.rpc_p50_us << ")"
+            << "  rpc_p99_us(" << item.rpc_p99_us << ")"
+            << "  rpc_max_us(" << item.rpc_max_us << ")"
+            << "  rpc_late(" << item.rpc_late << ")";
+        for (auto &error : item.errors)
+        {
+            oss << "  error" << error.first << "(" << error.second << ")";
+        }
+        oss << std::endl;
+    }
+    res.set_content(oss.str(), "text/plain");
+}
+
+void api_bootstrap(const Request &req, Response &res)
+{
+    std::ostringstream oss;
+    BootstrapStats stats;
+    Bootstrap::GetStats(stats);
+    oss
+        << "  time_to_first_peer_ms(" << stats.time_to_first_peer << ")"
+        << "  last_register_ms(" << stats.last_register_time << ")"
+        << "  attempts(" << stats.attempts << ")"
+        << "  succeeded(" << stats.succeeded << ")"
+        << "  failed(" << stats.failed << ")"
+        << std::endl;
+    res.set_content(oss.str(), "text/plain");
+}
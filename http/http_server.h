@@ -35,5 +35,10 @@ private:
 };
 
 void api_info(const Request &req, Response &res);
+void api_schedule(const Request &req, Response &res);
+void api_msg_stats(const Request &req, Response &res);
+void api_admission(const Request &req, Response &res);
+void api_handler_stats(const Request &req, Response &res);
+void api_bootstrap(const Request &req, Response &res);
 
 #endif
@@ -0,0 +1,177 @@
+#include "node/bootstrap.h"
+#include "common/logging.h"
+#include "node/msg_process.h"
+#include "node/peer_node.h"
+#include <algorithm>
+
+static const auto kProcessStartTime = std::chrono::steady_clock::now();
+
+//connection是否已是自身公网节点的连接
+static bool IsPublicNodeConnection(const std::shared_ptr<SocketConnection> &connection)
+{
+    auto peer_node = Singleton<PeerNode>::instance();
+    auto node = peer_node->FindNodeByConnection(connection->connection_id());
+    return nullptr != node && node->id == peer_node->self_node().public_id;
+}
+
+std::atomic<bool> Bootstrap::running_(false);
+std::atomic<uint64_t> Bootstrap::time_to_first_peer_(0);
+std::atomic<uint64_t> Bootstrap::last_register_time_(0);
+std::atomic<uint64_t> Bootstrap::attempts_(0);
+std::atomic<uint64_t> Bootstrap::succeeded_(0);
+std::atomic<uint64_t> Bootstrap::failed_(0);
+
+bool Bootstrap::Start(const std::vector<PublicNode> &candidates)
+{
+    if (candidates.empty() || running_.exchange(true))
+    {
+        return false;
+    }
+    std::make_shared<Bootstrap>(candidates)->Step();
+    return true;
+}
+
+void Bootstrap::GetStats(BootstrapStats &out_stats)
+{
+    out_stats.time_to_first_peer = time_to_first_peer_.load(std::memory_order_relaxed);
+    out_stats.last_register_time = last_register_time_.load(std::memory_order_relaxed);
+    out_stats.attempts = attempts_.load(std::memory_order_relaxed);
+    out_stats.succeeded = succeeded_.load(std::memory_order_relaxed);
+    out_stats.failed = failed_.load(std::memory_order_relaxed);
+}
+
+Bootstrap::Bootstrap(const std::vector<PublicNode> &candidates)
+    : candidates_(candidates)
+{
+    next_ = 0;
+    inflight_ = 0;
+    finished_ = false;
+    start_time_ = std::chrono::steady_clock::now();
+}
+
+void Bootstrap::Step()
+{
+    PublicNode node;
+    {
+        std::lock_guard<std::mutex> lck(mutex_);
+        if (finished_ || next_ >= candidates_.size())
+        {
+            return;
+        }
+        node = candidates_.at(next_++);
+        ++inflight_;
+    }
+    ++attempts_;
+    RegisterNodeReq req;
+    Node self_node = Singleton<PeerNode>::instance()->self_node();
+    req.set_is_get_nodelist(self_node.is_public_node);
+    std::string msg_bytes = req.SerializeAsString();
+    AppendNodeInfo(RegisterNodeReq::kNodeFieldNumber, self_node, msg_bytes);
+    auto socket_manager = Singleton<SocketManager>::instance();
+    auto connection = std::make_shared<SocketConnection>();
+    auto self = shared_from_this();
+    auto ret = socket_manager->Connect(node.ip, node.port, connection);
+    if (0 == ret)
+    {
+        ret = CallMessage<RegisterNodeAck>(connection, msg_bytes, req.GetDescriptor()->name(), Priority::kPriority_High_2, kRegisterTimeout,
+                                           [self, connection](int ret, const std::shared_ptr<RegisterNodeAck> &ack)
+                                           { self->OnResponse(connection, ret, ack); });
+    }
+    if (0 != ret)
+    {
+        DEBUGLOG("register to public node {}:{} fail {}", node.ip, node.port, ret);
+        if (nullptr != connection && connection->IsConnected())
+        {
+            socket_manager->DisConnect(connection->connection_id());
+        }
+        {
+            std::lock_guard<std::mutex> lck(mutex_);
+            --inflight_;
+            CheckFinished();
+        }
+        //连接失败的节点不必等待,直接尝试下一个
+        Step();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lck(mutex_);
+        connections_.push_back(connection);
+    }
+    Singleton<RpcManager>::instance()->AddTimer(kRegisterStagger, [self]()
+                                                { self->Step(); });
+}
+
+void Bootstrap::OnResponse(const std::shared_ptr<SocketConnection> &connection, int ret, const std::shared_ptr<RegisterNodeAck> &ack)
+{
+    //旧版本的公网节点回复的RegisterNodeAck不带id,已由普通的处理函数完成注册,请求随后超时
+    bool registered = kRpc_Success != ret && IsPublicNodeConnection(connection);
+    bool is_first = false;
+    std::vector<std::shared_ptr<SocketConnection>> others;
+    {
+        std::lock_guard<std::mutex> lck(mutex_);
+        --inflight_;
+        if (!finished_ && ((kRpc_Success == ret && nullptr != ack) || registered))
+        {
+            is_first = true;
+            finished_ = true;
+            running_ = false;
+            for (auto &item : connections_)
+            {
+                if (item != connection)
+                {
+                    others.push_back(item);
+                }
+            }
+            connections_.clear();
+        }
+        else
+        {
+            CheckFinished();
+        }
+    }
+    auto socket_manager = Singleton<SocketManager>::instance();
+    if (!is_first)
+    {
+        //超时或已采用其他节点,已成为公网节点的连接不断开
+        if (!registered)
+        {
+            socket_manager->DisConnect(connection->connection_id());
+        }
+        if (kRpc_Success != ret)
+        {
+            Step();
+        }
+        return;
+    }
+    //取消其余还在等待回复的注册
+    for (auto &item : others)
+    {
+        socket_manager->DisConnect(item->connection_id());
+    }
+    auto now = std::chrono::steady_clock::now();
+    uint64_t register_time = std::chrono::duration_cast<std::chrono::milliseconds>(now - start_time_).count();
+    uint64_t first_peer_time = std::chrono::duration_cast<std::chrono::milliseconds>(now - kProcessStartTime).count();
+    uint64_t expected = 0;
+    time_to_first_peer_.compare_exchange_strong(expected, std::max<uint64_t>(first_peer_time, 1));
+    last_register_time_ = register_time;
+    ++succeeded_;
+    INFOLOG("register to public node {} in {}ms, cancel {} others, time to first peer {}ms",
+            connection->connection_id(), register_time, others.size(), time_to_first_peer_.load());
+    if (!registered)
+    {
+        HandlerRegisterNodeAck(ack, connection);
+    }
+}
+
+void Bootstrap::CheckFinished()
+{
+    if (finished_ || 0 != inflight_ || next_ < candidates_.size())
+    {
+        return;
+    }
+    finished_ = true;
+    running_ = false;
+    connections_.clear();
+    ++failed_;
+    WARNLOG("register to public node fail, tried {} nodes", candidates_.size());
+}
@@ -0,0 +1,68 @@
+#ifndef UENC_NODE_BOOTSTRAP_H_
+#define UENC_NODE_BOOTSTRAP_H_
+
+#include "common/config.h"
+#include "proto/node.pb.h"
+#include "socket/socket_api.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//等待RegisterNodeAck的时间(毫秒)
+const uint32_t kRegisterTimeout = 3000;
+//前面的注册在此时间(毫秒)内没有回复时,同时向下一个公网节点注册
+const uint32_t kRegisterStagger = 250;
+
+struct BootstrapStats
+{
+    uint64_t time_to_first_peer; //进程启动到第一次注册成功的时间(毫秒),0表示还未成功
+    uint64_t last_register_time; //最近一次注册从开始到成功的时间(毫秒)
+    uint64_t attempts;           //发起注册的公网节点数
+    uint64_t succeeded;          //注册成功的次数
+    uint64_t failed;             //所有公网节点都注册失败的次数
+};
+
+//同时向多个公网节点注册
+//按顺序每隔kRegisterStagger向下一个节点发起注册,采用最先回复的节点,断开其余的连接
+class Bootstrap : public std::enable_shared_from_this<Bootstrap>
+{
+public:
+    //candidates为按优先顺序排列的公网节点,已有注册在进行时返回false
+    static bool Start(const std::vector<PublicNode> &candidates);
+    //进程启动到第一次注册成功的时间(毫秒),0表示还未成功
+    static uint64_t time_to_first_peer() { return time_to_first_peer_; }
+    static void GetStats(BootstrapStats &out_stats);
+
+    Bootstrap(const std::vector<PublicNode> &candidates);
+    ~Bootstrap() = default;
+    Bootstrap(Bootstrap &&) = delete;
+    Bootstrap(const Bootstrap &) = delete;
+    Bootstrap &operator=(Bootstrap &&) = delete;
+    Bootstrap &operator=(const Bootstrap &) = delete;
+
+private:
+    //向下一个公网节点发起注册
+    void Step();
+    void OnResponse(const std::shared_ptr<SocketConnection> &connection, int ret, const std::shared_ptr<RegisterNodeAck> &ack);
+    //所有注册都已结束且没有成功时结束本次注册,调用时需持有mutex_
+    void CheckFinished();
+
+    static std::atomic<bool> running_;
+    static std::atomic<uint64_t> time_to_first_peer_;
+    static std::atomic<uint64_t> last_register_time_;
+    static std::atomic<uint64_t> attempts_;
+    static std::atomic<uint64_t> succeeded_;
+    static std::atomic<uint64_t> failed_;
+
+    std::mutex mutex_;
+    std::vector<PublicNode> candidates_;
+    size_t next_;
+    uint32_t inflight_;
+    bool finished_;
+    std::vector<std::shared_ptr<SocketConnection>> connections_;
+    std::chrono::steady_clock::time_point start_time_;
+};
+
+#endif
@@ -0,0 +1,243 @@
+#include "node/broadcast.h"
+#include "common/config.h"
+#include "common/logging.h"
+#include "node/msg_process.h"
+#include "node/peer_node.h"
+#include "utils/crypto_utils.h"
+#include "utils/singleton.hpp"
+#include <algorithm>
+
+std::string BroadcastCache::GetMsgId(const std::string &from_base58addr, const std::string &data)
+{
+    std::string hash;
+    std::string msg_id;
+    GetSha256Hash(from_base58addr + data, hash);
+    Hex2Bytes(hash, msg_id);
+    return msg_id;
+}
+
+bool BroadcastCache::Insert(const std::string &msg_id)
+{
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lck(mutex_);
+    Expire(now);
+    if (!ids_.insert(msg_id).second)
+    {
+        ++duplicate_num_;
+        return false;
+    }
+    expires_.push_back(std::make_pair(now + std::chrono::seconds(Singleton<Config>::instance()->broadcast_seen_time()), msg_id));
+    while (expires_.size() > kMaxBroadcastSeen)
+    {
+        ids_.erase(expires_.front().second);
+        expires_.pop_front();
+    }
+    return true;
+}
+
+bool BroadcastCache::Contains(const std::string &msg_id)
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    return ids_.end() != ids_.find(msg_id);
+}
+
+size_t BroadcastCache::size()
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    return ids_.size();
+}
+
+uint64_t BroadcastCache::duplicate_num()
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    return duplicate_num_;
+}
+
+void BroadcastCache::Expire(std::chrono::steady_clock::time_point now)
+{
+    while (!expires_.empty() && expires_.front().first <= now)
+    {
+        ids_.erase(expires_.front().second);
+        expires_.pop_front();
+    }
+}
+
+BroadcastTree::BroadcastTree()
+{
+    continue_runing_ = false;
+}
+
+void BroadcastTree::ThreadStart()
+{
+    continue_runing_ = true;
+    thread_ = std::thread(std::bind(&BroadcastTree::ThreadWork, this));
+    thread_.detach();
+}
+
+void BroadcastTree::ThreadStop()
+{
+    {
+        std::lock_guard<std::mutex> lck(mutex_);
+        continue_runing_ = false;
+    }
+    condition_.notify_all();
+}
+
+void BroadcastTree::OnMessage(const std::shared_ptr<const BroadcaseMsgReq> &msg, const NodeId &from_peer,
+                              const std::vector<std::shared_ptr<const Node>> &public_nodes, std::vector<std::shared_ptr<const Node>> &out_eager_nodes)
+{
+    auto now = std::chrono::steady_clock::now();
+    const std::string &msg_id = msg->msg_id();
+    std::lock_guard<std::mutex> lck(mutex_);
+    missing_.erase(msg_id);
+    ExpireMessages(now);
+    if (messages_.emplace(msg_id, msg).second)
+    {
+        message_expires_.push_back(std::make_pair(now + std::chrono::seconds(kBroadcastMessageCacheTime), msg_id));
+    }
+    //消息沿此连接到达,保持为eager
+    lazy_peers_.erase(from_peer);
+    for (auto &node : public_nodes)
+    {
+        auto &peer = node->id;
+        if (peer == from_peer || node->base58addr == msg->from().base58addr())
+        {
+            continue;
+        }
+        if (lazy_peers_.end() != lazy_peers_.find(peer))
+        {
+            ihaves_[peer].push_back(msg_id);
+        }
+        else
+        {
+            out_eager_nodes.push_back(node);
+        }
+    }
+}
+
+void BroadcastTree::OnPrune(const NodeId &peer)
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    lazy_peers_.insert(peer);
+}
+
+void BroadcastTree::OnIHave(const NodeId &peer, const std::vector<std::string> &msg_ids)
+{
+    auto cache = Singleton<BroadcastCache>::instance();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kGraftTimeout);
+    std::lock_guard<std::mutex> lck(mutex_);
+    for (auto &msg_id : msg_ids)
+    {
+        if (cache->Contains(msg_id))
+        {
+            continue;
+        }
+        auto it = missing_.find(msg_id);
+        if (missing_.end() == it)
+        {
+            if (missing_.size() >= kMaxBroadcastMessages)
+            {
+                continue;
+            }
+            it = missing_.emplace(msg_id, Missing{deadline, {}}).first;
+        }
+        it->second.peers.push_back(peer);
+    }
+}
+
+void BroadcastTree::OnGraft(const NodeId &peer, const std::vector<std::string> &msg_ids,
+                            std::vector<std::shared_ptr<const BroadcaseMsgReq>> &out_msgs)
+{
+    out_msgs.clear();
+    std::lock_guard<std::mutex> lck(mutex_);
+    lazy_peers_.erase(peer);
+    for (auto &msg_id : msg_ids)
+    {
+        auto it = messages_.find(msg_id);
+        if (messages_.end() != it)
+        {
+            out_msgs.push_back(it->second);
+        }
+    }
+}
+
+void BroadcastTree::RemovePeer(const NodeId &peer)
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    lazy_peers_.erase(peer);
+    ihaves_.erase(peer);
+    for (auto &item : missing_)
+    {
+        auto &peers = item.second.peers;
+        peers.erase(std::remove(peers.begin(), peers.end(), peer), peers.end());
+    }
+}
+
+void BroadcastTree::GetLazyPeers(std::vector<NodeId> &out_peers)
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    out_peers.assign(lazy_peers_.begin(), lazy_peers_.end());
+}
+
+void BroadcastTree::ThreadWork()
+{
+    pthread_setname_np(pthread_self(), "uenc_bcast");
+    std::map<NodeId, std::vector<std::string>> ihaves;
+    std::map<NodeId, std::vector<std::string>> grafts;
+    while (continue_runing_)
+    {
+        {
+            std::unique_lock<std::mutex> lck(mutex_);
+            condition_.wait_for(lck, std::chrono::milliseconds(kIHaveInterval));
+            if (!continue_runing_)
+            {
+                break;
+            }
+            ihaves.swap(ihaves_);
+            auto now = std::chrono::steady_clock::now();
+            for (auto it = missing_.begin(); missing_.end() != it;)
+            {
+                auto &missing = it->second;
+                if (missing.deadline > now)
+                {
+                    ++it;
+                    continue;
+                }
+                if (missing.peers.empty())
+                {
+                    it = missing_.erase(it);
+                    continue;
+                }
+                //向最早通知的节点请求,把它加入广播树,超时后再换下一个
+                NodeId peer = missing.peers.front();
+                missing.peers.pop_front();
+                lazy_peers_.erase(peer);
+                grafts[peer].push_back(it->first);
+                missing.deadline = now + std::chrono::milliseconds(kGraftTimeout);
+                ++it;
+            }
+            ExpireMessages(now);
+        }
+        for (auto &item : ihaves)
+        {
+            SendBroadcastIHaveReq(item.first.ToBase58(), item.second);
+        }
+        for (auto &item : grafts)
+        {
+            std::string base58addr = item.first.ToBase58();
+            DEBUGLOG("graft {} broadcast messages from {}", item.second.size(), base58addr);
+            SendBroadcastGraftReq(base58addr, item.second);
+        }
+        ihaves.clear();
+        grafts.clear();
+    }
+}
+
+void BroadcastTree::ExpireMessages(std::chrono::steady_clock::time_point now)
+{
+    while (!message_expires_.empty() && (message_expires_.front().first <= now || message_expires_.size() > kMaxBroadcastMessages))
+    {
+        messages_.erase(message_expires_.front().second);
+        message_expires_.pop_front();
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef UENC_NODE_BROADCAST_H_
+#define UENC_NODE_BROADCAST_H_
+
+#include "node/node_id.h"
+#include "proto/node.pb.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct Node;
+
+//最多保留的广播消息id数,超过后提前丢弃最早的
+const size_t kMaxBroadcastSeen = 100000;
+//批量发送IHAVE的间隔(毫秒)
+const uint32_t kIHaveInterval = 200;
+//收到IHAVE后等待消息的时间(毫秒),超时后向通知的节点GRAFT
+const uint32_t kGraftTimeout = 1000;
+//缓存广播消息以回复GRAFT的时间(秒)
+const uint32_t kBroadcastMessageCacheTime = 60;
+//最多缓存的广播消息数
+const size_t kMaxBroadcastMessages = 10000;
+
+//已收到的广播消息id
+//保留时间内重复收到的消息不再处理和转发
+class BroadcastCache
+{
+public:
+    BroadcastCache() = default;
+    ~BroadcastCache() = default;
+    BroadcastCache(BroadcastCache &&) = delete;
+    BroadcastCache(const BroadcastCache &) = delete;
+    BroadcastCache &operator=(BroadcastCache &&) = delete;
+    BroadcastCache &operator=(const BroadcastCache &) = delete;
+
+    //消息id为发送者和消息内容的hash
+    static std::string GetMsgId(const std::string &from_base58addr, const std::string &data);
+
+    //第一次收到返回true
+    bool Insert(const std::string &msg_id);
+    bool Contains(const std::string &msg_id);
+    size_t size();
+    uint64_t duplicate_num();
+
+private:
+    void Expire(std::chrono::steady_clock::time_point now);
+
+    std::mutex mutex_;
+    std::unordered_set<std::string> ids_;
+    std::deque<std::pair<std::chrono::steady_clock::time_point, std::string>> expires_;
+    uint64_t duplicate_num_ = 0; //被丢弃的重复消息数
+};
+
+//公网节点之间的广播树(Plumtree)
+//消息只沿eager连接推送,其余lazy连接批量发送IHAVE
+//重复收到消息时PRUNE对方,IHAVE的消息超时未收到时GRAFT对方,连接断开后由此修复广播树
+//新加入的公网节点默认为eager
+class BroadcastTree
+{
+public:
+    BroadcastTree();
+    ~BroadcastTree() = default;
+    BroadcastTree(BroadcastTree &&) = delete;
+    BroadcastTree(const BroadcastTree &) = delete;
+    BroadcastTree &operator=(BroadcastTree &&) = delete;
+    BroadcastTree &operator=(const BroadcastTree &) = delete;
+
+    void ThreadStart();
+    void ThreadStop();
+
+    //收到新消息,from_peer为发来消息的节点,自身发出时为空
+    //需要立即推送的公网节点追加到out_eager_nodes,lazy节点稍后收到IHAVE
+    void OnMessage(const std::shared_ptr<const BroadcaseMsgReq> &msg, const NodeId &from_peer,
+                   const std::vector<std::shared_ptr<const Node>> &public_nodes, std::vector<std::shared_ptr<const Node>> &out_eager_nodes);
+    //从公网节点重复收到消息或收到PRUNE时,把对方改为lazy
+    void OnPrune(const NodeId &peer);
+    void OnIHave(const NodeId &peer, const std::vector<std::string> &msg_ids);
+    //out_msgs为缓存中peer请求的消息
+    void OnGraft(const NodeId &peer, const std::vector<std::string> &msg_ids,
+                 std::vector<std::shared_ptr<const BroadcaseMsgReq>> &out_msgs);
+    void RemovePeer(const NodeId &peer);
+    void GetLazyPeers(std::vector<NodeId> &out_peers);
+
+private:
+    struct Missing
+    {
+        std::chrono::steady_clock::time_point deadline;
+        std::deque<NodeId> peers; //发送过IHAVE的节点
+    };
+
+    void ThreadWork();
+    void ExpireMessages(std::chrono::steady_clock::time_point now);
+
+    std::thread thread_;
+    bool continue_runing_;
+
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::set<NodeId> lazy_peers_;
+    std::map<NodeId, std::vector<std::string>> ihaves_; //节点 -> 待发送IHAVE的消息id
+    std::unordered_map<std::string, Missing> missing_;       //消息id -> 已通知但未收到的消息
+    std::unordered_map<std::string, std::shared_ptr<const BroadcaseMsgReq>> messages_;
+    std::deque<std::pair<std::chrono::steady_clock::time_point, std::string>> message_expires_;
+};
+
+#endif
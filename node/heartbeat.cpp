@@ -0,0 +1,154 @@
+#include "node/heartbeat.h"
+#include "common/logging.h"
+#include "node/msg_process.h"
+#include "node/peer_node.h"
+#include <algorithm>
+#include <vector>
+
+Heartbeat::Heartbeat()
+{
+    continue_runing_ = false;
+}
+
+uint64_t Heartbeat::Now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Heartbeat::ThreadStart()
+{
+    continue_runing_ = true;
+    thread_ = std::thread(std::bind(&Heartbeat::ThreadWork, this));
+    thread_.detach();
+}
+
+void Heartbeat::ThreadStop()
+{
+    {
+        std::lock_guard<std::mutex> lck(mutex_);
+        continue_runing_ = false;
+    }
+    condition_.notify_all();
+}
+
+void Heartbeat::OnPong(const NodeId &id, uint64_t timestamp)
+{
+    uint64_t now = Now();
+    //旧版本的回复没有时间戳
+    if (0 == timestamp || timestamp > now)
+    {
+        return;
+    }
+    uint32_t sample = (uint32_t)std::min<uint64_t>(now - timestamp, UINT32_MAX);
+    std::lock_guard<std::mutex> lck(mutex_);
+    auto it = peers_.find(id);
+    if (peers_.end() == it)
+    {
+        return;
+    }
+    //与tcp相同:srtt = 7/8 srtt + 1/8 sample, rttvar = 3/4 rttvar + 1/4 |srtt - sample|
+    auto &state = it->second;
+    if (0 == state.rtt)
+    {
+        state.rtt = sample;
+        state.rtt_var = sample / 2;
+    }
+    else
+    {
+        uint32_t diff = state.rtt > sample ? state.rtt - sample : sample - state.rtt;
+        state.rtt_var = state.rtt_var - state.rtt_var / 4 + diff / 4;
+        state.rtt = state.rtt - state.rtt / 8 + sample / 8;
+    }
+    state.probes = 0;
+    state.last_sample = std::chrono::steady_clock::now();
+    state.dirty = true;
+}
+
+void Heartbeat::ThreadWork()
+{
+    pthread_setname_np(pthread_self(), "uenc_heart");
+    while (continue_runing_)
+    {
+        {
+            std::unique_lock<std::mutex> lck(mutex_);
+            condition_.wait_for(lck, std::chrono::milliseconds(kHeartbeatTick));
+            if (!continue_runing_)
+            {
+                break;
+            }
+        }
+        Check();
+    }
+}
+
+void Heartbeat::Check()
+{
+    auto peer_node = Singleton<PeerNode>::instance();
+    auto table = peer_node->nodes();
+    auto now = std::chrono::steady_clock::now();
+    std::vector<std::string> ping_addrs;
+    std::vector<std::string> dead_addrs;
+    std::unordered_map<NodeId, std::pair<uint32_t, uint32_t>, NodeIdHash> rtts;
+    {
+        std::lock_guard<std::mutex> lck(mutex_);
+        for (auto it = peers_.begin(); peers_.end() != it;)
+        {
+            if (nullptr == table->Find(it->first))
+            {
+                it = peers_.erase(it);
+                continue;
+            }
+            ++it;
+        }
+        for (auto &item : table->nodes)
+        {
+            auto &node = item.second;
+            auto connection = node->runtime->connection.load();
+            if (nullptr == connection || !connection->IsConnected())
+            {
+                continue;
+            }
+            auto &state = peers_[node->id];
+            if (state.dirty)
+            {
+                rtts.emplace(node->id, std::make_pair(state.rtt, state.rtt_var));
+                state.dirty = false;
+            }
+            if (now - state.last_ping < std::chrono::seconds(HEART_INTVL))
+            {
+                continue;
+            }
+            //最近收到过数据,只定期测量往返时间
+            if (connection->GetLastRecvIntervalTime() < HEART_TIME)
+            {
+                state.probes = 0;
+                if (now - state.last_sample < std::chrono::seconds(kRttRefreshTime))
+                {
+                    continue;
+                }
+                state.last_sample = now;
+            }
+            else if (state.probes >= HEART_PROBES)
+            {
+                dead_addrs.push_back(node->base58addr);
+                continue;
+            }
+            else
+            {
+                ++state.probes;
+            }
+            state.last_ping = now;
+            ping_addrs.push_back(node->base58addr);
+        }
+    }
+    for (auto &base58addr : ping_addrs)
+    {
+        SendPingReq(base58addr);
+    }
+    peer_node->UpdateNodesRtt(rtts);
+    for (auto &base58addr : dead_addrs)
+    {
+        WARNLOG("node {} did not respond to {} heartbeats, delete it", base58addr, HEART_PROBES);
+        peer_node->DeleteNodeByBase58Addr(base58addr);
+    }
+}
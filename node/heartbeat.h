@@ -0,0 +1,58 @@
+#ifndef UENC_NODE_HEARTBEAT_H_
+#define UENC_NODE_HEARTBEAT_H_
+
+#include "node/node_id.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+//检测连接的间隔(毫秒)
+const uint32_t kHeartbeatTick = 1000;
+//连接活跃时测量往返时间的间隔(秒)
+const uint32_t kRttRefreshTime = 60;
+
+//向空闲的节点发送PingReq,连续HEART_PROBES次没有回复时删除节点
+//根据PongReq中回带的时间戳计算往返时间,平滑后发布到节点表
+class Heartbeat
+{
+public:
+    Heartbeat();
+    ~Heartbeat() = default;
+    Heartbeat(Heartbeat &&) = delete;
+    Heartbeat(const Heartbeat &) = delete;
+    Heartbeat &operator=(Heartbeat &&) = delete;
+    Heartbeat &operator=(const Heartbeat &) = delete;
+
+    //PingReq中的时间戳(微秒)
+    static uint64_t Now();
+
+    void ThreadStart();
+    void ThreadStop();
+    void OnPong(const NodeId &id, uint64_t timestamp);
+
+private:
+    struct PeerState
+    {
+        uint32_t probes = 0; //未回复的PingReq数
+        std::chrono::steady_clock::time_point last_ping;
+        std::chrono::steady_clock::time_point last_sample;
+        uint32_t rtt = 0;
+        uint32_t rtt_var = 0;
+        bool dirty = false; //rtt尚未发布到节点表
+    };
+
+    void ThreadWork();
+    void Check();
+
+    std::thread thread_;
+    bool continue_runing_;
+
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::unordered_map<NodeId, PeerState, NodeIdHash> peers_;
+};
+
+#endif
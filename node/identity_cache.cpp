@@ -0,0 +1,74 @@
+#include "node/identity_cache.h"
+#include "account/account.h"
+#include "utils/crypto_utils.h"
+
+int IdentityCache::Verify(const std::string &pub, const std::string &sign, const std::string &base58addr)
+{
+    std::string key = GetKey(pub, sign, base58addr);
+    {
+        std::lock_guard<std::mutex> lck(mutex_);
+        auto it = identities_.find(key);
+        if (identities_.end() != it)
+        {
+            keys_.splice(keys_.end(), keys_, it->second);
+            ++hit_num_;
+            return 0;
+        }
+    }
+    Account::PublicKey public_key;
+    auto ret = public_key.LoadFromBytes(pub);
+    if (ret < 0)
+    {
+        return ret - 100;
+    }
+    if (public_key.GetBase58addr() != base58addr)
+    {
+        return -1;
+    }
+    ret = public_key.VerifySign(base58addr, sign);
+    if (ret < 0)
+    {
+        return ret - 200;
+    }
+    std::lock_guard<std::mutex> lck(mutex_);
+    if (identities_.end() != identities_.find(key))
+    {
+        return 0;
+    }
+    identities_[key] = keys_.insert(keys_.end(), key);
+    while (keys_.size() > kMaxVerifiedIdentities)
+    {
+        identities_.erase(keys_.front());
+        keys_.pop_front();
+    }
+    return 0;
+}
+
+size_t IdentityCache::size()
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    return identities_.size();
+}
+
+uint64_t IdentityCache::hit_num()
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    return hit_num_;
+}
+
+std::string IdentityCache::GetKey(const std::string &pub, const std::string &sign, const std::string &base58addr)
+{
+    //各字段前加上长度,避免不同的字段组合拼接后相同
+    std::string data;
+    for (auto item : {&pub, &sign, &base58addr})
+    {
+        data += std::to_string(item->size());
+        data += ':';
+        data += *item;
+    }
+    std::string hash;
+    std::string key;
+    GetSha256Hash(data, hash);
+    Hex2Bytes(hash, key);
+    return key;
+}
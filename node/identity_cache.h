@@ -0,0 +1,39 @@
+#ifndef UENC_NODE_IDENTITY_CACHE_H_
+#define UENC_NODE_IDENTITY_CACHE_H_
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+//最多缓存的已验证身份数,超过后丢弃最久未使用的
+const size_t kMaxVerifiedIdentities = 10000;
+
+//已验证的节点身份
+//解析公钥、计算地址和验证签名的开销较大,同一节点重复注册或连接时直接使用验证过的结果
+//只缓存验证成功的身份
+class IdentityCache
+{
+public:
+    IdentityCache() = default;
+    ~IdentityCache() = default;
+    IdentityCache(IdentityCache &&) = delete;
+    IdentityCache(const IdentityCache &) = delete;
+    IdentityCache &operator=(IdentityCache &&) = delete;
+    IdentityCache &operator=(const IdentityCache &) = delete;
+
+    //验证pub对应的地址为base58addr且sign为pub对base58addr的签名,成功返回0
+    int Verify(const std::string &pub, const std::string &sign, const std::string &base58addr);
+    size_t size();
+    uint64_t hit_num();
+
+private:
+    static std::string GetKey(const std::string &pub, const std::string &sign, const std::string &base58addr);
+
+    std::mutex mutex_;
+    std::list<std::string> keys_; //最近使用的在后
+    std::unordered_map<std::string, std::list<std::string>::iterator> identities_;
+    uint64_t hit_num_ = 0;
+};
+
+#endif
@@ -1,110 +1,184 @@
 #include "node/msg_process.h"
-#include "account/account.h"
+#include "common/config.h"
 #include "common/logging.h"
+#include "node/broadcast.h"
+#include "node/heartbeat.h"
+#include "node/identity_cache.h"
 #include "node/node_api.h"
+#include "node/node_sync.h"
 #include "node/peer_node.h"
+#include "node/state_announcer.h"
 #include "utils/net_utils.h"
+#include <algorithm>
+#include <random>
+
+//同一消息中的下属节点属于同一个公网节点,缓存上次解析的结果
+static void ParsePublicId(const std::string &public_base58addr, NodeId &out_id)
+{
+    static thread_local std::string last_base58addr;
+    static thread_local NodeId last_id;
+    if (public_base58addr != last_base58addr)
+    {
+        last_id = NodeId();
+        NodeId::FromBase58(public_base58addr, last_id);
+        last_base58addr = public_base58addr;
+    }
+    out_id = last_id;
+}
+
+void NodeInfo2Node(const NodeInfo &nodeinfo, Node &out_node)
+{
+    out_node.Clear();
+    out_node.pub = nodeinfo.pub();
+    out_node.sign = nodeinfo.sign();
+    out_node.base58addr = nodeinfo.base58addr();
+    NodeId::FromBase58(out_node.base58addr, out_node.id);
+    ParsePublicId(nodeinfo.public_base58addr(), out_node.public_id);
+    out_node.local_ip = nodeinfo.local_ip();
+    out_node.listen_port = nodeinfo.listen_port();
+    out_node.public_ip = nodeinfo.public_ip();
+    out_node.public_port = nodeinfo.public_port();
+    out_node.runtime->height = nodeinfo.height();
+    out_node.runtime->sign_fee = nodeinfo.sign_fee();
+    out_node.runtime->package_fee = nodeinfo.package_fee();
+    out_node.is_public_node = nodeinfo.is_public_node();
+    out_node.version = nodeinfo.version();
+}
+
+void Node2NodeInfo(const Node &node, NodeInfo *out_nodeinfo)
+{
+    out_nodeinfo->set_pub(node.pub);
+    out_nodeinfo->set_sign(node.sign);
+    out_nodeinfo->set_base58addr(node.base58addr);
+    out_nodeinfo->set_public_base58addr(node.public_id.ToBase58());
+    out_nodeinfo->set_local_ip(node.local_ip);
+    out_nodeinfo->set_listen_port(node.listen_port);
+    out_nodeinfo->set_public_ip(node.public_ip);
+    out_nodeinfo->set_public_port(node.public_port);
+    out_nodeinfo->set_is_public_node(node.is_public_node);
+    out_nodeinfo->set_height(node.runtime->height);
+    out_nodeinfo->set_sign_fee(node.runtime->sign_fee);
+    out_nodeinfo->set_package_fee(node.runtime->package_fee);
+    out_nodeinfo->set_version(node.version.str());
+}
+
+std::shared_ptr<const EncodedNodeInfo> SerializeNodeInfo(const Node &node)
+{
+    //高度和手续费可能被并发修改,只读取一次,保证编码与记录的值一致
+    auto encoded = std::make_shared<EncodedNodeInfo>();
+    encoded->revision = node.revision;
+    encoded->height = node.runtime->height;
+    encoded->sign_fee = node.runtime->sign_fee;
+    encoded->package_fee = node.runtime->package_fee;
+    NodeInfo nodeinfo;
+    Node2NodeInfo(node, &nodeinfo);
+    nodeinfo.set_height(encoded->height);
+    nodeinfo.set_sign_fee(encoded->sign_fee);
+    nodeinfo.set_package_fee(encoded->package_fee);
+    encoded->bytes = nodeinfo.SerializeAsString();
+    return encoded;
+}
+
+static void AppendVarint(uint64_t value, std::string &out_bytes)
+{
+    while (value >= 0x80)
+    {
+        out_bytes.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    out_bytes.push_back((char)value);
+}
+
+void AppendNodeInfo(uint32_t field_number, const std::string &nodeinfo, std::string &out_bytes)
+{
+    //length-delimited类型的字段: tag, 长度, 内容
+    AppendVarint((field_number << 3) | 2, out_bytes);
+    AppendVarint(nodeinfo.size(), out_bytes);
+    out_bytes.append(nodeinfo);
+}
+
+void AppendNodeInfo(uint32_t field_number, const Node &node, std::string &out_bytes)
+{
+    auto encoded = node.runtime->nodeinfo.load();
+    if (nullptr == encoded || encoded->revision != node.revision || encoded->height != node.runtime->height || encoded->sign_fee != node.runtime->sign_fee ||
+        encoded->package_fee != node.runtime->package_fee)
+    {
+        encoded = SerializeNodeInfo(node);
+        node.runtime->nodeinfo = encoded;
+    }
+    AppendNodeInfo(field_number, encoded->bytes, out_bytes);
+}
 
 int SendRegisterNodeReq(std::string addr, uint16_t port)
 {
     RegisterNodeReq req;
     Node self_node = Singleton<PeerNode>::instance()->self_node();
     req.set_is_get_nodelist(self_node.is_public_node);
-    NodeInfo *node = req.mutable_node();
-    node->set_pub(self_node.pub);
-    node->set_sign(self_node.sign);
-    node->set_base58addr(self_node.base58addr);
-    node->set_public_base58addr(self_node.public_base58addr);
-    node->set_local_ip(self_node.local_ip);
-    node->set_listen_port(self_node.listen_port);
-    node->set_public_ip(self_node.public_ip);
-    node->set_public_port(self_node.public_port);
-    node->set_is_public_node(self_node.is_public_node);
-    node->set_height(self_node.height);
-    node->set_sign_fee(self_node.sign_fee);
-    node->set_package_fee(self_node.package_fee);
-    node->set_version(self_node.version);
+    std::string msg_bytes = req.SerializeAsString();
+    AppendNodeInfo(RegisterNodeReq::kNodeFieldNumber, self_node, msg_bytes);
 
     auto socket_manager = Singleton<SocketManager>::instance();
-    if(nullptr != self_node.connection)
+    auto connection = self_node.runtime->connection.load();
+    if(nullptr != connection)
     {
-        socket_manager->DisConnect(self_node.connection->connection_id());
-        self_node.connection.reset();
+        socket_manager->DisConnect(connection->connection_id());
     }
-    self_node.connection = std::make_shared<SocketConnection>();
-    auto ret = socket_manager->Connect(addr, port, self_node.connection);
+    connection = std::make_shared<SocketConnection>();
+    auto ret = socket_manager->Connect(addr, port, connection);
     if (0 != ret)
     {
         return ret - 10000;
     }
-    return WriteMessage(self_node.connection, req, Priority::kPriority_High_2);
+    return WriteMessage(connection, msg_bytes, req.GetDescriptor()->name(), Priority::kPriority_High_2);
 }
 
-void SendRegisterNodeAck(const std::shared_ptr<SocketConnection> &connection, bool get_subnode)
+void SendRegisterNodeAck(const std::shared_ptr<SocketConnection> &connection, const Node &register_node, bool get_subnode)
 {
     auto peer_node = Singleton<PeerNode>::instance();
     Node self_node = peer_node->self_node();
-    std::vector<Node> nodelist;
-    peer_node->GetAllPublicNodes(nodelist);
+    std::vector<std::shared_ptr<const Node>> nodelist;
+    peer_node->GetPublicNodes(nodelist);
     if (get_subnode && self_node.is_public_node)
     {
-        std::vector<Node> subnodelist;
-        if (peer_node->GetNodesByPublicBase58Addr(self_node.base58addr, subnodelist))
+        auto table = peer_node->nodes();
+        //注册节点从自己的记录中获得公网地址
+        auto node = table->Find(register_node.id);
+        if (nullptr != node && !node->is_public_node)
         {
-            nodelist.insert(nodelist.end(), subnodelist.begin(), subnodelist.end());
+            nodelist.push_back(node);
+        }
+        std::vector<NodeId> closest;
+        peer_node->routing_table().FindClosest(RoutingTable::GetKey(register_node.base58addr), kBucketSize, closest);
+        for (auto &id : closest)
+        {
+            node = table->Find(id);
+            if (nullptr != node && !node->is_public_node && id != register_node.id)
+            {
+                nodelist.push_back(node);
+            }
         }
     }
-    nodelist.push_back(self_node);
-    RegisterNodeAck ack;
+    //ack只有nodes字段,直接拼接各节点已缓存的编码
+    std::string msg_bytes;
     for (auto &node : nodelist)
     {
-        NodeInfo *nodeinfo = ack.add_nodes();
-        nodeinfo->set_pub(node.pub);
-        nodeinfo->set_sign(node.sign);
-        nodeinfo->set_base58addr(node.base58addr);
-        nodeinfo->set_public_base58addr(node.public_base58addr);
-        nodeinfo->set_local_ip(node.local_ip);
-        nodeinfo->set_listen_port(node.listen_port);
-        nodeinfo->set_public_ip(node.public_ip);
-        nodeinfo->set_public_port(node.public_port);
-        nodeinfo->set_is_public_node(node.is_public_node);
-        nodeinfo->set_height(node.height);
-        nodeinfo->set_sign_fee(node.sign_fee);
-        nodeinfo->set_package_fee(node.package_fee);
-        nodeinfo->set_version(node.version);
+        AppendNodeInfo(RegisterNodeAck::kNodesFieldNumber, *node, msg_bytes);
     }
-    WriteMessage(connection, ack, Priority::kPriority_High_2);
+    AppendNodeInfo(RegisterNodeAck::kNodesFieldNumber, self_node, msg_bytes);
+    ReplyMessage(connection, msg_bytes, RegisterNodeAck::descriptor()->name(), Priority::kPriority_High_2);
 }
 
-void SendSyncNodeReq(const std::string &base58addr)
+void SendSyncNodeReq(const Node &node)
 {
     SyncNodeReq req;
     auto peer_node = Singleton<PeerNode>::instance();
     Node self_node = peer_node->self_node();
     req.add_base58addrs(self_node.base58addr);
-    std::vector<Node> nodelist;
-    if (!peer_node->GetNodesByPublicBase58Addr(self_node.base58addr, nodelist))
-    {
-        return;
-    }
-    for (auto &node : nodelist)
-    {
-        NodeInfo *nodeinfo = req.add_nodes();
-        nodeinfo->set_pub(node.pub);
-        nodeinfo->set_sign(node.sign);
-        nodeinfo->set_base58addr(node.base58addr);
-        nodeinfo->set_public_base58addr(node.public_base58addr);
-        nodeinfo->set_local_ip(node.local_ip);
-        nodeinfo->set_listen_port(node.listen_port);
-        nodeinfo->set_public_ip(node.public_ip);
-        nodeinfo->set_public_port(node.public_port);
-        nodeinfo->set_is_public_node(node.is_public_node);
-        nodeinfo->set_height(node.height);
-        nodeinfo->set_sign_fee(node.sign_fee);
-        nodeinfo->set_package_fee(node.package_fee);
-        nodeinfo->set_version(node.version);
-    }
-    SendMessageToNode(base58addr, req, Priority::kPriority_High_2);
+    std::vector<std::shared_ptr<const Node>> nodelist;
+    peer_node->GetSubnodes(self_node.id, nodelist);
+    std::string nodes_bytes;
+    peer_node->node_sync().BuildSyncNodeReq(node.id, nodelist, req, nodes_bytes);
+    SendMessageToNode(node.base58addr, req.SerializeAsString() + nodes_bytes, req.GetDescriptor()->name(), Priority::kPriority_High_2);
 }
 
 void SendSyncNodeAck(const std::string &base58addr)
@@ -113,140 +187,170 @@ void SendSyncNodeAck(const std::string &base58addr)
     auto peer_node = Singleton<PeerNode>::instance();
     Node self_node = peer_node->self_node();
     ack.add_base58addrs(self_node.base58addr);
-    std::vector<Node> nodelist;
-    if (!peer_node->GetNodesByPublicBase58Addr(self_node.base58addr, nodelist))
+    std::vector<std::shared_ptr<const Node>> nodelist;
+    peer_node->GetSubnodes(self_node.id, nodelist);
+    if (nodelist.empty())
     {
         return;
     }
+    std::string msg_bytes = ack.SerializeAsString();
     for (auto &node : nodelist)
     {
-        NodeInfo *nodeinfo = ack.add_nodes();
-        nodeinfo->set_pub(node.pub);
-        nodeinfo->set_sign(node.sign);
-        nodeinfo->set_base58addr(node.base58addr);
-        nodeinfo->set_public_base58addr(node.public_base58addr);
-        nodeinfo->set_local_ip(node.local_ip);
-        nodeinfo->set_listen_port(node.listen_port);
-        nodeinfo->set_public_ip(node.public_ip);
-        nodeinfo->set_public_port(node.public_port);
-        nodeinfo->set_is_public_node(node.is_public_node);
-        nodeinfo->set_height(node.height);
-        nodeinfo->set_sign_fee(node.sign_fee);
-        nodeinfo->set_package_fee(node.package_fee);
-        nodeinfo->set_version(node.version);
+        AppendNodeInfo(SyncNodeAck::kNodesFieldNumber, *node, msg_bytes);
     }
-    return SendMessageToNode(base58addr, ack, Priority::kPriority_High_2);
+    return ReplyMessageToNode(base58addr, msg_bytes, ack.GetDescriptor()->name(), Priority::kPriority_High_2);
 }
 
 void SendConnectNodeReq(std::shared_ptr<SocketConnection> connection)
 {
-    ConnectNodeReq req;
-    Node self_node = Singleton<PeerNode>::instance()->self_node();
-    NodeInfo *node = req.mutable_node();
-    node->set_pub(self_node.pub);
-    node->set_sign(self_node.sign);
-    node->set_base58addr(self_node.base58addr);
-    node->set_public_base58addr("");
-    node->set_local_ip(self_node.local_ip);
-    node->set_listen_port(self_node.listen_port);
-    node->set_public_ip(0);
-    node->set_public_port(0);
-    node->set_is_public_node(self_node.is_public_node);
-    node->set_height(self_node.height);
-    node->set_sign_fee(self_node.sign_fee);
-    node->set_package_fee(self_node.package_fee);
-    node->set_version(g_version);
-    WriteMessage(connection, req, Priority::kPriority_High_2);
-}
-
-void SendBroadcaseMsgReq(const std::string &msg, Priority priority)
+    auto nodeinfo = Singleton<PeerNode>::instance()->self_connect_nodeinfo();
+    if (nullptr == nodeinfo)
+    {
+        return;
+    }
+    std::string msg_bytes;
+    AppendNodeInfo(ConnectNodeReq::kNodeFieldNumber, nodeinfo->bytes, msg_bytes);
+    WriteMessage(connection, msg_bytes, ConnectNodeReq::descriptor()->name(), Priority::kPriority_High_2);
+}
+
+//tree方式沿广播树推送给eager节点,flood方式随机选出fanout个公网节点并消耗一跳
+static void GetBroadcastPublicNodes(const std::shared_ptr<BroadcaseMsgReq> &req, const std::shared_ptr<const NodeTable> &table,
+                                    const std::shared_ptr<const Node> &prev_node, std::vector<std::shared_ptr<const Node>> &out_nodes)
+{
+    auto conf = Singleton<Config>::instance();
+    if ("tree" == conf->broadcast_mode())
+    {
+        std::vector<std::shared_ptr<const Node>> public_nodes;
+        table->GetPublicNodes(public_nodes);
+        Singleton<BroadcastTree>::instance()->OnMessage(req, nullptr == prev_node ? NodeId() : prev_node->id,
+                                                        public_nodes, out_nodes);
+        return;
+    }
+    if (0 == req->ttl())
+    {
+        return;
+    }
+    for (auto &id : table->public_nodes)
+    {
+        auto node = table->Find(id);
+        if (nullptr != node && node->is_connected() && node != prev_node && node->base58addr != req->from().base58addr())
+        {
+            out_nodes.push_back(node);
+        }
+    }
+    uint32_t fanout = conf->broadcast_fanout();
+    if (0 != fanout && out_nodes.size() > fanout)
+    {
+        static thread_local std::mt19937 engine(std::random_device{}());
+        std::shuffle(out_nodes.begin(), out_nodes.end(), engine);
+        out_nodes.resize(fanout);
+    }
+    req->set_ttl(req->ttl() - 1);
+}
+
+//公网节点转发给下属节点和其他公网节点,不发回给上一跳和发送者;下属节点只发给自己的公网节点
+static void ForwardBroadcaseMsgReq(const std::shared_ptr<BroadcaseMsgReq> &req, Priority priority, const std::shared_ptr<SocketConnection> &prev_connection)
 {
     auto peer_node = Singleton<PeerNode>::instance();
     Node self_node = peer_node->self_node();
+    auto table = peer_node->nodes();
+    std::shared_ptr<const Node> prev_node;
+    if (nullptr != prev_connection)
+    {
+        prev_node = peer_node->FindNodeByConnection(prev_connection->connection_id());
+    }
 
-    BroadcaseMsgReq req;
-    NodeInfo *node_info = req.mutable_from();
-    node_info->set_base58addr(self_node.base58addr);
-    node_info->set_is_public_node(self_node.is_public_node);
-    req.set_data(msg);
-    req.set_priority((uint8_t)priority);
-    std::string msg_data = req.SerializeAsString();
-    std::string type = req.GetDescriptor()->name();
-
-    std::string bytes;
-    Proto2Bytes(req.SerializeAsString(), req.GetDescriptor()->name(), priority,
-                Compress::kCompress_True, Encrypt::kEncrypt_Unencrypted, bytes);
-
+    std::vector<std::shared_ptr<const Node>> nodelist;
     if (self_node.is_public_node)
     {
-        std::vector<Node> nodelist;
-        peer_node->GetAllPublicNodes(nodelist);
-        std::vector<Node> subnodelist;
-        if (peer_node->GetNodesByPublicBase58Addr(self_node.public_base58addr, subnodelist))
+        table->GetSubnodes(self_node.id, nodelist);
+        GetBroadcastPublicNodes(req, table, prev_node, nodelist);
+    }
+    else
+    {
+        auto node = table->Find(self_node.public_id);
+        if (nullptr != node)
         {
-            nodelist.insert(nodelist.end(), subnodelist.begin(), subnodelist.end());
+            nodelist.push_back(node);
         }
-        for (auto &node : nodelist)
+    }
+
+    std::vector<std::shared_ptr<SocketConnection>> connections;
+    std::vector<std::string> base58addrs;
+    for (auto &node : nodelist)
+    {
+        if (!node->is_connected() || node == prev_node || node->base58addr == req->from().base58addr())
         {
-            if (nullptr != node.connection)
-            {
-                continue;
-            }
-            if (node.connection->IsConnected())
-            {
-                continue;
-            }
-            node.connection->WriteMsg(bytes);
+            continue;
         }
+        connections.push_back(node->runtime->connection.load());
+        base58addrs.push_back(node->base58addr);
     }
-    else
+    if (connections.empty())
     {
-        Node node;
-        if (!peer_node->FindNodeByBase58Addr(self_node.public_base58addr, node))
+        return;
+    }
+    std::vector<int> results;
+    BroadcastMessage(connections, *req, priority, results);
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        if (kWrite_Success != results.at(i))
         {
-            return;
+            DEBUGLOG("broadcast to {} failed, ret {}", base58addrs.at(i), results.at(i));
         }
-        WriteMessage(node.connection, req, priority);
     }
 }
 
-void SendTransMsgReq(const std::string &dest_base58addr, const std::string &bytes_msg, Priority priority, Compress compress, Encrypt encrypt)
+void SendBroadcaseMsgReq(const google::protobuf::Message &msg, Priority priority)
+{
+    Node self_node = Singleton<PeerNode>::instance()->self_node();
+
+    auto req = std::make_shared<BroadcaseMsgReq>();
+    NodeInfo *node_info = req->mutable_from();
+    node_info->set_base58addr(self_node.base58addr);
+    node_info->set_is_public_node(self_node.is_public_node);
+    std::string data;
+    Proto2Bytes(msg.SerializeAsString(), msg.GetDescriptor()->name(), priority,
+                Compress::kCompress_True, Encrypt::kEncrypt_Unencrypted, data);
+    req->set_data(data);
+    req->set_priority((uint8_t)priority);
+    req->set_msg_id(BroadcastCache::GetMsgId(self_node.base58addr, req->data()));
+    req->set_ttl(Singleton<Config>::instance()->broadcast_ttl());
+    Singleton<BroadcastCache>::instance()->Insert(req->msg_id());
+    ForwardBroadcaseMsgReq(req, priority, nullptr);
+}
+
+std::shared_ptr<SocketConnection> GetRelayConnection(const std::string &dest_base58addr)
 {
     auto peer_node = Singleton<PeerNode>::instance();
     Node self_node = peer_node->self_node();
-    TransMsgReq req;
-    req.set_data(bytes_msg);
-    req.set_priority((uint8_t)priority);
-    NodeInfo *destnode = req.mutable_dest();
-    destnode->set_base58addr(dest_base58addr);
-    Node node;
+    auto table = peer_node->nodes();
+    std::shared_ptr<const Node> node;
     if (self_node.is_public_node)
     {
-        if (!peer_node->FindNodeByBase58Addr(dest_base58addr, node))
-        {
-            return;
-        }
-        if (node.is_public_node)
-        {
-            node.connection->WriteMsg(bytes_msg);
-        }
-        else
+        //公网节点之间只能直连
+        node = table->Find(dest_base58addr);
+        if (nullptr == node || node->is_public_node)
         {
-            if (!peer_node->FindNodeByBase58Addr(node.public_base58addr, node))
-            {
-                return;
-            }
-            WriteMessage(node.connection, req, priority);
+            return nullptr;
         }
+        node = table->Find(node->public_id);
     }
     else
     {
-        if (!peer_node->FindNodeByBase58Addr(self_node.public_base58addr, node))
-        {
-            return;
-        }
-        WriteMessage(node.connection, req, priority);
+        node = table->Find(self_node.public_id);
     }
+    return nullptr == node ? nullptr : node->runtime->connection.load();
+}
+
+int SendTransMsgReq(std::shared_ptr<SocketConnection> connection, const std::string &dest_base58addr, const std::string &bytes_msg, Priority priority)
+{
+    TransMsgReq req;
+    req.set_data(bytes_msg);
+    req.set_priority((uint8_t)priority);
+    NodeInfo *destnode = req.mutable_dest();
+    destnode->set_base58addr(dest_base58addr);
+    return WriteMessage(connection, req, priority);
 }
 
 void SendPingReq(const std::string &base58addr)
@@ -254,163 +358,186 @@ void SendPingReq(const std::string &base58addr)
     PingReq req;
     Node self_node = Singleton<PeerNode>::instance()->self_node();
     req.set_base58addr(self_node.base58addr);
-    return SendMessageToNode(base58addr, req, Priority::kPriority_High_2);
+    req.set_timestamp(Heartbeat::Now());
+    if (Singleton<Config>::instance()->state_heartbeat_piggyback())
+    {
+        Singleton<StateAnnouncer>::instance()->GetState(*req.mutable_state());
+    }
+    SendMessageToNode(base58addr, req, Priority::kPriority_High_2);
 }
 
-void SendPongReq(const std::string &base58addr)
+void SendPongReq(const std::string &base58addr, uint64_t timestamp)
 {
     PongReq req;
     Node self_node = Singleton<PeerNode>::instance()->self_node();
     req.set_base58addr(self_node.base58addr);
-    req.set_height(self_node.height);
-    return SendMessageToNode(base58addr, req, Priority::kPriority_High_2);
+    req.set_height(self_node.runtime->height);
+    req.set_timestamp(timestamp);
+    if (Singleton<Config>::instance()->state_heartbeat_piggyback())
+    {
+        Singleton<StateAnnouncer>::instance()->GetState(*req.mutable_state());
+    }
+    return ReplyMessageToNode(base58addr, req, Priority::kPriority_High_2);
 }
 
 void SendEchoReq(const std::string &base58addr)
 {
     EchoReq req;
     req.set_base58addr(Singleton<PeerNode>::instance()->self_node().base58addr);
-    return SendMessageToNode(base58addr, req, Priority::kPriority_High_2);
+    SendMessageToNode(base58addr, req, Priority::kPriority_High_2);
 }
 
 void SendEchoAck(const std::string &base58addr)
 {
     EchoAck ack;
     ack.set_base58addr(Singleton<PeerNode>::instance()->self_node().base58addr);
-    return SendMessageToNode(base58addr, ack, Priority::kPriority_High_2);
+    return ReplyMessageToNode(base58addr, ack, Priority::kPriority_High_2);
 }
 
 void SendUpdateFeeReq()
 {
-    UpdateFeeReq req;
-    Node self_node = Singleton<PeerNode>::instance()->self_node();
-    req.set_base58addr(self_node.base58addr);
-    req.set_fee(self_node.sign_fee);
-    SendBroadcaseMsgReq(req.SerializeAsString(), Priority::kPriority_Low_0);
+    Singleton<StateAnnouncer>::instance()->Announce(StateAnnouncer::kField_SignFee);
 }
 
 void SendUpdatePackageFeeReq()
 {
-    UpdatePackageFeeReq req;
-    Node self_node = Singleton<PeerNode>::instance()->self_node();
-    req.set_base58addr(self_node.base58addr);
-    req.set_package_fee(self_node.package_fee);
-    SendBroadcaseMsgReq(req.SerializeAsString(), Priority::kPriority_Low_0);
+    Singleton<StateAnnouncer>::instance()->Announce(StateAnnouncer::kField_PackageFee);
 }
 
 void SendNodeHeightChangedReq()
 {
-    NodeHeightChangedReq req;
-    Node self_node = Singleton<PeerNode>::instance()->self_node();
-    req.set_base58addr(self_node.base58addr);
-    req.set_height(self_node.height);
-    SendBroadcaseMsgReq(req.SerializeAsString(), Priority::kPriority_High_2);
+    Singleton<StateAnnouncer>::instance()->Announce(StateAnnouncer::kField_Height);
 }
 
-int HandlerRegisterNodeReq(const std::shared_ptr<RegisterNodeReq> &msg, std::shared_ptr<SocketConnection> connection)
+void SendBroadcastIHaveReq(const std::string &base58addr, const std::vector<std::string> &msg_ids)
 {
-    auto peer_node = Singleton<PeerNode>::instance();
-    Node self_node = peer_node->self_node();
-    auto nodeinfo = msg->node();
-    if (nodeinfo.base58addr() == self_node.base58addr)
+    BroadcastIHaveReq req;
+    req.set_base58addr(Singleton<PeerNode>::instance()->self_node().base58addr);
+    for (auto &msg_id : msg_ids)
     {
-        return -1;
+        req.add_msg_ids(msg_id);
     }
-    Account::PublicKey key;
-    auto ret = key.LoadFromBytes(nodeinfo.pub());
-    if (ret < 0)
+    SendMessageToNode(base58addr, req, Priority::kPriority_Middle_0);
+}
+
+void SendBroadcastGraftReq(const std::string &base58addr, const std::vector<std::string> &msg_ids)
+{
+    BroadcastGraftReq req;
+    req.set_base58addr(Singleton<PeerNode>::instance()->self_node().base58addr);
+    for (auto &msg_id : msg_ids)
     {
-        return ret - 100;
+        req.add_msg_ids(msg_id);
     }
-    if (key.GetBase58addr() != nodeinfo.base58addr())
+    SendMessageToNode(base58addr, req, Priority::kPriority_Middle_0);
+}
+
+void SendBroadcastPruneReq(const std::string &base58addr)
+{
+    BroadcastPruneReq req;
+    req.set_base58addr(Singleton<PeerNode>::instance()->self_node().base58addr);
+    SendMessageToNode(base58addr, req, Priority::kPriority_Middle_0);
+}
+
+Task HandlerRegisterNodeReq(std::shared_ptr<RegisterNodeReq> msg, std::shared_ptr<SocketConnection> connection)
+{
+    auto peer_node = Singleton<PeerNode>::instance();
+    Node self_node = peer_node->self_node();
+    auto nodeinfo = msg->node();
+    if (nodeinfo.base58addr() == self_node.base58addr)
     {
-        return -2;
+        co_return -1;
     }
-    ret = key.VerifySign(nodeinfo.base58addr(), nodeinfo.sign());
+    int ret = 0;
+    co_await Offload([&ret, &nodeinfo]()
+                     { ret = Singleton<IdentityCache>::instance()->Verify(nodeinfo.pub(), nodeinfo.sign(), nodeinfo.base58addr()); });
     if (ret < 0)
     {
-        return ret - 200;
+        co_return ret - 1000;
     }
     Node register_node;
-    register_node.pub = nodeinfo.pub();
-    register_node.sign = nodeinfo.sign();
-    register_node.base58addr = nodeinfo.base58addr();
-    register_node.public_base58addr = self_node.public_base58addr;
-    register_node.local_ip = nodeinfo.local_ip();
-    register_node.listen_port = nodeinfo.listen_port();
+    NodeInfo2Node(nodeinfo, register_node);
+    register_node.public_id = self_node.public_id;
     register_node.public_ip = 0;
     register_node.public_port = 0;
     if(nullptr != connection && connection->IsConnected())
     {
         GetIpv4AndPortByFd(connection->fd(), register_node.public_ip, register_node.public_port);
     }
-    register_node.height = nodeinfo.height();
-    register_node.sign_fee = nodeinfo.sign_fee();
-    register_node.package_fee = nodeinfo.package_fee();
-    register_node.is_public_node = nodeinfo.is_public_node();
-    register_node.version = nodeinfo.version();
-    register_node.connection = connection;
+    register_node.runtime->connection = connection;
     if (!peer_node->AddNode(register_node))
     {
-        return -3;
+        //从其他公网节点切换过来的下属节点,以本次注册的信息和连接替换同步得到的记录
+        auto node = peer_node->FindNode(register_node.id);
+        if (nullptr == node || (node->is_connected() && node->runtime->connection.load() != connection))
+        {
+            co_return -3;
+        }
+        peer_node->UpdateNode(register_node);
+        peer_node->UpdateNodeConnect(register_node.id, connection);
     }
-    SendRegisterNodeAck(connection, self_node.is_public_node);
-    return 0;
+    SendRegisterNodeAck(connection, register_node, self_node.is_public_node);
+    co_return 0;
 }
 
 int HandlerRegisterNodeAck(const std::shared_ptr<RegisterNodeAck> &msg, std::shared_ptr<SocketConnection> connection)
 {
     auto peer_node = Singleton<PeerNode>::instance();
     Node self_node = peer_node->self_node();
-    Node node;
-    std::string public_base58addr;
+    NodeId public_id;
     for (auto &nodeinfo : msg->nodes())
     {
         if (nodeinfo.base58addr() == self_node.base58addr)
         {
-            peer_node->SetSelfNodePublicBase58Addr(nodeinfo.public_base58addr());
+            NodeId::FromBase58(nodeinfo.public_base58addr(), public_id);
+            peer_node->SetSelfNodePublicId(public_id);
             peer_node->SetSelfNodePublicIp(nodeinfo.public_ip());
             peer_node->SetSelfNodePublicPort(nodeinfo.public_port());
-            public_base58addr = nodeinfo.public_base58addr();
             break;
         }
     }
+    std::vector<Node> nodes;
+    nodes.reserve(msg->nodes_size());
     for (auto &nodeinfo : msg->nodes())
     {
         if (nodeinfo.base58addr() == self_node.base58addr)
         {
             continue;
         }
-        node.Clear();
-        node.pub = nodeinfo.pub();
-        node.sign = nodeinfo.sign();
-        node.base58addr = nodeinfo.base58addr();
-        node.public_base58addr = nodeinfo.public_base58addr();
-        node.local_ip = nodeinfo.local_ip();
-        node.listen_port = nodeinfo.listen_port();
-        node.public_ip = nodeinfo.public_ip();
-        node.public_port = nodeinfo.public_port();
-        node.height = nodeinfo.height();
-        node.sign_fee = nodeinfo.sign_fee();
-        node.package_fee = nodeinfo.package_fee();
-        node.is_public_node = nodeinfo.is_public_node();
-        node.version = nodeinfo.version();
-        if (nodeinfo.base58addr() == public_base58addr)
+        nodes.emplace_back();
+        Node &node = nodes.back();
+        NodeInfo2Node(nodeinfo, node);
+        if (!public_id.empty() && node.id == public_id)
         {
-            node.connection = connection;
-        }
-        if (!peer_node->AddNode(node))
-        {
-            peer_node->UpdateNode(node);
+            node.runtime->connection = connection;
         }
     }
+    peer_node->AddNodes(nodes, true);
+    //下属节点切换了公网节点,断开原来的连接
+    if (!self_node.is_public_node && !public_id.empty() && !self_node.public_id.empty() && self_node.public_id != public_id)
+    {
+        peer_node->UpdateNodeConnect(self_node.public_id, nullptr);
+    }
     peer_node->ConnectPublicList();
     return 0;
 }
 
+//公网节点的下属节点在本地的摘要
+static uint64_t GetSubnodesDigest(const NodeId &public_id)
+{
+    std::vector<std::shared_ptr<const Node>> nodelist;
+    Singleton<PeerNode>::instance()->GetSubnodes(public_id, nodelist);
+    uint64_t digest = 0;
+    for (auto &node : nodelist)
+    {
+        digest ^= NodeSync::Digest(*node);
+    }
+    return digest;
+}
+
 int HandlerSyncNodeReq(const std::shared_ptr<SyncNodeReq> &msg, std::shared_ptr<SocketConnection> connection)
 {
     auto peer_node = Singleton<PeerNode>::instance();
+    auto &node_sync = peer_node->node_sync();
     Node self_node = peer_node->self_node();
     Node node;
     std::vector<Node> nodes;
@@ -419,30 +546,78 @@ int HandlerSyncNodeReq(const std::shared_ptr<SyncNodeReq> &msg, std::shared_ptr<
         return -1;
     }
     auto base58addr = msg->base58addrs(0);
+    NodeId public_id;
+    if (!NodeId::FromBase58(base58addr, public_id))
+    {
+        return -2;
+    }
+    uint64_t self_digest = 0;
+    bool has_self = false;
     for (auto &nodeinfo : msg->nodes())
     {
-        if (nodeinfo.base58addr() != self_node.base58addr)
+        NodeInfo2Node(nodeinfo, node);
+        if (nodeinfo.base58addr() == self_node.base58addr)
         {
+            self_digest = NodeSync::Digest(node);
+            has_self = true;
             continue;
         }
-        node.Clear();
-        node.pub = nodeinfo.pub();
-        node.sign = nodeinfo.sign();
-        node.base58addr = nodeinfo.base58addr();
-        node.public_base58addr = nodeinfo.public_base58addr();
-        node.local_ip = nodeinfo.local_ip();
-        node.listen_port = nodeinfo.listen_port();
-        node.public_ip = nodeinfo.public_ip();
-        node.public_port = nodeinfo.public_port();
-        node.height = nodeinfo.height();
-        node.sign_fee = nodeinfo.sign_fee();
-        node.package_fee = nodeinfo.package_fee();
-        node.is_public_node = nodeinfo.is_public_node();
-        node.version = nodeinfo.version();
         nodes.push_back(node);
     }
-    peer_node->UpdateNodesByPublicBase58Addr(base58addr, nodes);
-    SendSyncNodeAck(base58addr);
+    //不支持增量同步的节点每次发送全部节点
+    if (0 == msg->seq())
+    {
+        peer_node->UpdateNodesByPublicId(public_id, nodes);
+        SendSyncNodeAck(base58addr);
+        return 0;
+    }
+    uint64_t seq = node_sync.replica_seq(public_id);
+    if (msg->is_full())
+    {
+        peer_node->UpdateNodesByPublicId(public_id, nodes);
+        seq = msg->seq();
+    }
+    else if (0 != seq && msg->base_seq() == seq)
+    {
+        if (!has_self)
+        {
+            self_digest = node_sync.replica_self_digest(public_id);
+        }
+        std::vector<NodeId> removed;
+        NodeId id;
+        for (auto &item : msg->removed())
+        {
+            if (!NodeId::FromBase58(item, id))
+            {
+                continue;
+            }
+            if (id == self_node.id)
+            {
+                self_digest = 0;
+                continue;
+            }
+            removed.push_back(id);
+        }
+        peer_node->UpdateNodesByPublicId(public_id, nodes, removed);
+        seq = msg->seq();
+    }
+    else
+    {
+        //版本不连续,等待对方按确认的版本重发
+        self_digest = node_sync.replica_self_digest(public_id);
+    }
+    if (seq == msg->seq() && (GetSubnodesDigest(public_id) ^ self_digest) != msg->digest())
+    {
+        DEBUGLOG("sync node from {} digest mismatch, seq {}", base58addr, seq);
+        seq = 0;
+    }
+    node_sync.SetReplica(public_id, seq, self_digest);
+
+    SyncNodeAck ack;
+    ack.add_base58addrs(self_node.base58addr);
+    ack.set_seq(seq);
+    ack.set_is_delta(true);
+    ReplyMessageToNode(base58addr, ack, Priority::kPriority_High_2);
     return 0;
 }
 
@@ -456,30 +631,34 @@ int HandlerSyncNodeAck(const std::shared_ptr<SyncNodeAck> &msg, std::shared_ptr<
     {
         return -1;
     }
-    auto base58addr = msg->base58addrs(0);
+    NodeId public_id;
+    if (!NodeId::FromBase58(msg->base58addrs(0), public_id))
+    {
+        return -2;
+    }
+    if (msg->is_delta())
+    {
+        //对方落后时立即补发变更
+        if (peer_node->node_sync().OnSyncNodeAck(public_id, msg->seq()))
+        {
+            auto node = peer_node->FindNode(public_id);
+            if (nullptr != node)
+            {
+                SendSyncNodeReq(*node);
+            }
+        }
+        return 0;
+    }
     for (auto &nodeinfo : msg->nodes())
     {
-        if (nodeinfo.base58addr() != self_node.base58addr)
+        if (nodeinfo.base58addr() == self_node.base58addr)
         {
             continue;
         }
-        node.Clear();
-        node.pub = nodeinfo.pub();
-        node.sign = nodeinfo.sign();
-        node.base58addr = nodeinfo.base58addr();
-        node.public_base58addr = nodeinfo.public_base58addr();
-        node.local_ip = nodeinfo.local_ip();
-        node.listen_port = nodeinfo.listen_port();
-        node.public_ip = nodeinfo.public_ip();
-        node.public_port = nodeinfo.public_port();
-        node.height = nodeinfo.height();
-        node.sign_fee = nodeinfo.sign_fee();
-        node.package_fee = nodeinfo.package_fee();
-        node.is_public_node = nodeinfo.is_public_node();
-        node.version = nodeinfo.version();
+        NodeInfo2Node(nodeinfo, node);
         nodes.push_back(node);
     }
-    peer_node->UpdateNodesByPublicBase58Addr(base58addr, nodes);
+    peer_node->UpdateNodesByPublicId(public_id, nodes);
     return 0;
 }
 
@@ -492,6 +671,11 @@ int HandlerConnectNodeReq(const std::shared_ptr<ConnectNodeReq> &msg, std::share
     {
         return -1;
     }
+    auto ret = Singleton<IdentityCache>::instance()->Verify(nodeinfo.pub(), nodeinfo.sign(), nodeinfo.base58addr());
+    if (ret < 0)
+    {
+        return ret - 1000;
+    }
     Node node;
     if (peer_node->FindNodeByBase58Addr(nodeinfo.base58addr(), node))
     {
@@ -504,28 +688,23 @@ int HandlerConnectNodeReq(const std::shared_ptr<ConnectNodeReq> &msg, std::share
             peer_node->DeleteNodeByBase58Addr(nodeinfo.base58addr());
         }
     }
-    node.Clear();
-    node.pub = nodeinfo.pub();
-    node.sign = nodeinfo.sign();
-    node.base58addr = nodeinfo.base58addr();
-    node.public_base58addr.clear();
-    node.local_ip = nodeinfo.local_ip();
-    node.listen_port = nodeinfo.listen_port();
+    NodeInfo2Node(nodeinfo, node);
+    node.public_id = NodeId();
     node.public_ip = 0;
     node.public_port = 0;
     if(nullptr != connection && connection->IsConnected())
     {
         GetIpv4AndPortByFd(connection->fd(), node.public_ip, node.public_port);
     }
-    node.height = nodeinfo.height();
-    node.sign_fee = nodeinfo.sign_fee();
-    node.package_fee = nodeinfo.package_fee();
-    node.is_public_node = nodeinfo.is_public_node();
-    node.version = nodeinfo.version();
-    node.connection = connection;
+    node.runtime->connection = connection;
     if(!peer_node->AddNode(node))
     {
-        peer_node->UpdateNodeConnect(node.base58addr, connection);
+        peer_node->UpdateNodeConnect(node.id, connection);
+    }
+    //重启后直接连接过来的公网节点立即同步下属节点,不必等到下一个同步周期
+    if (self_node.is_public_node && node.is_public_node)
+    {
+        SendSyncNodeReq(node);
     }
     return 0;
 }
@@ -539,8 +718,19 @@ int HandlerTransMsgReq(const std::shared_ptr<TransMsgReq> &msg, std::shared_ptr<
     if (dest_node_base58addr == self_node.base58addr)
     {
         MsgData msg_data;
-        Bytes2Proto(msg_bytes, msg_data.priority, msg_data.msg);
-        Singleton<ProtobufProcess>::instance()->Handle(msg_data);
+        if (Bytes2Proto(msg_bytes, msg_data) <= 0)
+        {
+            return -1;
+        }
+        if (nullptr != connection)
+        {
+            msg_data.relay_connection_id = connection->connection_id();
+        }
+        if (nullptr != ProtobufProcess::current_msg())
+        {
+            msg_data.recv_time = ProtobufProcess::current_msg()->recv_time;
+        }
+        Singleton<ProtobufProcess>::instance()->AddProcessData(msg_data);
         return 0;
     }
     Priority priority = (Priority)(msg->priority() & 0xE);
@@ -550,38 +740,72 @@ int HandlerTransMsgReq(const std::shared_ptr<TransMsgReq> &msg, std::shared_ptr<
 
 int HandlerBroadcaseMsgReq(const std::shared_ptr<BroadcaseMsgReq> &msg, std::shared_ptr<SocketConnection> connection)
 {
-    auto peer_node = Singleton<PeerNode>::instance();
-    Node self_node = peer_node->self_node();
-    MsgData msg_data;
-    Bytes2Proto(msg->data(), msg_data.priority, msg_data.msg);
-    auto ret = Singleton<ProtobufProcess>::instance()->Handle(msg_data);
-    if(ret < 0)
+    //旧版本的消息没有id,按原来的方式由下属节点的公网节点转发一次
+    if (msg->msg_id().empty())
     {
-        return ret;
+        msg->set_msg_id(BroadcastCache::GetMsgId(msg->from().base58addr(), msg->data()));
+        msg->set_ttl(msg->from().is_public_node() ? 0 : 1);
     }
-    std::vector<Node> nodelist;
-    if (self_node.is_public_node)
+    auto peer_node = Singleton<PeerNode>::instance();
+    if (!Singleton<BroadcastCache>::instance()->Insert(msg->msg_id()))
     {
-        peer_node->GetNodesByPublicBase58Addr(self_node.base58addr, nodelist);
-        if (!msg->from().is_public_node())
+        //广播树中重复收到的消息来自多余的连接
+        auto node = nullptr == connection ? nullptr : peer_node->FindNodeByConnection(connection->connection_id());
+        if (nullptr != node && node->is_public_node && "tree" == Singleton<Config>::instance()->broadcast_mode() &&
+            peer_node->self_node().is_public_node)
         {
-            std::vector<Node> pubnodelist;
-            peer_node->GetAllPublicNodes(pubnodelist);
-            nodelist.insert(nodelist.end(), pubnodelist.begin(), pubnodelist.end());
+            Singleton<BroadcastTree>::instance()->OnPrune(node->id);
+            SendBroadcastPruneReq(node->base58addr);
         }
+        return 0;
     }
-    return 0;
+    MsgData msg_data;
+    if (Bytes2Proto(msg->data(), msg_data) <= 0)
+    {
+        return -1;
+    }
+    if (nullptr != ProtobufProcess::current_msg())
+    {
+        msg_data.recv_time = ProtobufProcess::current_msg()->recv_time;
+    }
+    if (peer_node->self_node().is_public_node)
+    {
+        ForwardBroadcaseMsgReq(msg, msg_data.priority, connection);
+    }
+    return Singleton<ProtobufProcess>::instance()->Handle(msg_data);
 }
 
 int HandlerPingReq(const std::shared_ptr<PingReq> &msg, std::shared_ptr<SocketConnection> connection)
 {
-    SendPongReq(msg->base58addr());
+    SendPongReq(msg->base58addr(), msg->timestamp());
+    NodeId id;
+    if (msg->has_state() && NodeId::FromBase58(msg->base58addr(), id))
+    {
+        Singleton<StateAnnouncer>::instance()->OnState(id, msg->state());
+    }
     return 0;
 }
 
 int HandlerPongReq(const std::shared_ptr<PongReq> &msg, std::shared_ptr<SocketConnection> connection)
 {
-    Singleton<PeerNode>::instance()->UpdateNodeHeight(msg->base58addr(), msg->height());
+    auto peer_node = Singleton<PeerNode>::instance();
+    NodeId id;
+    if (!NodeId::FromBase58(msg->base58addr(), id))
+    {
+        return -1;
+    }
+    Singleton<Heartbeat>::instance()->OnPong(id, msg->timestamp());
+    if (msg->has_state())
+    {
+        Singleton<StateAnnouncer>::instance()->OnState(id, msg->state());
+        return 0;
+    }
+    //高度不变时不更新节点表
+    auto node = peer_node->FindNode(id);
+    if (nullptr != node && node->runtime->height != msg->height())
+    {
+        peer_node->UpdateNodeHeight(id, msg->height());
+    }
     return 0;
 }
 
@@ -593,24 +817,156 @@ int HandlerEchoReq(const std::shared_ptr<EchoReq> &msg, std::shared_ptr<SocketCo
 
 int HandlerEchoAck(const std::shared_ptr<EchoAck> &msg, std::shared_ptr<SocketConnection> connection)
 {
-    std::cout << msg->base58addr() << std::endl;
+    DEBUGLOG("echo ack from {}", msg->base58addr());
     return 0;
 }
 
 int HandlerUpdateFeeReq(const std::shared_ptr<UpdateFeeReq> &msg, std::shared_ptr<SocketConnection> connection)
 {
-    Singleton<PeerNode>::instance()->UpdateNodeSignFee(msg->base58addr(), msg->fee());
+    NodeId id;
+    if (!NodeId::FromBase58(msg->base58addr(), id))
+    {
+        return -1;
+    }
+    if (!Singleton<StateAnnouncer>::instance()->Accept(id, StateAnnouncer::kField_SignFee, msg->seq()))
+    {
+        return 0;
+    }
+    Singleton<PeerNode>::instance()->UpdateNodeSignFee(id, msg->fee());
     return 0;
 }
 
 int HandlerUpdatePackageFeeReq(const std::shared_ptr<UpdatePackageFeeReq> &msg, std::shared_ptr<SocketConnection> connection)
 {
-    Singleton<PeerNode>::instance()->UpdateNodePackageFee(msg->base58addr(), msg->package_fee());
+    NodeId id;
+    if (!NodeId::FromBase58(msg->base58addr(), id))
+    {
+        return -1;
+    }
+    if (!Singleton<StateAnnouncer>::instance()->Accept(id, StateAnnouncer::kField_PackageFee, msg->seq()))
+    {
+        return 0;
+    }
+    Singleton<PeerNode>::instance()->UpdateNodePackageFee(id, msg->package_fee());
     return 0;
 }
 
 int HandlerNodeHeightChangedReq(const std::shared_ptr<NodeHeightChangedReq> &msg, std::shared_ptr<SocketConnection> connection)
 {
-    Singleton<PeerNode>::instance()->UpdateNodeHeight(msg->base58addr(), msg->height());
+    NodeId id;
+    if (!NodeId::FromBase58(msg->base58addr(), id))
+    {
+        return -1;
+    }
+    if (!Singleton<StateAnnouncer>::instance()->Accept(id, StateAnnouncer::kField_Height, msg->seq()))
+    {
+        return 0;
+    }
+    Singleton<PeerNode>::instance()->UpdateNodeHeight(id, msg->height());
+    return 0;
+}
+
+int HandlerFindNodeReq(const std::shared_ptr<FindNodeReq> &msg, std::shared_ptr<SocketConnection> connection)
+{
+    auto peer_node = Singleton<PeerNode>::instance();
+    if (msg->target().size() != kKeyBits / 8)
+    {
+        return -1;
+    }
+    auto table = peer_node->nodes();
+    auto from_node = table->Find(msg->base58addr());
+    if (nullptr != from_node)
+    {
+        peer_node->UpdateRoutingTable(from_node->id, from_node->base58addr);
+    }
+    std::vector<NodeId> closest;
+    peer_node->routing_table().FindClosest(msg->target(), kBucketSize, closest);
+    std::string msg_bytes;
+    std::string nodeinfo;
+    for (auto &id : closest)
+    {
+        auto node = table->Find(id);
+        if (nullptr != node)
+        {
+            AppendNodeInfo(FindNodeAck::kNodesFieldNumber, *node, msg_bytes);
+        }
+        else if (peer_node->routing_table().GetNodeInfo(id, nodeinfo))
+        {
+            //查找得到的节点不在节点表中
+            AppendNodeInfo(FindNodeAck::kNodesFieldNumber, nodeinfo, msg_bytes);
+        }
+    }
+    if (nullptr != connection)
+    {
+        ReplyMessage(connection, msg_bytes, FindNodeAck::descriptor()->name(), Priority::kPriority_Middle_0);
+    }
+    else
+    {
+        //经公网节点转发的请求没有连接,通过转发回复
+        ReplyMessageToNode(msg->base58addr(), msg_bytes, FindNodeAck::descriptor()->name(), Priority::kPriority_Middle_0);
+    }
+    return 0;
+}
+
+//广播树的控制消息只接受直连的公网节点,发送者由连接确定,不使用消息中的地址
+static std::shared_ptr<const Node> GetBroadcastPeer(const std::shared_ptr<SocketConnection> &connection)
+{
+    if (nullptr == connection)
+    {
+        return nullptr;
+    }
+    auto node = Singleton<PeerNode>::instance()->FindNodeByConnection(connection->connection_id());
+    if (nullptr == node || !node->is_public_node)
+    {
+        return nullptr;
+    }
+    return node;
+}
+
+int HandlerBroadcastIHaveReq(const std::shared_ptr<BroadcastIHaveReq> &msg, std::shared_ptr<SocketConnection> connection)
+{
+    if (!Singleton<PeerNode>::instance()->self_node().is_public_node)
+    {
+        return -1;
+    }
+    auto node = GetBroadcastPeer(connection);
+    if (nullptr == node)
+    {
+        return -2;
+    }
+    std::vector<std::string> msg_ids(msg->msg_ids().begin(), msg->msg_ids().end());
+    Singleton<BroadcastTree>::instance()->OnIHave(node->id, msg_ids);
+    return 0;
+}
+
+int HandlerBroadcastGraftReq(const std::shared_ptr<BroadcastGraftReq> &msg, std::shared_ptr<SocketConnection> connection)
+{
+    if (!Singleton<PeerNode>::instance()->self_node().is_public_node)
+    {
+        return -1;
+    }
+    auto node = GetBroadcastPeer(connection);
+    if (nullptr == node)
+    {
+        return -2;
+    }
+    std::vector<std::string> msg_ids(msg->msg_ids().begin(), msg->msg_ids().end());
+    std::vector<std::shared_ptr<const BroadcaseMsgReq>> msgs;
+    Singleton<BroadcastTree>::instance()->OnGraft(node->id, msg_ids, msgs);
+    for (auto &item : msgs)
+    {
+        SendMessageToNode(node->base58addr, *item, (Priority)(item->priority() & 0xE));
+    }
+    return 0;
+}
+
+int HandlerBroadcastPruneReq(const std::shared_ptr<BroadcastPruneReq> &msg, std::shared_ptr<SocketConnection> connection)
+{
+    auto node = GetBroadcastPeer(connection);
+    if (nullptr == node)
+    {
+        return -1;
+    }
+    Singleton<BroadcastTree>::instance()->OnPrune(node->id);
     return 0;
 }
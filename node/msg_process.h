@@ -4,28 +4,43 @@
 #include "proto/node.pb.h"
 #include "socket/socket_api.h"
 
+struct Node;
+struct EncodedNodeInfo;
+void NodeInfo2Node(const NodeInfo &nodeinfo, Node &out_node);
+void Node2NodeInfo(const Node &node, NodeInfo *out_nodeinfo);
+std::shared_ptr<const EncodedNodeInfo> SerializeNodeInfo(const Node &node);
+//将NodeInfo编码作为消息的field_number字段追加到out_bytes,与消息其余字段的编码拼接即为完整的消息
+void AppendNodeInfo(uint32_t field_number, const std::string &nodeinfo, std::string &out_bytes);
+//优先使用节点已缓存的编码
+void AppendNodeInfo(uint32_t field_number, const Node &node, std::string &out_bytes);
+
 int SendRegisterNodeReq(std::string addr, uint16_t port);
 
-void SendRegisterNodeAck(const std::shared_ptr<SocketConnection> &connection, bool get_subnode);
+//回复公网节点和距离注册节点最近的kBucketSize个节点,其余节点由注册节点通过查找获得
+void SendRegisterNodeAck(const std::shared_ptr<SocketConnection> &connection, const Node &register_node, bool get_subnode);
 
-void SendSyncNodeReq(const std::string &base58addr);
+void SendSyncNodeReq(const Node &node);
 
 void SendSyncNodeAck(const std::string &base58addr);
 
 void SendConnectNodeReq(std::shared_ptr<SocketConnection> connection);
 
-void SendBroadcaseMsgReq(const std::string &msg, Priority priority);
+void SendBroadcaseMsgReq(const google::protobuf::Message &msg, Priority priority);
 
-void SendTransMsgReq(const std::string &dest_base58addr, const std::string &msg, Priority priority, Compress compress, Encrypt encrypt);
+//没有直连时转发消息的连接: 公网节点为目标所属公网节点的连接,下属节点为自身公网节点的连接
+std::shared_ptr<SocketConnection> GetRelayConnection(const std::string &dest_base58addr);
+//通过connection转发已编码的消息msg
+int SendTransMsgReq(std::shared_ptr<SocketConnection> connection, const std::string &dest_base58addr, const std::string &msg, Priority priority);
 
 void SendPingReq(const std::string &base58addr);
 
-void SendPongReq(const std::string &base58addr);
+void SendPongReq(const std::string &base58addr, uint64_t timestamp);
 
 void SendEchoReq(const std::string &base58addr);
 
 void SendEchoAck(const std::string &base58addr);
 
+//以下三个函数广播自身节点的最新值,短时间内的多次调用合并为一次广播,见StateAnnouncer
 void SendUpdateFeeReq();
 
 void SendUpdatePackageFeeReq();
@@ -36,7 +51,14 @@ void SendGetNodeCacheAck(const std::string &base58addr, bool is_fetch_public);
 
 void SendNodeHeightChangedReq();
 
-int HandlerRegisterNodeReq(const std::shared_ptr<RegisterNodeReq> &msg, std::shared_ptr<SocketConnection> connection);
+void SendBroadcastIHaveReq(const std::string &base58addr, const std::vector<std::string> &msg_ids);
+
+void SendBroadcastGraftReq(const std::string &base58addr, const std::vector<std::string> &msg_ids);
+
+void SendBroadcastPruneReq(const std::string &base58addr);
+
+//验证签名在阻塞操作线程池中执行,不占用注册线程池
+Task HandlerRegisterNodeReq(std::shared_ptr<RegisterNodeReq> msg, std::shared_ptr<SocketConnection> connection);
 
 int HandlerRegisterNodeAck(const std::shared_ptr<RegisterNodeAck> &msg, std::shared_ptr<SocketConnection> connection);
 
@@ -64,4 +86,12 @@ int HandlerUpdatePackageFeeReq(const std::shared_ptr<UpdatePackageFeeReq> &msg,
 
 int HandlerNodeHeightChangedReq(const std::shared_ptr<NodeHeightChangedReq> &msg, std::shared_ptr<SocketConnection> connection);
 
+int HandlerFindNodeReq(const std::shared_ptr<FindNodeReq> &msg, std::shared_ptr<SocketConnection> connection);
+
+int HandlerBroadcastIHaveReq(const std::shared_ptr<BroadcastIHaveReq> &msg, std::shared_ptr<SocketConnection> connection);
+
+int HandlerBroadcastGraftReq(const std::shared_ptr<BroadcastGraftReq> &msg, std::shared_ptr<SocketConnection> connection);
+
+int HandlerBroadcastPruneReq(const std::shared_ptr<BroadcastPruneReq> &msg, std::shared_ptr<SocketConnection> connection);
+
 #endif
@@ -1,27 +1,46 @@
 #include "node/node_api.h"
 #include "common/config.h"
+#include "common/logging.h"
+#include "node/bootstrap.h"
+#include "node/broadcast.h"
+#include "node/heartbeat.h"
 #include "node/msg_process.h"
 #include "socket/socket_api.h"
+#include "utils/net_utils.h"
 #include "utils/singleton.hpp"
+#include <algorithm>
 #include <random>
 #include <thread>
 
+//同一连接的消息在各线程池之间按到达顺序执行,只有直接处理(kExecution_Inline)的消息可以乱序:
+// PingReq/PongReq: 附带的高度和手续费按序号更新,RTT只与本次的时间戳有关
+// EchoReq/EchoAck: 不修改状态
+// BroadcastIHaveReq: 消息稍后到达时删除对应的缺失记录,超时前不会请求
+// BroadcastPruneReq: 只将对方改为惰性节点,之后的广播消息仍会处理
 static void RegisterCallback()
 {
-    RegisterCallback<RegisterNodeReq>(HandlerRegisterNodeReq);
-    RegisterCallback<RegisterNodeAck>(HandlerRegisterNodeAck);
-    RegisterCallback<SyncNodeReq>(HandlerSyncNodeReq);
-    RegisterCallback<SyncNodeAck>(HandlerSyncNodeAck);
-    RegisterCallback<ConnectNodeReq>(HandlerConnectNodeReq);
-    RegisterCallback<TransMsgReq>(HandlerTransMsgReq);
-    RegisterCallback<BroadcaseMsgReq>(HandlerBroadcaseMsgReq);
-    RegisterCallback<PingReq>(HandlerPingReq);
-    RegisterCallback<PongReq>(HandlerPongReq);
-    RegisterCallback<EchoReq>(HandlerEchoReq);
-    RegisterCallback<EchoAck>(HandlerEchoAck);
-    RegisterCallback<UpdateFeeReq>(HandlerUpdateFeeReq);
-    RegisterCallback<UpdatePackageFeeReq>(HandlerUpdatePackageFeeReq);
-    RegisterCallback<NodeHeightChangedReq>(HandlerNodeHeightChangedReq);
+    RegisterCallback<RegisterNodeReq>(HandlerRegisterNodeReq, kExecution_Dedicated);
+    RegisterCallback<RegisterNodeAck>(HandlerRegisterNodeAck, kExecution_Bulk);
+    RegisterCallback<SyncNodeReq>(HandlerSyncNodeReq, kExecution_Bulk);
+    RegisterCallback<SyncNodeAck>(HandlerSyncNodeAck, kExecution_Bulk);
+    RegisterCallback<ConnectNodeReq>(HandlerConnectNodeReq, kExecution_Control);
+    RegisterCallback<TransMsgReq>(HandlerTransMsgReq, kExecution_Bulk);
+    RegisterCallback<BroadcaseMsgReq>(HandlerBroadcaseMsgReq, kExecution_Bulk);
+    RegisterCallback<PingReq>(HandlerPingReq, kExecution_Inline);
+    RegisterCallback<PongReq>(HandlerPongReq, kExecution_Inline);
+    RegisterCallback<EchoReq>(HandlerEchoReq, kExecution_Inline);
+    RegisterCallback<EchoAck>(HandlerEchoAck, kExecution_Inline);
+    RegisterCallback<UpdateFeeReq>(HandlerUpdateFeeReq, kExecution_Bulk);
+    RegisterCallback<UpdatePackageFeeReq>(HandlerUpdatePackageFeeReq, kExecution_Bulk);
+    RegisterCallback<NodeHeightChangedReq>(HandlerNodeHeightChangedReq, kExecution_Bulk);
+    RegisterCallback<FindNodeReq>(HandlerFindNodeReq, kExecution_Bulk);
+    RegisterCallback<BroadcastIHaveReq>(HandlerBroadcastIHaveReq, kExecution_Inline);
+    RegisterCallback<BroadcastGraftReq>(HandlerBroadcastGraftReq, kExecution_Bulk);
+    RegisterCallback<BroadcastPruneReq>(HandlerBroadcastPruneReq, kExecution_Inline);
+
+    //手续费广播会被后续的广播覆盖,积压过久的不再处理
+    SetMsgTimeToLive<UpdateFeeReq>(30 * 1000);
+    SetMsgTimeToLive<UpdatePackageFeeReq>(30 * 1000);
 }
 
 int NodeInit()
@@ -33,44 +52,115 @@ int NodeInit()
     {
         return ret - 10;
     }
+    peer_node->LoadPeerCache();
     peer_node->ThreadStart();
+    Singleton<BroadcastTree>::instance()->ThreadStart();
+    Singleton<Heartbeat>::instance()->ThreadStart();
     return 0;
 }
 void NodeDestroy()
 {
     Singleton<PeerNode>::instance()->ThreadStop();
+    Singleton<BroadcastTree>::instance()->ThreadStop();
+    Singleton<Heartbeat>::instance()->ThreadStop();
 }
 
 void Register2PublicNode()
 {
+    auto conf = Singleton<Config>::instance();
     std::vector<PublicNode> public_nodes;
-    if (!Singleton<Config>::instance()->public_node_list(public_nodes))
+    conf->public_node_list(public_nodes);
+    //上次运行时保存的公网节点
+    std::vector<Node> cached_nodes;
+    Singleton<PeerNode>::instance()->GetCachedPublicNodes(cached_nodes);
+    for (auto &node : cached_nodes)
+    {
+        PublicNode public_node;
+        Int2StrIPv4(node.local_ip, public_node.ip);
+        public_node.port = node.listen_port;
+        if (public_nodes.end() == std::find_if(public_nodes.begin(), public_nodes.end(), [&public_node](const PublicNode &item)
+                                               { return item.ip == public_node.ip && item.port == public_node.port; }))
+        {
+            public_nodes.push_back(public_node);
+        }
+    }
+    if (public_nodes.empty())
     {
         return;
     }
-    while (!public_nodes.empty())
+    //不可达的节点之间保持随机顺序
+    static std::mt19937 engine(std::random_device{}());
+    std::shuffle(public_nodes.begin(), public_nodes.end(), engine);
+    std::vector<std::pair<in_addr_t, in_port_t>> addrs;
+    for (auto &node : public_nodes)
     {
-        int index = rand() % public_nodes.size();
-        PublicNode node = public_nodes.at(index);
-        public_nodes.erase(public_nodes.begin() + index);
-        if (0 == SendRegisterNodeReq(node.ip, node.port))
-        {
-            return;
-        }
+        in_addr_t addr = 0;
+        Str2IntIPv4(node.ip, addr);
+        addrs.push_back(std::make_pair(addr, node.port));
     }
+    std::vector<uint32_t> times;
+    ProbeConnectTime(addrs, conf->public_node_probe_timeout(), times);
+    std::vector<size_t> indexes(public_nodes.size());
+    for (size_t i = 0; i < indexes.size(); ++i)
+    {
+        indexes[i] = i;
+    }
+    //按建立连接的时间从快到慢依次发起注册,探测不到的节点放在最后
+    std::stable_sort(indexes.begin(), indexes.end(), [&times](size_t a, size_t b)
+                     { return times[a] < times[b]; });
+    std::vector<PublicNode> candidates;
+    candidates.reserve(indexes.size());
+    for (auto index : indexes)
+    {
+        PublicNode &node = public_nodes.at(index);
+        DEBUGLOG("public node {}:{}, connect time {}us", node.ip, node.port, times[index]);
+        candidates.push_back(node);
+    }
+    Bootstrap::Start(candidates);
 }
 
-void SendMessageToNode(const std::string &base58addr, const std::string &bytes_msg, const std::string &type, Priority priority, Compress compress, Encrypt encrypt)
+int SendMessageToNode(const std::string &base58addr, const std::string &bytes_msg, const std::string &type, Priority priority, Compress compress, Encrypt encrypt)
 {
-    std::string msg;
-    Proto2Bytes(bytes_msg, type, priority, compress, encrypt, msg);
-    Node node;
-    if (Singleton<PeerNode>::instance()->FindNodeByBase58Addr(base58addr, node) && node.is_connected())
+    return SendMessageToNode(base58addr, bytes_msg, type, priority, compress, encrypt, 0, false);
+}
+
+int SendMessageToNode(const std::string &base58addr, const std::string &bytes_msg, const std::string &type, Priority priority,
+                      Compress compress, Encrypt encrypt, uint64_t correlation_id, bool is_response)
+{
+    bool relay = false;
+    auto connection = GetNodeRoute(base58addr, relay);
+    return SendMessageToRoute(connection, relay, base58addr, bytes_msg, type, priority, compress, encrypt, correlation_id, is_response);
+}
+
+std::shared_ptr<SocketConnection> GetNodeRoute(const std::string &base58addr, bool &out_relay)
+{
+    out_relay = false;
+    auto node = Singleton<PeerNode>::instance()->FindNode(base58addr);
+    auto connection = nullptr == node ? nullptr : node->runtime->connection.load();
+    if (nullptr != connection && connection->IsConnected())
     {
-        node.connection->WriteMsg(msg);
+        return connection;
     }
-    else
+    out_relay = true;
+    return GetRelayConnection(base58addr);
+}
+
+int SendMessageToRoute(std::shared_ptr<SocketConnection> connection, bool relay, const std::string &base58addr, const std::string &bytes_msg,
+                       const std::string &type, Priority priority, Compress compress, Encrypt encrypt, uint64_t correlation_id, bool is_response)
+{
+    if (nullptr == connection)
     {
-        SendTransMsgReq(base58addr, msg, priority, compress, encrypt);
+        return -1;
     }
+    std::string msg;
+    Proto2Bytes(bytes_msg, type, priority, compress, encrypt, correlation_id, is_response, msg);
+    int ret = relay ? SendTransMsgReq(connection, base58addr, msg, priority) : connection->WriteMsg(msg);
+    return ret < 0 ? ret - 100 : 0;
+}
+
+void ReplyMessageToNode(const std::string &base58addr, const std::string &bytes_msg, const std::string &type, Priority priority, Compress compress, Encrypt encrypt)
+{
+    const MsgData *current = ProtobufProcess::current_msg();
+    uint64_t correlation_id = (nullptr == current || current->is_response) ? 0 : current->correlation_id;
+    SendMessageToNode(base58addr, bytes_msg, type, priority, compress, encrypt, correlation_id, 0 != correlation_id);
 }
@@ -8,14 +8,80 @@ void NodeDestroy();
 
 void Register2PublicNode();
 
-void SendMessageToNode(const std::string &base58addr, const std::string &msg, const std::string &type, Priority priority,
-                       Compress compress = Compress::kCompress_True, Encrypt encrypt = Encrypt::kEncrypt_Unencrypted);
+//返回值小于0时消息未发出
+int SendMessageToNode(const std::string &base58addr, const std::string &msg, const std::string &type, Priority priority,
+                      Compress compress = Compress::kCompress_True, Encrypt encrypt = Encrypt::kEncrypt_Unencrypted);
+
+int SendMessageToNode(const std::string &base58addr, const std::string &msg, const std::string &type, Priority priority,
+                      Compress compress, Encrypt encrypt, uint64_t correlation_id, bool is_response);
 
 template <typename T>
-void SendMessageToNode(const std::string &base58addr, const T &msg, Priority priority,
-                       Compress compress = Compress::kCompress_True, Encrypt encrypt = Encrypt::kEncrypt_Unencrypted)
+int SendMessageToNode(const std::string &base58addr, const T &msg, Priority priority,
+                      Compress compress = Compress::kCompress_True, Encrypt encrypt = Encrypt::kEncrypt_Unencrypted)
 {
     return SendMessageToNode(base58addr, msg.SerializeAsString(), msg.GetDescriptor()->name(), priority, compress, encrypt);
 }
 
+//回复当前正在处理的请求
+void ReplyMessageToNode(const std::string &base58addr, const std::string &msg, const std::string &type, Priority priority,
+                        Compress compress = Compress::kCompress_True, Encrypt encrypt = Encrypt::kEncrypt_Unencrypted);
+
+template <typename T>
+void ReplyMessageToNode(const std::string &base58addr, const T &msg, Priority priority,
+                        Compress compress = Compress::kCompress_True, Encrypt encrypt = Encrypt::kEncrypt_Unencrypted)
+{
+    return ReplyMessageToNode(base58addr, msg.SerializeAsString(), msg.GetDescriptor()->name(), priority, compress, encrypt);
+}
+
+//发往节点的消息写入的连接,没有直连时为转发的连接,此时out_relay为true,找不到时返回nullptr
+std::shared_ptr<SocketConnection> GetNodeRoute(const std::string &base58addr, bool &out_relay);
+//将消息经GetNodeRoute得到的连接发往节点
+int SendMessageToRoute(std::shared_ptr<SocketConnection> connection, bool relay, const std::string &base58addr, const std::string &msg,
+                       const std::string &type, Priority priority, Compress compress, Encrypt encrypt, uint64_t correlation_id, bool is_response);
+
+//向节点发送请求并等待Rsp类型的回复,超时或停止服务时以错误码调用回调
+//只接受从请求写入的连接收到的回复,返回值小于0时请求未发出且不会调用回调
+template <typename Rsp, typename Req>
+int CallMessageToNode(const std::string &base58addr, const Req &req, Priority priority, uint32_t timeout_ms, RpcCallback<Rsp> cb)
+{
+    bool relay = false;
+    auto connection = GetNodeRoute(base58addr, relay);
+    if (nullptr == connection)
+    {
+        return -1;
+    }
+    auto rpc = Singleton<RpcManager>::instance();
+    const std::string &type = req.GetDescriptor()->name();
+    uint64_t correlation_id = rpc->AddPendingCall<Rsp>(type, timeout_ms, connection->connection_id(), cb);
+    auto ret = SendMessageToRoute(connection, relay, base58addr, req.SerializeAsString(), type, priority, Compress::kCompress_True,
+                                  Encrypt::kEncrypt_Unencrypted, correlation_id, false);
+    if (ret < 0)
+    {
+        rpc->CancelPendingCall(correlation_id);
+        return ret;
+    }
+    return 0;
+}
+
+template <typename Rsp, typename Req>
+std::future<RpcResult<Rsp>> CallMessageToNode(const std::string &base58addr, const Req &req, Priority priority, uint32_t timeout_ms)
+{
+    std::future<RpcResult<Rsp>> future;
+    auto cb = MakeRpcPromise<Rsp>(future);
+    auto ret = CallMessageToNode<Rsp>(base58addr, req, priority, timeout_ms, cb);
+    if (ret < 0)
+    {
+        cb(ret, nullptr);
+    }
+    return future;
+}
+
+template <typename Rsp, typename Req>
+RpcAwaiter<Rsp> CallMessageToNodeAsync(const std::string &base58addr, const Req &req, Priority priority, uint32_t timeout_ms)
+{
+    return RpcAwaiter<Rsp>([base58addr, req, priority, timeout_ms](RpcCallback<Rsp> cb)
+                           {
+                               return CallMessageToNode<Rsp>(base58addr, req, priority, timeout_ms, cb); });
+}
+
 #endif
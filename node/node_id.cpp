@@ -0,0 +1,53 @@
+#include "node/node_id.h"
+#include <cryptopp/sha.h>
+#include <libbase58.h>
+
+//地址的版本号
+static const uint8_t kAddrVersion = 0x00;
+//版本号 + id + 校验和
+static const size_t kAddrSize = 1 + kNodeIdSize + 4;
+
+static void GetChecksum(const uint8_t *data, size_t size, uint8_t *out_checksum)
+{
+    uint8_t hash[CryptoPP::SHA256::DIGESTSIZE];
+    CryptoPP::SHA256().CalculateDigest(hash, data, size);
+    CryptoPP::SHA256().CalculateDigest(hash, hash, sizeof(hash));
+    memcpy(out_checksum, hash, 4);
+}
+
+bool NodeId::FromBase58(const std::string &base58addr, NodeId &out_id)
+{
+    uint8_t addr[kAddrSize];
+    size_t size = sizeof(addr);
+    if (base58addr.empty() || !b58tobin(addr, &size, base58addr.data(), base58addr.size()) || sizeof(addr) != size)
+    {
+        return false;
+    }
+    uint8_t checksum[4];
+    GetChecksum(addr, 1 + kNodeIdSize, checksum);
+    if (kAddrVersion != addr[0] || 0 != memcmp(checksum, addr + 1 + kNodeIdSize, sizeof(checksum)))
+    {
+        return false;
+    }
+    memcpy(out_id.bytes.data(), addr + 1, kNodeIdSize);
+    return true;
+}
+
+std::string NodeId::ToBase58() const
+{
+    if (empty())
+    {
+        return std::string();
+    }
+    uint8_t addr[kAddrSize];
+    addr[0] = kAddrVersion;
+    memcpy(addr + 1, bytes.data(), kNodeIdSize);
+    GetChecksum(addr, 1 + kNodeIdSize, addr + 1 + kNodeIdSize);
+    char base58addr[64] = {0};
+    size_t size = sizeof(base58addr);
+    if (!b58enc(base58addr, &size, addr, sizeof(addr)))
+    {
+        return std::string();
+    }
+    return std::string(base58addr, size - 1);
+}
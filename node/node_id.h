@@ -0,0 +1,50 @@
+#ifndef UENC_NODE_NODE_ID_H_
+#define UENC_NODE_NODE_ID_H_
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+//base58地址中公钥hash的长度
+const size_t kNodeIdSize = 20;
+
+//节点id,即base58地址中公钥的RIPEMD160 hash
+//节点表内部以此为key,只在接口和日志中使用base58地址
+struct NodeId
+{
+    std::array<uint8_t, kNodeIdSize> bytes{};
+
+    //解析base58地址并校验版本和校验和
+    static bool FromBase58(const std::string &base58addr, NodeId &out_id);
+    //空id编码为空字符串
+    std::string ToBase58() const;
+
+    bool empty() const
+    {
+        for (auto byte : bytes)
+        {
+            if (0 != byte)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    bool operator==(const NodeId &id) const { return bytes == id.bytes; }
+    bool operator!=(const NodeId &id) const { return bytes != id.bytes; }
+    bool operator<(const NodeId &id) const { return bytes < id.bytes; }
+};
+
+struct NodeIdHash
+{
+    //id本身是hash,直接取前8个字节
+    size_t operator()(const NodeId &id) const
+    {
+        size_t hash = 0;
+        memcpy(&hash, id.bytes.data(), sizeof(hash));
+        return hash;
+    }
+};
+
+#endif
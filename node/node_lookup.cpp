@@ -0,0 +1,161 @@
+#include "node/node_lookup.h"
+#include "common/logging.h"
+#include "node/identity_cache.h"
+#include "node/msg_process.h"
+#include "node/node_api.h"
+#include "node/routing_table.h"
+
+void NodeLookup::Start(const std::string &target, std::function<void(const std::vector<std::string> &closest)> cb)
+{
+    auto lookup = std::make_shared<NodeLookup>(target, cb);
+    std::vector<NodeId> closest;
+    Singleton<PeerNode>::instance()->routing_table().FindClosest(target, kBucketSize, closest);
+    {
+        std::lock_guard<std::mutex> lck(lookup->mutex_);
+        for (auto &id : closest)
+        {
+            lookup->AddCandidate(id.ToBase58(), std::string());
+        }
+    }
+    lookup->Step();
+}
+
+NodeLookup::NodeLookup(const std::string &target, std::function<void(const std::vector<std::string> &closest)> cb)
+    : target_(target), cb_(cb)
+{
+    self_base58addr_ = Singleton<PeerNode>::instance()->self_node().base58addr;
+    inflight_ = 0;
+    finished_ = false;
+}
+
+void NodeLookup::AddCandidate(const std::string &base58addr, const std::string &nodeinfo)
+{
+    if (base58addr.empty() || base58addr == self_base58addr_)
+    {
+        return;
+    }
+    if (candidates_.emplace(RoutingTable::Distance(RoutingTable::GetKey(base58addr), target_), base58addr).second && !nodeinfo.empty())
+    {
+        nodeinfos_.emplace(base58addr, nodeinfo);
+    }
+}
+
+void NodeLookup::Step()
+{
+    std::vector<std::string> send_addrs;
+    std::vector<std::string> closest;
+    bool done = false;
+    {
+        std::lock_guard<std::mutex> lck(mutex_);
+        if (finished_)
+        {
+            return;
+        }
+        size_t index = 0;
+        for (auto it = candidates_.begin(); candidates_.end() != it && index < kBucketSize; ++it, ++index)
+        {
+            if (inflight_ + send_addrs.size() >= kLookupAlpha)
+            {
+                break;
+            }
+            if (queried_.insert(it->second).second)
+            {
+                send_addrs.push_back(it->second);
+            }
+        }
+        inflight_ += send_addrs.size();
+        if (0 == inflight_)
+        {
+            //最近的节点都已询问过
+            finished_ = true;
+            done = true;
+            for (auto &item : candidates_)
+            {
+                if (closest.size() >= kBucketSize)
+                {
+                    break;
+                }
+                if (responded_.end() != responded_.find(item.second))
+                {
+                    closest.push_back(item.second);
+                }
+            }
+        }
+    }
+    if (done && nullptr != cb_)
+    {
+        cb_(closest);
+    }
+    if (send_addrs.empty())
+    {
+        return;
+    }
+    FindNodeReq req;
+    req.set_base58addr(self_base58addr_);
+    req.set_target(target_);
+    auto self = shared_from_this();
+    for (auto &base58addr : send_addrs)
+    {
+        auto ret = CallMessageToNode<FindNodeAck>(base58addr, req, Priority::kPriority_Middle_0, kLookupTimeout,
+                                                  [self, base58addr](int ret, const std::shared_ptr<FindNodeAck> &ack)
+                                                  { self->OnResponse(base58addr, ret, ack); });
+        //无法发出时立即按失败处理,不必等到超时
+        if (ret < 0)
+        {
+            OnResponse(base58addr, ret, nullptr);
+        }
+    }
+}
+
+void NodeLookup::OnResponse(const std::string &base58addr, int ret, const std::shared_ptr<FindNodeAck> &ack)
+{
+    //base58addr -> NodeInfo编码
+    std::vector<std::pair<std::string, std::string>> nodes;
+    if (kRpc_Success == ret && nullptr != ack)
+    {
+        //返回的节点校验身份后才加入候选
+        for (auto &nodeinfo : ack->nodes())
+        {
+            if (nodeinfo.base58addr() == self_base58addr_)
+            {
+                continue;
+            }
+            if (0 != Singleton<IdentityCache>::instance()->Verify(nodeinfo.pub(), nodeinfo.sign(), nodeinfo.base58addr()))
+            {
+                DEBUGLOG("find node from {} returned unverified node {}", base58addr, nodeinfo.base58addr());
+                continue;
+            }
+            nodes.push_back(std::make_pair(nodeinfo.base58addr(), nodeinfo.SerializeAsString()));
+        }
+    }
+    std::string responder_nodeinfo;
+    {
+        std::lock_guard<std::mutex> lck(mutex_);
+        --inflight_;
+        if (kRpc_Success != ret || nullptr == ack)
+        {
+            DEBUGLOG("find node from {} failed, ret {}", base58addr, ret);
+            candidates_.erase(RoutingTable::Distance(RoutingTable::GetKey(base58addr), target_));
+        }
+        else
+        {
+            responded_.insert(base58addr);
+            for (auto &node : nodes)
+            {
+                AddCandidate(node.first, node.second);
+            }
+            auto it = nodeinfos_.find(base58addr);
+            if (nodeinfos_.end() != it)
+            {
+                responder_nodeinfo = it->second;
+            }
+        }
+    }
+    //只有回复了请求的节点才加入路由表,不在节点表中的节点以返回的NodeInfo回复其他节点的查找
+    NodeId id;
+    if (kRpc_Success == ret && NodeId::FromBase58(base58addr, id))
+    {
+        Singleton<PeerNode>::instance()->UpdateRoutingTable(id, base58addr, responder_nodeinfo);
+    }
+    Step();
+}
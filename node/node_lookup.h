@@ -0,0 +1,51 @@
+#ifndef UENC_NODE_NODE_LOOKUP_H_
+#define UENC_NODE_NODE_LOOKUP_H_
+
+#include "proto/node.pb.h"
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+//同时等待回复的FindNodeReq数
+const uint32_t kLookupAlpha = 3;
+//等待FindNodeAck的时间(毫秒)
+const uint32_t kLookupTimeout = 3000;
+
+//迭代查找距离target最近的节点
+//每次向最近的未询问节点并行发送FindNodeReq,直到最近的kBucketSize个节点都已询问
+//回复了请求的节点加入路由表,查找到的节点不加入节点表
+class NodeLookup : public std::enable_shared_from_this<NodeLookup>
+{
+public:
+    //cb的参数为回复了请求的最近节点,由近到远
+    static void Start(const std::string &target, std::function<void(const std::vector<std::string> &closest)> cb);
+
+    NodeLookup(const std::string &target, std::function<void(const std::vector<std::string> &closest)> cb);
+    ~NodeLookup() = default;
+    NodeLookup(NodeLookup &&) = delete;
+    NodeLookup(const NodeLookup &) = delete;
+    NodeLookup &operator=(NodeLookup &&) = delete;
+    NodeLookup &operator=(const NodeLookup &) = delete;
+
+private:
+    void AddCandidate(const std::string &base58addr, const std::string &nodeinfo);
+    void Step();
+    void OnResponse(const std::string &base58addr, int ret, const std::shared_ptr<FindNodeAck> &ack);
+
+    std::mutex mutex_;
+    std::string target_;
+    std::string self_base58addr_;
+    std::map<std::string, std::string> candidates_; //与target的距离 -> base58addr
+    std::map<std::string, std::string> nodeinfos_;  //其他节点返回的候选 -> 校验过的NodeInfo编码
+    std::set<std::string> queried_;
+    std::set<std::string> responded_;
+    uint32_t inflight_;
+    bool finished_;
+    std::function<void(const std::vector<std::string> &closest)> cb_;
+};
+
+#endif
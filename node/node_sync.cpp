@@ -0,0 +1,195 @@
+#include "node/node_sync.h"
+#include "node/msg_process.h"
+#include "node/peer_node.h"
+#include <unordered_set>
+
+static const uint64_t kFnvOffset = 14695981039346656037ULL;
+static const uint64_t kFnvPrime = 1099511628211ULL;
+
+static void FnvUpdate(uint64_t &hash, const void *data, size_t len)
+{
+    auto bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < len; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= kFnvPrime;
+    }
+}
+
+static void FnvUpdate(uint64_t &hash, const std::string &str)
+{
+    //包含结尾的0以区分相邻字段
+    FnvUpdate(hash, str.c_str(), str.size() + 1);
+}
+
+static void FnvUpdate(uint64_t &hash, const NodeId &id)
+{
+    FnvUpdate(hash, id.bytes.data(), id.bytes.size());
+}
+
+static void FnvUpdate(uint64_t &hash, uint64_t value)
+{
+    uint8_t bytes[8];
+    for (size_t i = 0; i < sizeof(bytes); ++i)
+    {
+        bytes[i] = (uint8_t)(value >> (i * 8));
+    }
+    FnvUpdate(hash, bytes, sizeof(bytes));
+}
+
+//节点不常变化的内容的hash,只在本地比较是否有变化
+//高度和手续费由心跳和状态广播更新,计入hash会使每次出块都产生增量
+static uint64_t ContentHash(const Node &node)
+{
+    uint64_t hash = kFnvOffset;
+    FnvUpdate(hash, node.pub);
+    FnvUpdate(hash, node.sign);
+    FnvUpdate(hash, node.id);
+    FnvUpdate(hash, node.public_id);
+    FnvUpdate(hash, node.version.str());
+    FnvUpdate(hash, node.local_ip);
+    FnvUpdate(hash, node.listen_port);
+    FnvUpdate(hash, node.public_ip);
+    FnvUpdate(hash, node.public_port);
+    FnvUpdate(hash, node.is_public_node);
+    return hash;
+}
+
+NodeSync::NodeSync()
+{
+    seq_ = 1; //0表示不支持增量同步的旧版本
+    digest_ = 0;
+    truncated_seq_ = 0;
+}
+
+uint64_t NodeSync::Digest(const Node &node)
+{
+    uint64_t hash = kFnvOffset;
+    FnvUpdate(hash, node.id);
+    FnvUpdate(hash, node.public_id);
+    FnvUpdate(hash, node.public_ip);
+    FnvUpdate(hash, node.public_port);
+    return hash;
+}
+
+void NodeSync::Refresh(const std::vector<std::shared_ptr<const Node>> &subnodes)
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    std::unordered_set<NodeId, NodeIdHash> current;
+    uint64_t digest = 0;
+    for (auto &node : subnodes)
+    {
+        current.insert(node->id);
+        digest ^= Digest(*node);
+        uint64_t hash = ContentHash(*node);
+        auto it = entries_.find(node->id);
+        if (entries_.end() != it && it->second == hash)
+        {
+            continue;
+        }
+        entries_[node->id] = hash;
+        changes_.push_back(std::make_pair(++seq_, node->id));
+    }
+    for (auto it = entries_.begin(); it != entries_.end();)
+    {
+        if (current.end() != current.find(it->first))
+        {
+            ++it;
+            continue;
+        }
+        changes_.push_back(std::make_pair(++seq_, it->first));
+        it = entries_.erase(it);
+    }
+    while (changes_.size() > kMaxNodeChanges)
+    {
+        truncated_seq_ = changes_.front().first;
+        changes_.pop_front();
+    }
+    digest_ = digest;
+}
+
+void NodeSync::BuildSyncNodeReq(const NodeId &peer, const std::vector<std::shared_ptr<const Node>> &subnodes, SyncNodeReq &out_req,
+                                std::string &out_nodes_bytes)
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    uint64_t acked_seq = 0;
+    auto it = acked_seqs_.find(peer);
+    if (acked_seqs_.end() != it)
+    {
+        acked_seq = it->second;
+    }
+    out_req.set_seq(seq_);
+    out_req.set_digest(digest_);
+    //对方没有同步过或落后太多
+    if (0 == acked_seq || acked_seq > seq_ || acked_seq < truncated_seq_)
+    {
+        out_req.set_is_full(true);
+        out_req.set_base_seq(0);
+        for (auto &node : subnodes)
+        {
+            AppendNodeInfo(SyncNodeReq::kNodesFieldNumber, *node, out_nodes_bytes);
+        }
+        return;
+    }
+    out_req.set_is_full(false);
+    out_req.set_base_seq(acked_seq);
+    std::unordered_set<NodeId, NodeIdHash> changed;
+    for (auto change = changes_.rbegin(); changes_.rend() != change && change->first > acked_seq; ++change)
+    {
+        changed.insert(change->second);
+    }
+    for (auto &node : subnodes)
+    {
+        if (changed.erase(node->id) > 0)
+        {
+            AppendNodeInfo(SyncNodeReq::kNodesFieldNumber, *node, out_nodes_bytes);
+        }
+    }
+    //已删除的节点不在节点表中,由id编码出地址
+    for (auto &id : changed)
+    {
+        out_req.add_removed(id.ToBase58());
+    }
+}
+
+bool NodeSync::OnSyncNodeAck(const NodeId &peer, uint64_t seq)
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    acked_seqs_[peer] = seq;
+    return 0 != seq && seq < seq_ && seq >= truncated_seq_;
+}
+
+uint64_t NodeSync::seq()
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    return seq_;
+}
+
+uint64_t NodeSync::replica_seq(const NodeId &public_id)
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    auto it = replicas_.find(public_id);
+    return replicas_.end() == it ? 0 : it->second.seq;
+}
+
+void NodeSync::SetReplica(const NodeId &public_id, uint64_t seq, uint64_t self_digest)
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    auto &replica = replicas_[public_id];
+    replica.seq = seq;
+    replica.self_digest = self_digest;
+}
+
+uint64_t NodeSync::replica_self_digest(const NodeId &public_id)
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    auto it = replicas_.find(public_id);
+    return replicas_.end() == it ? 0 : it->second.self_digest;
+}
+
+void NodeSync::RemovePeer(const NodeId &public_id)
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    acked_seqs_.erase(public_id);
+    replicas_.erase(public_id);
+}
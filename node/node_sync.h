@@ -0,0 +1,68 @@
+#ifndef UENC_NODE_NODE_SYNC_H_
+#define UENC_NODE_NODE_SYNC_H_
+
+#include "node/node_id.h"
+#include "proto/node.pb.h"
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//最多保留的变更记录数,对方落后更多时全量同步
+const size_t kMaxNodeChanges = 10000;
+
+struct Node;
+
+//公网节点之间增量同步各自的下属节点
+//发送方为下属节点集合维护版本号和变更记录,按对方确认的版本只发送之后的变更
+//接收方记录每个公网节点已同步到的版本,并用摘要校验同步结果
+class NodeSync
+{
+public:
+    NodeSync();
+    ~NodeSync() = default;
+    NodeSync(NodeSync &&) = delete;
+    NodeSync(const NodeSync &) = delete;
+    NodeSync &operator=(NodeSync &&) = delete;
+    NodeSync &operator=(const NodeSync &) = delete;
+
+    //参与摘要计算的字段,接收方同步后与发送方一致
+    static uint64_t Digest(const Node &node);
+
+    //根据当前的下属节点生成新版本和变更记录
+    void Refresh(const std::vector<std::shared_ptr<const Node>> &subnodes);
+    //填充发给peer的同步请求中的版本和变更,subnodes为当前的下属节点
+    //需要发送的节点以编码后的nodes字段追加到out_nodes_bytes,与out_req的编码拼接后发送
+    void BuildSyncNodeReq(const NodeId &peer, const std::vector<std::shared_ptr<const Node>> &subnodes, SyncNodeReq &out_req,
+                          std::string &out_nodes_bytes);
+    //peer确认已同步到seq,返回peer是否还可以增量同步到最新版本
+    bool OnSyncNodeAck(const NodeId &peer, uint64_t seq);
+    uint64_t seq();
+
+    //接收方:已从公网节点同步到的版本
+    uint64_t replica_seq(const NodeId &public_id);
+    //self_digest为同步的节点中自身的摘要,自身不在节点表中,校验时需加上
+    void SetReplica(const NodeId &public_id, uint64_t seq, uint64_t self_digest);
+    uint64_t replica_self_digest(const NodeId &public_id);
+    void RemovePeer(const NodeId &public_id);
+
+private:
+    struct Replica
+    {
+        uint64_t seq;
+        uint64_t self_digest;
+    };
+
+    std::mutex mutex_;
+    uint64_t seq_;
+    uint64_t digest_;
+    uint64_t truncated_seq_;                                   //已丢弃的变更记录的最大版本
+    std::unordered_map<NodeId, uint64_t, NodeIdHash> entries_; //节点 -> 节点内容的hash
+    std::deque<std::pair<uint64_t, NodeId>> changes_;
+    std::unordered_map<NodeId, uint64_t, NodeIdHash> acked_seqs_; //公网节点 -> 已确认的版本
+    std::unordered_map<NodeId, Replica, NodeIdHash> replicas_;    //公网节点 -> 已同步的版本
+};
+
+#endif
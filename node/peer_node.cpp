@@ -1,10 +1,134 @@
 #include "node/peer_node.h"
 #include "account/account_manager.h"
 #include "common/config.h"
+#include "common/logging.h"
 #include "db/db_api.h"
+#include "node/broadcast.h"
+#include "node/identity_cache.h"
 #include "node/msg_process.h"
 #include "node/node_api.h"
+#include "node/node_lookup.h"
+#include "node/state_announcer.h"
 #include "utils/net_utils.h"
+#include <algorithm>
+#include <unordered_set>
+
+static uint64_t UnixTime()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::shared_ptr<const Node> NodeTable::Find(const std::string &base58addr) const
+{
+    NodeId id;
+    if (!NodeId::FromBase58(base58addr, id))
+    {
+        return nullptr;
+    }
+    return Find(id);
+}
+
+void NodeTable::GetPublicNodes(std::vector<std::shared_ptr<const Node>> &out_nodes) const
+{
+    out_nodes.clear();
+    out_nodes.reserve(public_nodes.size());
+    for (auto &id : public_nodes)
+    {
+        auto node = Find(id);
+        if (nullptr != node)
+        {
+            out_nodes.push_back(node);
+        }
+    }
+}
+
+void NodeTable::GetSubnodes(const NodeId &public_id, std::vector<std::shared_ptr<const Node>> &out_nodes) const
+{
+    out_nodes.clear();
+    auto it = subnodes.find(public_id);
+    if (subnodes.end() == it)
+    {
+        return;
+    }
+    out_nodes.reserve(it->second.size());
+    for (auto &id : it->second)
+    {
+        auto node = Find(id);
+        if (nullptr != node)
+        {
+            out_nodes.push_back(node);
+        }
+    }
+}
+
+//节点表记录的公网信息是否变化
+static bool PublicChanged(const Node &item, const Node &node)
+{
+    return item.public_id != node.public_id || item.public_ip != node.public_ip || item.public_port != node.public_port;
+}
+
+static void EraseSubnode(std::unordered_map<NodeId, std::set<NodeId>, NodeIdHash> &subnodes, const Node &node)
+{
+    auto it = subnodes.find(node.public_id);
+    if (subnodes.end() != it)
+    {
+        it->second.erase(node.id);
+        if (it->second.empty())
+        {
+            subnodes.erase(it);
+        }
+    }
+}
+
+void NodeTable::Insert(const std::shared_ptr<const Node> &node)
+{
+    if (node->id.empty())
+    {
+        return;
+    }
+    auto &item = nodes[node->id];
+    //公网节点不变时下属节点的索引不用更新
+    bool public_changed = nullptr == item || item->public_id != node->public_id;
+    if (nullptr != item && public_changed)
+    {
+        EraseSubnode(subnodes, *item);
+    }
+    item = node;
+    if (node->is_public_node)
+    {
+        public_nodes.insert(node->id);
+    }
+    else
+    {
+        public_nodes.erase(node->id);
+    }
+    if (public_changed && !node->public_id.empty())
+    {
+        subnodes[node->public_id].insert(node->id);
+    }
+}
+
+bool NodeTable::Erase(const NodeId &id)
+{
+    auto it = nodes.find(id);
+    if (nodes.end() == it)
+    {
+        return false;
+    }
+    public_nodes.erase(id);
+    EraseSubnode(subnodes, *it->second);
+    nodes.erase(it);
+    return true;
+}
+
+PeerNode::PeerNode()
+{
+    continue_runing_ = false;
+    last_reselect_time_ = std::chrono::steady_clock::now();
+    last_save_time_ = last_reselect_time_;
+    public_id_change_time_ = last_reselect_time_;
+    nodes_.store(std::make_shared<NodeTable>());
+}
 
 void PeerNode::ThreadStart()
 {
@@ -16,29 +140,41 @@ void PeerNode::ThreadStart()
 void PeerNode::ThreadWork()
 {
     uint32_t k_refresh_time = Singleton<Config>::instance()->k_refresh_time();
-    std::vector<std::string> pub_node;
+    uint32_t save_time = Singleton<Config>::instance()->peer_cache_save_time();
+    ConnectCachedPublicNodes();
     while (continue_runing_)
     {
+        auto table = nodes();
+        if (table->public_nodes.empty())
         {
-            std::lock_guard<std::mutex> lck(nodes_mutex_);
-            for (auto &node : pub_node_)
-            {
-                pub_node.push_back(node);
-            }
+            Register2PublicNode();
         }
-        if (pub_node_.empty())
+        else if (!self_node_.is_public_node)
         {
-            Register2PublicNode();
+            ReselectPublicNode();
         }
         else if (self_node_.is_public_node)
         {
             ConnectPublicList();
-            for (auto &node : pub_node)
+            std::vector<std::shared_ptr<const Node>> subnodes;
+            GetSubnodes(self_node_.id, subnodes);
+            node_sync_.Refresh(subnodes);
+            for (auto &id : table->public_nodes)
             {
-                SendSyncNodeReq(node);
+                auto node = table->Find(id);
+                if (nullptr != node)
+                {
+                    SendSyncNodeReq(*node);
+                }
             }
         }
-        pub_node.clear();
+        table.reset();
+        RefreshRoutingTable();
+        if (0 != save_time && std::chrono::steady_clock::now() - last_save_time_ >= std::chrono::seconds(save_time))
+        {
+            last_save_time_ = std::chrono::steady_clock::now();
+            SavePeerCache();
+        }
         std::unique_lock<std::mutex> locker(sync_node_mutex_);
         sync_node_condition_.wait_for(locker, std::chrono::seconds(k_refresh_time));
     }
@@ -46,8 +182,16 @@ void PeerNode::ThreadWork()
 
 void PeerNode::ThreadStop()
 {
+    if (!continue_runing_)
+    {
+        return;
+    }
     continue_runing_ = false;
     sync_node_condition_.notify_all();
+    if (0 != Singleton<Config>::instance()->peer_cache_save_time())
+    {
+        SavePeerCache();
+    }
 }
 
 Node PeerNode::self_node()
@@ -66,6 +210,7 @@ int PeerNode::InitSelfNode()
     auto conf = Singleton<Config>::instance();
     auto acc_mgr = Singleton<AccountManager>::instance();
     self_node_.base58addr = acc_mgr->GetDefaultAccount();
+    NodeId::FromBase58(self_node_.base58addr, self_node_.id);
     Account::AccountAddr account;
     if (!acc_mgr->GetAccountByAddr(self_node_.base58addr, account))
     {
@@ -82,361 +227,944 @@ int PeerNode::InitSelfNode()
     {
         return -3;
     }
-    auto status = DBReader().GetNodeHeight(self_node_.height);
+    uint64_t height = 0;
+    auto status = DBReader().GetNodeHeight(height);
     if (DBStatus::DB_SUCCESS != status && DBStatus::DB_NOT_FOUND != status)
     {
         return -4;
     }
-    self_node_.sign_fee = conf->sign_fee();
-    self_node_.package_fee = conf->package_fee();
+    self_node_.runtime->height = height;
+    self_node_.runtime->sign_fee = conf->sign_fee();
+    self_node_.runtime->package_fee = conf->package_fee();
     self_node_.is_public_node = conf->is_public_node();
     self_node_.version = g_version;
+    RefreshSelfNodeInfo();
+    routing_table_.set_self(self_node_.base58addr);
 
     Singleton<SocketManager>::instance()->SetDisConnectCallBack(
         [this](const std::string &connection_id)
         {
-            std::lock_guard<std::mutex> lck(nodes_mutex_);
-            for (auto &item : all_node_map_)
+            auto node = FindNodeByConnection(connection_id);
             {
-                if ((nullptr != item.second.connection) &&
-                    (item.second.connection->connection_id() == connection_id))
+                std::lock_guard<std::mutex> lck(connections_mutex_);
+                connections_.erase(connection_id);
+            }
+            if (nullptr == node)
+            {
+                return;
+            }
+            //节点可能已换用新的连接
+            bool erased = ModifyNodes(
+                [&node, &connection_id](NodeTable &table)
                 {
-                    if (item.second.is_public_node)
+                    auto item = table.Find(node->id);
+                    if (nullptr == item)
                     {
-                        pub_node_.erase(item.first);
+                        return false;
                     }
-                    all_node_map_.erase(item.first);
-                    return;
-                }
+                    auto connection = item->runtime->connection.load();
+                    if (nullptr == connection || connection->connection_id() != connection_id)
+                    {
+                        return false;
+                    }
+                    return table.Erase(node->id);
+                });
+            if (erased)
+            {
+                RemovePeer(node->id);
             }
         });
     return 0;
 }
 
-void PeerNode::SetSelfNodePublicBase58Addr(const std::string &base58addr)
+void PeerNode::SetSelfNodePublicId(const NodeId &public_id)
 {
     std::lock_guard<std::mutex> lock(self_node_mutex_);
-    self_node_.public_base58addr = base58addr;
+    if (self_node_.public_id != public_id)
+    {
+        public_id_change_time_ = std::chrono::steady_clock::now();
+    }
+    self_node_.public_id = public_id;
+    RefreshSelfNodeInfo();
 }
 
 void PeerNode::SetSelfNodePublicIp(uint32_t public_ip)
 {
     std::lock_guard<std::mutex> lock(self_node_mutex_);
     self_node_.public_ip = public_ip;
+    RefreshSelfNodeInfo();
 }
 
 void PeerNode::SetSelfNodePublicPort(uint16_t public_port)
 {
     std::lock_guard<std::mutex> lock(self_node_mutex_);
     self_node_.public_port = public_port;
+    RefreshSelfNodeInfo();
+}
+
+void PeerNode::SetSelfNodeHeight(uint64_t height)
+{
+    std::lock_guard<std::mutex> lock(self_node_mutex_);
+    self_node_.runtime->height = height;
+    RefreshSelfNodeInfo();
 }
 
 void PeerNode::SetSelfNodeFee(uint64_t sign_fee)
 {
     std::lock_guard<std::mutex> lock(self_node_mutex_);
-    self_node_.sign_fee = sign_fee;
+    self_node_.runtime->sign_fee = sign_fee;
+    RefreshSelfNodeInfo();
 }
 void PeerNode::SetSelfNodePackageFee(uint64_t package_fee)
 {
     std::lock_guard<std::mutex> lock(self_node_mutex_);
-    self_node_.package_fee = package_fee;
+    self_node_.runtime->package_fee = package_fee;
+    RefreshSelfNodeInfo();
 }
 
-bool PeerNode::FindNodeByBase58Addr(const std::string &base58addr, Node &out_node)
+std::shared_ptr<const EncodedNodeInfo> PeerNode::self_connect_nodeinfo()
+{
+    std::lock_guard<std::mutex> lock(self_node_mutex_);
+    return self_connect_nodeinfo_;
+}
+
+void PeerNode::RefreshSelfNodeInfo()
+{
+    self_node_.runtime->nodeinfo = SerializeNodeInfo(self_node_);
+    //连接请求只用于建立连接,公网信息由注册流程确定
+    Node connect_node = self_node_;
+    connect_node.public_id = NodeId();
+    connect_node.public_ip = 0;
+    connect_node.public_port = 0;
+    connect_node.version = g_version;
+    self_connect_nodeinfo_ = SerializeNodeInfo(connect_node);
+}
+
+std::shared_ptr<const Node> PeerNode::FindNode(const NodeId &id) const
+{
+    return nodes()->Find(id);
+}
+
+std::shared_ptr<const Node> PeerNode::FindNode(const std::string &base58addr) const
 {
     if (base58addr.empty())
     {
-        return false;
+        return nullptr;
     }
-    std::lock_guard<std::mutex> lck(nodes_mutex_);
-    if (all_node_map_.end() == all_node_map_.find(base58addr))
+    return nodes()->Find(base58addr);
+}
+
+std::shared_ptr<const Node> PeerNode::FindNodeByConnection(const std::string &connection_id)
+{
+    NodeId id;
+    {
+        std::lock_guard<std::mutex> lck(connections_mutex_);
+        auto it = connections_.find(connection_id);
+        if (connections_.end() == it)
+        {
+            return nullptr;
+        }
+        id = it->second;
+    }
+    auto node = nodes()->Find(id);
+    if (nullptr == node)
+    {
+        return nullptr;
+    }
+    auto connection = node->runtime->connection.load();
+    if (nullptr == connection || connection->connection_id() != connection_id)
+    {
+        return nullptr;
+    }
+    return node;
+}
+
+void PeerNode::GetPublicNodes(std::vector<std::shared_ptr<const Node>> &out_nodes) const
+{
+    nodes()->GetPublicNodes(out_nodes);
+}
+
+void PeerNode::GetSubnodes(const NodeId &public_id, std::vector<std::shared_ptr<const Node>> &out_nodes) const
+{
+    nodes()->GetSubnodes(public_id, out_nodes);
+}
+
+bool PeerNode::FindNodeByBase58Addr(const std::string &base58addr, Node &out_node)
+{
+    auto node = FindNode(base58addr);
+    if (nullptr == node)
     {
         return false;
     }
-    out_node = all_node_map_[base58addr];
+    out_node = *node;
     return true;
 }
 
 bool PeerNode::GetAllNodes(std::vector<Node> &out_nodes)
 {
+    auto table = nodes();
     out_nodes.clear();
-    out_nodes.reserve(all_node_map_.size());
-    std::lock_guard<std::mutex> lck(nodes_mutex_);
-    for (auto itr = all_node_map_.cbegin(); itr != all_node_map_.cend(); ++itr)
+    out_nodes.reserve(table->nodes.size());
+    for (auto &item : table->nodes)
     {
-        out_nodes.push_back(itr->second);
+        out_nodes.push_back(*item.second);
     }
     return !out_nodes.empty();
 }
 
 bool PeerNode::GetAllPublicNodes(std::vector<Node> &out_nodes)
 {
+    std::vector<std::shared_ptr<const Node>> nodes;
+    GetPublicNodes(nodes);
     out_nodes.clear();
-    out_nodes.reserve(pub_node_.size());
-    std::lock_guard<std::mutex> lck(nodes_mutex_);
-    for (auto &addr : pub_node_)
+    out_nodes.reserve(nodes.size());
+    for (auto &node : nodes)
     {
-        auto it = all_node_map_.find(addr);
-        if (all_node_map_.end() != it)
-        {
-            out_nodes.push_back(it->second);
-        }
+        out_nodes.push_back(*node);
     }
     return !out_nodes.empty();
 }
 
 bool PeerNode::GetNodesByPublicBase58Addr(const std::string &base58addr, std::vector<Node> &out_nodes)
 {
-    if (base58addr.empty())
+    std::vector<std::shared_ptr<const Node>> nodes;
+    NodeId public_id;
+    if (NodeId::FromBase58(base58addr, public_id))
     {
-        return false;
+        GetSubnodes(public_id, nodes);
     }
     out_nodes.clear();
-    std::lock_guard<std::mutex> lck(nodes_mutex_);
-    for (auto &item : all_node_map_)
+    out_nodes.reserve(nodes.size());
+    for (auto &node : nodes)
     {
-        if (item.second.public_base58addr == base58addr)
-        {
-            out_nodes.push_back(item.second);
-        }
+        out_nodes.push_back(*node);
     }
     return !out_nodes.empty();
 }
 
 bool PeerNode::AddNode(const Node &node)
 {
-    if (node.base58addr.empty())
+    auto new_node = std::make_shared<Node>(node);
+    //收到消息时已解析出id
+    if (new_node->id.empty() && !NodeId::FromBase58(new_node->base58addr, new_node->id))
     {
         return false;
     }
+    //已存在时不复制节点表
+    if (nullptr != nodes()->Find(new_node->id))
     {
-        std::lock_guard<std::mutex> lck(nodes_mutex_);
-        if (all_node_map_.end() != all_node_map_.find(node.base58addr))
-        {
-            return false;
-        }
-        else
+        return false;
+    }
+    new_node->runtime->nodeinfo = nullptr;
+    bool ret = ModifyNodes(
+        [&new_node](NodeTable &table)
         {
-            all_node_map_[node.base58addr] = node;
-            if (node.is_public_node)
+            if (nullptr != table.Find(new_node->id))
             {
-                pub_node_.insert(node.base58addr);
+                return false;
             }
+            table.Insert(new_node);
+            return true;
+        });
+    if (ret)
+    {
+        IndexConnection(new_node->id, nullptr, new_node->runtime->connection.load());
+        UpdateRoutingTable(new_node->id, new_node->base58addr);
+    }
+    return ret;
+}
+
+void PeerNode::AddNodes(const std::vector<Node> &nodes, bool update_existing)
+{
+    std::vector<std::shared_ptr<Node>> new_nodes;
+    std::vector<const Node *> existing;
+    auto table = this->nodes();
+    for (auto &node : nodes)
+    {
+        NodeId id = node.id;
+        if (id.empty() && !NodeId::FromBase58(node.base58addr, id))
+        {
+            continue;
         }
+        if (nullptr != table->Find(id))
+        {
+            existing.push_back(&node);
+            continue;
+        }
+        auto new_node = std::make_shared<Node>(node);
+        new_node->id = id;
+        new_node->runtime->nodeinfo = nullptr;
+        new_nodes.push_back(new_node);
     }
-    /*if (node.is_public_node)
+    table.reset();
+    std::vector<std::shared_ptr<Node>> added;
+    if (!new_nodes.empty())
     {
-        PublicNode public_node;
-        if (Int2StrIPv4(node.public_ip, public_node.ip))
+        ModifyNodes(
+            [&new_nodes, &added](NodeTable &table)
+            {
+                added.clear();
+                size_t subnode_num = table.nodes.size() - table.public_nodes.size();
+                for (auto &node : new_nodes)
+                {
+                    if (nullptr != table.Find(node->id))
+                    {
+                        continue;
+                    }
+                    if (!node->is_public_node && !node->is_connected() && subnode_num >= kMaxListedSubnodes)
+                    {
+                        continue;
+                    }
+                    table.Insert(node);
+                    added.push_back(node);
+                    if (!node->is_public_node)
+                    {
+                        ++subnode_num;
+                    }
+                }
+                return !added.empty();
+            });
+    }
+    for (auto &node : added)
+    {
+        IndexConnection(node->id, nullptr, node->runtime->connection.load());
+        UpdateRoutingTable(node->id, node->base58addr);
+    }
+    if (update_existing)
+    {
+        for (auto node : existing)
         {
-            public_node.port = node.public_port;
-            Singleton<Config>::instance()->add_public_node(public_node);
+            UpdateNode(*node);
         }
-    }*/
-    return true;
+    }
 }
 
 void PeerNode::DeleteNodeByBase58Addr(const std::string &base58addr)
 {
-    if (base58addr.empty())
+    auto node = FindNode(base58addr);
+    if (nullptr == node)
     {
         return;
     }
+    ModifyNodes([&node](NodeTable &table)
+                { return table.Erase(node->id); });
     std::string connection_id;
+    auto connection = node->runtime->connection.load();
+    if (nullptr != connection && connection->IsConnected())
     {
-        std::lock_guard<std::mutex> lck(nodes_mutex_);
-        auto it = all_node_map_.find(base58addr);
-        if (it != all_node_map_.end())
-        {
-            if(it->second.is_public_node)
-            {
-                pub_node_.erase(it->first);
-            }
-            all_node_map_.erase(it->first);
-            if(it->second.is_connected())
-            {
-                connection_id = it->second.connection->connection_id();
-            }
-        }
+        connection_id = connection->connection_id();
     }
+    RemovePeer(node->id);
     Singleton<SocketManager>::instance()->DisConnect(connection_id);
 }
 
 bool PeerNode::UpdateNode(const Node &node)
 {
-    if (node.base58addr.empty())
+    auto found = node.id.empty() ? FindNode(node.base58addr) : FindNode(node.id);
+    if (nullptr == found)
     {
         return false;
     }
-    std::lock_guard<std::mutex> lck(nodes_mutex_);
-    auto it = all_node_map_.find(node.base58addr);
-    if (all_node_map_.end() == it)
+    found->runtime->height = node.runtime->height;
+    found->runtime->sign_fee = node.runtime->sign_fee;
+    found->runtime->package_fee = node.runtime->package_fee;
+    if (!PublicChanged(*found, node))
     {
-        return false;
+        return true;
     }
-    it->second.public_base58addr = node.public_base58addr;
-    it->second.public_ip = node.public_ip;
-    it->second.public_port = node.public_port;
-    it->second.height = node.height;
-    it->second.sign_fee = node.sign_fee;
-    it->second.package_fee = node.package_fee;
-    return true;
+    return ModifyNodes(
+        [&found, &node](NodeTable &table)
+        {
+            return ModifyNode(table, found->id,
+                              [&node](Node &item)
+                              {
+                                  item.public_id = node.public_id;
+                                  item.public_ip = node.public_ip;
+                                  item.public_port = node.public_port;
+                              });
+        });
 }
-bool PeerNode::UpdateNodeConnect(const std::string &base58addr, std::shared_ptr<SocketConnection> connection)
+
+bool PeerNode::UpdateNodeConnect(const NodeId &id, std::shared_ptr<SocketConnection> connection)
 {
-    if (base58addr.empty())
+    auto node = FindNode(id);
+    if (nullptr == node)
     {
         return false;
     }
-    Node node;
+    auto old_connection = node->runtime->connection.exchange(connection);
+    IndexConnection(node->id, old_connection, connection);
+    if (nullptr != old_connection && old_connection != connection && old_connection->IsConnected())
     {
-        std::lock_guard<std::mutex> lck(nodes_mutex_);
-        auto it = all_node_map_.find(base58addr);
-        if (all_node_map_.end() == it)
-        {
-            return false;
-        }
-        node = it->second;
-    }
-    if(node.is_connected())
-    {
-        Singleton<SocketManager>::instance()->DisConnect(node.connection->connection_id());
-    }
-    {
-        std::lock_guard<std::mutex> lck(nodes_mutex_);
-        all_node_map_[node.base58addr] = node;
+        Singleton<SocketManager>::instance()->DisConnect(old_connection->connection_id());
     }
     return true;
 }
 
-bool PeerNode::UpdateNodeHeight(const std::string &base58addr, uint64_t height)
+bool PeerNode::UpdateNodeHeight(const NodeId &id, uint64_t height)
 {
-    if (base58addr.empty())
+    auto node = FindNode(id);
+    if (nullptr == node)
     {
         return false;
     }
-    std::lock_guard<std::mutex> lck(nodes_mutex_);
-    auto it = all_node_map_.find(base58addr);
-    if (all_node_map_.end() == it)
-    {
-        return false;
-    }
-    it->second.height = height;
+    node->runtime->height = height;
     return true;
 }
 
-bool PeerNode::UpdateNodeSignFee(const std::string &base58addr, uint64_t sign_fee)
+bool PeerNode::UpdateNodeSignFee(const NodeId &id, uint64_t sign_fee)
 {
-    if (base58addr.empty())
+    auto node = FindNode(id);
+    if (nullptr == node)
     {
         return false;
     }
-    std::lock_guard<std::mutex> lck(nodes_mutex_);
-    auto it = all_node_map_.find(base58addr);
-    if (all_node_map_.end() == it)
-    {
-        return false;
-    }
-    it->second.sign_fee = sign_fee;
+    node->runtime->sign_fee = sign_fee;
     return true;
 }
 
-bool PeerNode::UpdateNodePackageFee(const std::string &base58addr, uint64_t package_fee)
+bool PeerNode::UpdateNodePackageFee(const NodeId &id, uint64_t package_fee)
 {
-    if (base58addr.empty())
+    auto node = FindNode(id);
+    if (nullptr == node)
     {
         return false;
     }
-    std::lock_guard<std::mutex> lck(nodes_mutex_);
-    auto it = all_node_map_.find(base58addr);
-    if (all_node_map_.end() == it)
+    node->runtime->package_fee = package_fee;
+    return true;
+}
+
+bool PeerNode::UpdateNodesRtt(const std::unordered_map<NodeId, std::pair<uint32_t, uint32_t>, NodeIdHash> &rtts)
+{
+    auto table = nodes();
+    bool modified = false;
+    for (auto &item : rtts)
     {
-        return false;
+        auto node = table->Find(item.first);
+        if (nullptr == node)
+        {
+            continue;
+        }
+        node->runtime->rtt = item.second.first;
+        node->runtime->rtt_var = item.second.second;
+        modified = true;
     }
-    it->second.package_fee = package_fee;
-    return true;
+    return modified;
 }
 
-void PeerNode::UpdateNodesByPublicBase58Addr(const std::string &public_base58addr, const std::vector<Node> &nodes)
+void PeerNode::UpdateNodesByPublicId(const NodeId &public_id, const std::vector<Node> &nodes)
 {
-    std::lock_guard<std::mutex> lck(nodes_mutex_);
-    std::vector<std::string> addrs1;
-    std::vector<std::string> addrs2;
-    for (auto &node : nodes)
+    UpdateSubnodes(public_id, nodes, std::vector<NodeId>(), true);
+}
+
+void PeerNode::UpdateNodesByPublicId(const NodeId &public_id, const std::vector<Node> &nodes, const std::vector<NodeId> &removed)
+{
+    UpdateSubnodes(public_id, nodes, removed, false);
+}
+
+void PeerNode::ConnectPublicList()
+{
+    if(!self_node_.is_public_node)
+    {
+        return;
+    }
+    std::vector<std::shared_ptr<const Node>> nodes;
+    GetPublicNodes(nodes);
+    for (auto &item : nodes)
     {
-        if (node.base58addr.empty())
+        if(item->is_connected())
         {
             continue;
         }
-        addrs1.push_back(node.base58addr);
-        auto it = all_node_map_.find(node.base58addr);
-        if (all_node_map_.end() != it)
+        auto socket_manager = Singleton<SocketManager>::instance();
+        std::shared_ptr<SocketConnection> connection;
+        auto ret = socket_manager->Connect(item->local_ip, item->listen_port, connection);
+        if (0 != ret)
         {
-            it->second.public_base58addr = node.public_base58addr;
-            it->second.public_ip = node.public_ip;
-            it->second.public_port = node.public_port;
-            it->second.height = node.height;
-            it->second.sign_fee = node.sign_fee;
-            it->second.package_fee = node.package_fee;
+            continue;
         }
-        else
+        UpdateNodeConnect(item->id, connection);
+        SendConnectNodeReq(connection);
+    }
+}
+
+void PeerNode::ReselectPublicNode()
+{
+    uint32_t reselect_time = Singleton<Config>::instance()->public_node_reselect_time();
+    auto now = std::chrono::steady_clock::now();
+    if (0 == reselect_time || now - last_reselect_time_ < std::chrono::seconds(reselect_time))
+    {
+        return;
+    }
+    last_reselect_time_ = now;
+    {
+        std::lock_guard<std::mutex> lock(self_node_mutex_);
+        if (now - public_id_change_time_ < std::chrono::seconds(kMinPublicNodeResidenceTime))
         {
-            all_node_map_[node.base58addr] = node;
+            return;
         }
     }
-    for (auto &item : all_node_map_)
+    Node self = self_node();
+    auto table = nodes();
+    auto current = table->Find(self.public_id);
+    if (nullptr == current || !current->is_connected())
     {
-        if (item.second.public_base58addr == public_base58addr)
+        return;
+    }
+    std::vector<std::shared_ptr<const Node>> candidates{current};
+    for (auto &id : table->public_nodes)
+    {
+        auto node = table->Find(id);
+        if (nullptr != node && node != current && 0 != node->local_ip && 0 != node->listen_port)
         {
-            addrs2.push_back(item.second.base58addr);
+            candidates.push_back(node);
         }
     }
-    std::sort(addrs1.begin(), addrs1.end());
-    std::sort(addrs2.begin(), addrs2.end());
-    std::vector<std::string> v_diff;
-    std::set_difference(addrs1.begin(), addrs1.end(), addrs2.begin(), addrs2.end(), std::back_inserter(v_diff));
-    for (auto &base58addr : v_diff)
+    if (candidates.size() < 2)
+    {
+        return;
+    }
+    std::vector<std::pair<in_addr_t, in_port_t>> addrs;
+    for (auto &node : candidates)
+    {
+        addrs.push_back(std::make_pair(node->local_ip, node->listen_port));
+    }
+    std::vector<uint32_t> times;
+    ProbeConnectTime(addrs, Singleton<Config>::instance()->public_node_probe_timeout(), times);
+    //所有节点都以同一次探测的建立连接时间比较,心跳往返时间包含对方的处理延迟,与连接时间不可比
+    uint64_t current_latency = times[0];
+    if (UINT32_MAX == current_latency)
+    {
+        return;
+    }
+    size_t best = std::min_element(times.begin() + 1, times.end()) - times.begin();
+    uint64_t best_latency = times[best];
+    uint64_t ratio = 100 + Singleton<Config>::instance()->public_node_switch_ratio();
+    if (UINT32_MAX == best_latency || best_latency * ratio / 100 >= current_latency ||
+        current_latency - best_latency < kMinPublicNodeSwitchGain)
+    {
+        return;
+    }
+    std::string ip;
+    Int2StrIPv4(candidates[best]->local_ip, ip);
+    INFOLOG("switch public node from {}({}us) to {}({}us)", current->base58addr, current_latency, candidates[best]->base58addr, best_latency);
+    SendRegisterNodeReq(ip, candidates[best]->listen_port);
+}
+
+void PeerNode::LoadPeerCache()
+{
+    std::string value;
+    if (DBStatus::DB_SUCCESS != DBReader().GetPeerNodeCache(value))
     {
-        auto it = all_node_map_.find(base58addr);
-        if (all_node_map_.end() != it)
+        return;
+    }
+    PeerCache cache;
+    if (!cache.ParseFromString(value))
+    {
+        ERRORLOG("parse peer cache fail");
+        return;
+    }
+    uint64_t now = UnixTime();
+    uint64_t expire_time = Singleton<Config>::instance()->peer_cache_expire_time();
+    std::string self_base58addr = self_node().base58addr;
+    std::lock_guard<std::mutex> lck(cache_mutex_);
+    Node node;
+    for (auto &item : cache.nodes())
+    {
+        //旧版本保存的下属节点不再使用
+        if (item.node().base58addr() == self_base58addr || !item.node().is_public_node() || item.last_seen() + expire_time < now)
         {
-            all_node_map_.erase(it);
+            continue;
         }
+        NodeInfo2Node(item.node(), node);
+        if (node.id.empty())
+        {
+            continue;
+        }
+        auto &cached = cached_nodes_[node.id];
+        cached.node = node;
+        cached.node.runtime->rtt = item.rtt();
+        cached.last_seen = item.last_seen();
     }
+    INFOLOG("load {} cached nodes", cached_nodes_.size());
 }
 
-void PeerNode::ConnectPublicList()
+void PeerNode::SavePeerCache()
 {
-    if(!self_node_.is_public_node)
+    uint64_t now = UnixTime();
+    uint64_t expire_time = Singleton<Config>::instance()->peer_cache_expire_time();
+    auto table = nodes();
+    PeerCache cache;
+    {
+        std::lock_guard<std::mutex> lck(cache_mutex_);
+        //只保存公网节点,下属节点数量多且重启后无法直接连接,不能挤占公网节点的位置
+        for (auto &id : table->public_nodes)
+        {
+            auto node = table->Find(id);
+            if (nullptr == node)
+            {
+                continue;
+            }
+            auto &cached = cached_nodes_[id];
+            cached.node = *node;
+            cached.node.runtime->connection = nullptr;
+            cached.last_seen = now;
+        }
+        std::vector<std::pair<uint64_t, NodeId>> entries;
+        for (auto it = cached_nodes_.begin(); it != cached_nodes_.end();)
+        {
+            if (it->second.last_seen + expire_time < now)
+            {
+                it = cached_nodes_.erase(it);
+                continue;
+            }
+            entries.push_back(std::make_pair(it->second.last_seen, it->first));
+            ++it;
+        }
+        //超过数量时丢弃最久未出现的节点
+        if (entries.size() > kMaxPeerCacheNodes)
+        {
+            size_t count = entries.size() - kMaxPeerCacheNodes;
+            std::partial_sort(entries.begin(), entries.begin() + count, entries.end());
+            for (size_t i = 0; i < count; ++i)
+            {
+                cached_nodes_.erase(entries[i].second);
+            }
+        }
+        for (auto &item : cached_nodes_)
+        {
+            auto cache_node = cache.add_nodes();
+            Node2NodeInfo(item.second.node, cache_node->mutable_node());
+            cache_node->set_last_seen(item.second.last_seen);
+            cache_node->set_rtt(item.second.node.runtime->rtt);
+        }
+    }
+    if (cache.nodes().empty())
     {
         return;
     }
-    std::vector<Node> nodes;
+    DBReadWriter db_writer("SavePeerCache");
+    if (DBStatus::DB_SUCCESS != db_writer.SetPeerNodeCache(cache.SerializeAsString()) ||
+        DBStatus::DB_SUCCESS != db_writer.TransactionCommit())
     {
-        std::lock_guard<std::mutex> lck(nodes_mutex_);
-        for (auto &addr : pub_node_)
+        ERRORLOG("save peer cache fail");
+    }
+}
+
+void PeerNode::GetCachedPublicNodes(std::vector<Node> &out_nodes)
+{
+    out_nodes.clear();
+    std::vector<std::pair<uint64_t, Node>> nodes;
+    {
+        std::lock_guard<std::mutex> lck(cache_mutex_);
+        for (auto &item : cached_nodes_)
         {
-            auto it = all_node_map_.find(addr);
-            if (all_node_map_.end() != it)
+            if (item.second.node.is_public_node && 0 != item.second.node.local_ip && 0 != item.second.node.listen_port)
             {
-                nodes.push_back(it->second);
+                nodes.push_back(std::make_pair(item.second.last_seen, item.second.node));
             }
         }
     }
+    std::stable_sort(nodes.begin(), nodes.end(), [](const std::pair<uint64_t, Node> &a, const std::pair<uint64_t, Node> &b)
+                     { return a.first > b.first; });
+    out_nodes.reserve(nodes.size());
     for (auto &item : nodes)
     {
-        if(item.is_connected())
+        out_nodes.push_back(item.second);
+    }
+}
+
+void PeerNode::ConnectCachedPublicNodes()
+{
+    if (!self_node().is_public_node)
+    {
+        return;
+    }
+    std::vector<Node> cached_nodes;
+    GetCachedPublicNodes(cached_nodes);
+    auto table = nodes();
+    std::vector<std::pair<in_addr_t, in_port_t>> addrs;
+    for (auto it = cached_nodes.begin(); it != cached_nodes.end();)
+    {
+        auto node = table->Find(it->id);
+        if (nullptr != node && node->is_connected())
         {
+            it = cached_nodes.erase(it);
+            continue;
+        }
+        addrs.push_back(std::make_pair(it->local_ip, it->listen_port));
+        ++it;
+    }
+    table.reset();
+    if (addrs.empty())
+    {
+        return;
+    }
+    std::vector<uint32_t> times;
+    ProbeConnectTime(addrs, Singleton<Config>::instance()->public_node_probe_timeout(), times);
+    auto socket_manager = Singleton<SocketManager>::instance();
+    uint32_t connected = 0;
+    for (size_t i = 0; i < cached_nodes.size(); ++i)
+    {
+        Node &node = cached_nodes[i];
+        if (UINT32_MAX == times[i])
+        {
+            continue;
+        }
+        //只校验要连接的节点,校验失败的节点不再保留
+        if (0 != Singleton<IdentityCache>::instance()->Verify(node.pub, node.sign, node.base58addr))
+        {
+            std::lock_guard<std::mutex> lck(cache_mutex_);
+            cached_nodes_.erase(node.id);
             continue;
         }
-        auto socket_manager = Singleton<SocketManager>::instance();
         std::shared_ptr<SocketConnection> connection;
-        auto ret = socket_manager->Connect(item.local_ip, item.listen_port, connection);
-        if (0 != ret)
+        if (0 != socket_manager->Connect(node.local_ip, node.listen_port, connection))
         {
             continue;
         }
-        UpdateNodeConnect(item.base58addr, connection);
+        node.runtime->connection = connection;
+        if (!AddNode(node))
+        {
+            UpdateNodeConnect(node.id, connection);
+        }
         SendConnectNodeReq(connection);
+        ++connected;
+    }
+    INFOLOG("connect {} of {} cached public nodes", connected, cached_nodes.size());
+}
+
+void PeerNode::UpdateRoutingTable(const NodeId &id, const std::string &base58addr, const std::string &nodeinfo)
+{
+    NodeId probe;
+    routing_table_.Update(id, base58addr, nodeinfo, probe);
+    if (probe.empty())
+    {
+        return;
+    }
+    //桶已满,最久未联系的节点无响应时才替换
+    PingReq req;
+    req.set_base58addr(self_node().base58addr);
+    auto ret = CallMessageToNode<PongReq>(probe.ToBase58(), req, Priority::kPriority_High_2, kLookupTimeout,
+                                          [this, probe](int ret, const std::shared_ptr<PongReq> &rsp)
+                                          { routing_table_.OnProbe(probe, kRpc_Success == ret); });
+    if (ret < 0)
+    {
+        routing_table_.OnProbe(probe, false);
+    }
+}
+
+void PeerNode::RefreshRoutingTable()
+{
+    std::vector<uint32_t> indexes;
+    routing_table_.GetStaleBuckets(std::chrono::seconds(Singleton<Config>::instance()->bucket_refresh_time()), indexes);
+    for (auto index : indexes)
+    {
+        NodeLookup::Start(routing_table_.RefreshBucket(index), nullptr);
+    }
+}
+
+bool PeerNode::ModifyNodes(std::function<bool(NodeTable &)> modify)
+{
+    PendingModify pending{modify, false};
+    {
+        std::lock_guard<std::mutex> lck(pending_mutex_);
+        pending_modifies_.push_back(&pending);
+    }
+    std::lock_guard<std::mutex> lck(nodes_mutex_);
+    std::vector<PendingModify *> modifies;
+    {
+        std::lock_guard<std::mutex> pending_lck(pending_mutex_);
+        modifies.swap(pending_modifies_);
+    }
+    //为空说明已被之前持有锁的线程合并执行并发布
+    if (modifies.empty())
+    {
+        return pending.ret;
+    }
+    auto table = std::make_shared<NodeTable>(*nodes_.load());
+    bool changed = false;
+    for (auto item : modifies)
+    {
+        item->ret = item->modify(*table);
+        changed = changed || item->ret;
     }
+    if (changed)
+    {
+        ++table->version;
+        nodes_.store(table);
+    }
+    return pending.ret;
+}
+
+bool PeerNode::ModifyNode(NodeTable &table, const NodeId &id, std::function<void(Node &)> modify)
+{
+    auto it = table.nodes.find(id);
+    if (table.nodes.end() == it)
+    {
+        return false;
+    }
+    //已发布的节点可能正在被读取,修改副本,副本共享原节点的runtime,原地修改的字段不会丢失
+    auto node = std::make_shared<Node>(*it->second);
+    node->runtime = it->second->runtime;
+    ++node->revision;
+    modify(*node);
+    node->runtime->nodeinfo = nullptr;
+    table.Insert(node);
+    return true;
+}
+
+void PeerNode::IndexConnection(const NodeId &id, const std::shared_ptr<SocketConnection> &old_connection, const std::shared_ptr<SocketConnection> &connection)
+{
+    std::lock_guard<std::mutex> lck(connections_mutex_);
+    if (nullptr != old_connection && old_connection != connection)
+    {
+        auto it = connections_.find(old_connection->connection_id());
+        if (connections_.end() != it && it->second == id)
+        {
+            connections_.erase(it);
+        }
+    }
+    if (nullptr != connection)
+    {
+        connections_[connection->connection_id()] = id;
+    }
+}
+
+void PeerNode::UpdateSubnodes(const NodeId &public_id, const std::vector<Node> &nodes, const std::vector<NodeId> &removed, bool is_full)
+{
+    if (public_id.empty())
+    {
+        return;
+    }
+    //高度和手续费原地修改,只有增删节点或公网信息变化时才修改节点表
+    bool need_modify = false;
+    {
+        auto table = this->nodes();
+        std::unordered_set<NodeId, NodeIdHash> current;
+        for (auto &node : nodes)
+        {
+            if (node.id.empty())
+            {
+                continue;
+            }
+            current.insert(node.id);
+            auto item = table->Find(node.id);
+            if (nullptr == item)
+            {
+                need_modify = true;
+                continue;
+            }
+            item->runtime->height = node.runtime->height;
+            item->runtime->sign_fee = node.runtime->sign_fee;
+            item->runtime->package_fee = node.runtime->package_fee;
+            need_modify = need_modify || PublicChanged(*item, node);
+        }
+        if (is_full)
+        {
+            auto it = table->subnodes.find(public_id);
+            if (table->subnodes.end() != it)
+            {
+                for (auto &id : it->second)
+                {
+                    need_modify = need_modify || current.end() == current.find(id);
+                }
+            }
+        }
+        else
+        {
+            for (auto &id : removed)
+            {
+                auto item = table->Find(id);
+                need_modify = need_modify || (nullptr != item && item->public_id == public_id);
+            }
+        }
+    }
+    if (!need_modify)
+    {
+        return;
+    }
+    std::vector<std::shared_ptr<const Node>> added;
+    std::vector<NodeId> erased;
+    ModifyNodes(
+        [&public_id, &nodes, &removed, is_full, &added, &erased](NodeTable &table)
+        {
+            added.clear();
+            erased.clear();
+            std::unordered_set<NodeId, NodeIdHash> current;
+            for (auto &node : nodes)
+            {
+                if (node.id.empty())
+                {
+                    continue;
+                }
+                current.insert(node.id);
+                auto found = table.Find(node.id);
+                if (nullptr == found)
+                {
+                    auto new_node = std::make_shared<Node>(node);
+                    new_node->runtime->nodeinfo = nullptr;
+                    table.Insert(new_node);
+                    added.push_back(new_node);
+                    continue;
+                }
+                if (PublicChanged(*found, node))
+                {
+                    ModifyNode(table, node.id,
+                               [&node](Node &item)
+                               {
+                                   item.public_id = node.public_id;
+                                   item.public_ip = node.public_ip;
+                                   item.public_port = node.public_port;
+                               });
+                }
+            }
+            if (is_full)
+            {
+                //删除不在列表中的下属节点
+                auto it = table.subnodes.find(public_id);
+                if (table.subnodes.end() != it)
+                {
+                    for (auto &id : it->second)
+                    {
+                        if (current.end() == current.find(id))
+                        {
+                            erased.push_back(id);
+                        }
+                    }
+                }
+            }
+            else
+            {
+                for (auto &id : removed)
+                {
+                    auto node = table.Find(id);
+                    if (nullptr != node && node->public_id == public_id)
+                    {
+                        erased.push_back(id);
+                    }
+                }
+            }
+            for (auto &id : erased)
+            {
+                table.Erase(id);
+            }
+            return true;
+        });
+    for (auto &node : added)
+    {
+        UpdateRoutingTable(node->id, node->base58addr);
+    }
+    for (auto &id : erased)
+    {
+        RemovePeer(id);
+    }
+}
+
+void PeerNode::RemovePeer(const NodeId &id)
+{
+    routing_table_.Remove(id);
+    node_sync_.RemovePeer(id);
+    Singleton<BroadcastTree>::instance()->RemovePeer(id);
+    Singleton<StateAnnouncer>::instance()->RemovePeer(id);
 }
@@ -1,66 +1,128 @@
 #ifndef UENC_NODE_PEER_NODE_H_
 #define UENC_NODE_PEER_NODE_H_
 
+#include "node/node_id.h"
+#include "node/node_sync.h"
+#include "node/routing_table.h"
 #include "socket/socket_api.h"
+#include "utils/atomic_value.hpp"
+#include "utils/interned_string.h"
+#include <atomic>
+#include <chrono>
 #include <event.h>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
-// 距离上次传送数据多少时间未收到新报文判断为开始检测，
-#define HEART_TIME 60
-// 检测开始每多少时间发送心跳包，
-#define HEART_INTVL 100
+// 距离上次收到数据多少秒后开始检测，
+#define HEART_TIME 10
+// 检测开始后每多少秒发送心跳包，
+#define HEART_INTVL 2
 // 发送几次心跳包对方未响应则close连接，
-#define HEART_PROBES 6
+#define HEART_PROBES 3
+
+//切换公网节点至少需要减少的延迟(微秒),避免在相近的节点之间来回切换
+const uint32_t kMinPublicNodeSwitchGain = 10 * 1000;
+//切换公网节点后至少停留的时间(秒),避免在延迟相近或波动的节点之间频繁切换
+const uint32_t kMinPublicNodeResidenceTime = 10 * 60;
+//数据库中最多保存的公网节点数
+const size_t kMaxPeerCacheNodes = 10000;
+//从节点列表中加入的下属节点数上限,其余节点通过路由表查找,直连和同步的节点不受限制
+const size_t kMaxListedSubnodes = 200;
+
+//NodeInfo的编码,revision、height和手续费为编码时的值,与节点当前的值不同时需重新编码
+struct EncodedNodeInfo
+{
+    uint64_t revision;
+    uint64_t height;
+    uint64_t sign_fee;
+    uint64_t package_fee;
+    std::string bytes;
+};
+
+//节点中变化频繁的字段,在节点表中原地修改,不发布新版本
+//节点表复制节点时新旧节点共享同一个对象,复制期间的修改不会丢失
+struct NodeRuntime
+{
+    AtomicValue<uint64_t> height;
+    AtomicValue<uint64_t> sign_fee;
+    AtomicValue<uint64_t> package_fee;
+    AtomicValue<uint32_t> rtt;     //平滑后的往返时间(微秒),0表示未测量
+    AtomicValue<uint32_t> rtt_var; //往返时间的抖动(微秒)
+    AtomicValue<std::shared_ptr<SocketConnection>> connection;
+    //NodeInfo编码的缓存,发送时按需生成
+    AtomicValue<std::shared_ptr<const EncodedNodeInfo>> nodeinfo;
+};
 
 struct Node
 {
+    NodeId id; //节点表中的key,与base58addr对应
     std::string pub;
     std::string sign;
     std::string base58addr;
-    std::string public_base58addr;
-    std::string version;
+    NodeId public_id; //所属公网节点的id,收到消息时解析,发送时再编码为base58地址
+    InternedString version;
     uint32_t local_ip;
     uint16_t listen_port;
     uint32_t public_ip;
     uint16_t public_port;
-    uint64_t height;
-    uint64_t sign_fee;
-    uint64_t package_fee;
-    uint32_t heart_time;
-    uint32_t heart_probes;
     bool is_public_node;
-    std::shared_ptr<SocketConnection> connection;
-    Node()
+    uint64_t revision; //节点表中每次替换节点时加1,缓存的NodeInfo编码与之不同时需重新编码
+    std::shared_ptr<NodeRuntime> runtime;
+    Node() : runtime(std::make_shared<NodeRuntime>())
     {
         Clear();
     }
+    //复制节点时复制runtime中的当前值,节点表中替换节点时再共享原节点的runtime
+    Node(const Node &node) : runtime(std::make_shared<NodeRuntime>())
+    {
+        *this = node;
+    }
+    Node &operator=(const Node &node)
+    {
+        if (this == &node)
+        {
+            return *this;
+        }
+        id = node.id;
+        pub = node.pub;
+        sign = node.sign;
+        base58addr = node.base58addr;
+        public_id = node.public_id;
+        version = node.version;
+        local_ip = node.local_ip;
+        listen_port = node.listen_port;
+        public_ip = node.public_ip;
+        public_port = node.public_port;
+        is_public_node = node.is_public_node;
+        revision = node.revision;
+        *runtime = *node.runtime;
+        return *this;
+    }
     void Clear()
     {
         std::string().swap(pub);
         std::string().swap(sign);
         std::string().swap(base58addr);
-        std::string().swap(public_base58addr);
-        std::string().swap(version);
+        id = NodeId();
+        public_id = NodeId();
+        version = InternedString();
         is_public_node = false;
+        local_ip = 0;
         listen_port = 0;
         public_ip = 0;
         public_port = 0;
-        height = 0;
-        sign_fee = 0;
-        package_fee = 0;
-        ResetHeart();
+        revision = 0;
+        *runtime = NodeRuntime();
     }
     bool is_connected() const
     {
-        return nullptr != connection && connection->IsConnected();
-    }
-    void ResetHeart()
-    {
-        heart_time = HEART_TIME;
-        heart_probes = HEART_PROBES;
+        auto conn = runtime->connection.load();
+        return nullptr != conn && conn->IsConnected();
     }
     bool operator==(const Node &node) const
     {
@@ -72,10 +134,32 @@ struct Node
     }
 };
 
+//节点表的一个版本,只记录节点的增删和不常变化的字段,发布后不再修改,读取时无需加锁
+//修改需通过Insert/Erase以同时维护索引,索引均以节点id为key
+struct NodeTable
+{
+    uint64_t version;
+    std::unordered_map<NodeId, std::shared_ptr<const Node>, NodeIdHash> nodes;
+    std::set<NodeId> public_nodes;
+    std::unordered_map<NodeId, std::set<NodeId>, NodeIdHash> subnodes; //公网节点 -> 下属节点
+    NodeTable() : version(0) {}
+    std::shared_ptr<const Node> Find(const NodeId &id) const
+    {
+        auto it = nodes.find(id);
+        return nodes.end() == it ? nullptr : it->second;
+    }
+    std::shared_ptr<const Node> Find(const std::string &base58addr) const;
+    void GetPublicNodes(std::vector<std::shared_ptr<const Node>> &out_nodes) const;
+    void GetSubnodes(const NodeId &public_id, std::vector<std::shared_ptr<const Node>> &out_nodes) const;
+    //替换同id的节点,node->id需已设置
+    void Insert(const std::shared_ptr<const Node> &node);
+    bool Erase(const NodeId &id);
+};
+
 class PeerNode
 {
 public:
-    PeerNode() = default;
+    PeerNode();
     ~PeerNode() = default;
     PeerNode(PeerNode &&) = delete;
     PeerNode(const PeerNode &) = delete;
@@ -88,39 +172,117 @@ public:
 
     Node self_node();
     int InitSelfNode();
-    void SetSelfNodePublicBase58Addr(const std::string &base58addr);
+    void SetSelfNodePublicId(const NodeId &public_id);
     void SetSelfNodePublicIp(uint32_t public_ip);
     void SetSelfNodePublicPort(uint16_t public_port);
+    void SetSelfNodeHeight(uint64_t height);
     void SetSelfNodeFee(uint64_t fee);
     void SetSelfNodePackageFee(uint64_t package_fee);
+    //ConnectNodeReq中自身的NodeInfo编码,不含公网信息
+    std::shared_ptr<const EncodedNodeInfo> self_connect_nodeinfo();
+
+    //当前版本的节点表
+    std::shared_ptr<const NodeTable> nodes() const { return nodes_.load(); }
+    std::shared_ptr<const Node> FindNode(const NodeId &id) const;
+    //需解析base58地址,收到消息后已解析出id时使用上面的版本
+    std::shared_ptr<const Node> FindNode(const std::string &base58addr) const;
+    std::shared_ptr<const Node> FindNodeByConnection(const std::string &connection_id);
+    void GetPublicNodes(std::vector<std::shared_ptr<const Node>> &out_nodes) const;
+    void GetSubnodes(const NodeId &public_id, std::vector<std::shared_ptr<const Node>> &out_nodes) const;
 
     bool FindNodeByBase58Addr(const std::string &base58addr, Node &out_node);
     bool GetAllNodes(std::vector<Node> &out_nodes);
     bool GetAllPublicNodes(std::vector<Node> &out_nodes);
     bool GetNodesByPublicBase58Addr(const std::string &base58addr, std::vector<Node> &out_nodes);
     bool AddNode(const Node &node);
+    //加入多个节点,只发布一次节点表,update_existing为true时以UpdateNode更新已有的节点
+    //节点表中的下属节点达到kMaxListedSubnodes后不再加入未直连的下属节点
+    void AddNodes(const std::vector<Node> &nodes, bool update_existing);
     void DeleteNodeByBase58Addr(const std::string &base58addr);
     bool UpdateNode(const Node &node);
-    bool UpdateNodeConnect(const std::string &base58addr, std::shared_ptr<SocketConnection> connection);
-    bool UpdateNodeHeight(const std::string &base58addr, uint64_t height);
-    bool UpdateNodeSignFee(const std::string &base58addr, uint64_t sign_fee);
-    bool UpdateNodePackageFee(const std::string &base58addr, uint64_t package_fee);
-    void UpdateNodesByPublicBase58Addr(const std::string &public_base58addr, const std::vector<Node> &nodes);
+    //以下只原地修改节点中的字段,不复制节点表
+    bool UpdateNodeConnect(const NodeId &id, std::shared_ptr<SocketConnection> connection);
+    bool UpdateNodeHeight(const NodeId &id, uint64_t height);
+    bool UpdateNodeSignFee(const NodeId &id, uint64_t sign_fee);
+    bool UpdateNodePackageFee(const NodeId &id, uint64_t package_fee);
+    // id -> (rtt, rtt_var)
+    bool UpdateNodesRtt(const std::unordered_map<NodeId, std::pair<uint32_t, uint32_t>, NodeIdHash> &rtts);
+    //以nodes替换公网节点的全部下属节点
+    void UpdateNodesByPublicId(const NodeId &public_id, const std::vector<Node> &nodes);
+    //增量更新公网节点的下属节点
+    void UpdateNodesByPublicId(const NodeId &public_id, const std::vector<Node> &nodes, const std::vector<NodeId> &removed);
     void ConnectPublicList();
+    //下属节点测量已知公网节点的延迟,明显快于当前公网节点时切换过去
+    void ReselectPublicNode();
+
+    //加载上次保存的公网节点,节点的身份在使用时才校验
+    void LoadPeerCache();
+    //将节点表中的公网节点合并到保存的节点中并写入数据库
+    void SavePeerCache();
+    //保存的公网节点,最近出现的在前
+    void GetCachedPublicNodes(std::vector<Node> &out_nodes);
+    //公网节点启动时并行探测保存的公网节点,立即连接可达的节点
+    void ConnectCachedPublicNodes();
+
+    RoutingTable &routing_table() { return routing_table_; }
+    NodeSync &node_sync() { return node_sync_; }
+    //将联系过的节点加入路由表,桶已满时探测最久未联系的节点
+    //nodeinfo为不在节点表中的节点的NodeInfo编码
+    void UpdateRoutingTable(const NodeId &id, const std::string &base58addr, const std::string &nodeinfo = std::string());
+    //查找长时间未更新的桶中的随机key,刷新路由表
+    void RefreshRoutingTable();
+
+    //在节点表的新版本上执行修改,有修改时返回true并发布新版本
+    //同时提交的修改合并到同一个新版本中,只复制一次节点表
+    bool ModifyNodes(std::function<bool(NodeTable &)> modify);
 
 private:
+    //自身节点修改后重新编码,调用时需持有self_node_mutex_
+    void RefreshSelfNodeInfo();
+    //节点的连接由old_connection变为connection时更新连接索引
+    void IndexConnection(const NodeId &id, const std::shared_ptr<SocketConnection> &old_connection, const std::shared_ptr<SocketConnection> &connection);
+    void UpdateSubnodes(const NodeId &public_id, const std::vector<Node> &nodes, const std::vector<NodeId> &removed, bool is_full);
+    //从各个模块中移除已删除的节点
+    void RemovePeer(const NodeId &id);
+
+    struct PendingModify
+    {
+        std::function<bool(NodeTable &)> modify;
+        bool ret;
+    };
+    //复制并替换节点表中的单个节点,只用于修改节点表记录的字段,新节点共享原节点的runtime,节点不存在时返回false
+    static bool ModifyNode(NodeTable &table, const NodeId &id, std::function<void(Node &)> modify);
+
+    struct CachedNode
+    {
+        Node node;
+        uint64_t last_seen; //最后一次在节点表中的时间(秒)
+    };
 
     std::thread thread_;
     bool continue_runing_;
     std::mutex sync_node_mutex_;
     std::condition_variable sync_node_condition_;
 
-    std::mutex nodes_mutex_;
-    std::unordered_map<std::string, Node> all_node_map_;
-    std::set<std::string> pub_node_;
+    std::mutex nodes_mutex_; //修改节点表时加锁,读取不需要
+    std::atomic<std::shared_ptr<const NodeTable>> nodes_;
+    std::mutex pending_mutex_;
+    std::vector<PendingModify *> pending_modifies_;
+    std::mutex connections_mutex_;
+    std::unordered_map<std::string, NodeId> connections_; // connection_id -> 节点,连接在节点中原地修改,索引不随节点表发布
 
     std::mutex self_node_mutex_;
     Node self_node_;
+    std::shared_ptr<const EncodedNodeInfo> self_connect_nodeinfo_;
+    std::chrono::steady_clock::time_point last_reselect_time_;
+    std::chrono::steady_clock::time_point public_id_change_time_; //所属公网节点最近一次改变的时间,由self_node_mutex_保护
+    std::chrono::steady_clock::time_point last_save_time_;
+
+    std::mutex cache_mutex_;
+    std::unordered_map<NodeId, CachedNode, NodeIdHash> cached_nodes_;
+
+    RoutingTable routing_table_;
+    NodeSync node_sync_;
 };
 
 #endif
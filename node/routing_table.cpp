@@ -0,0 +1,269 @@
+#include "node/routing_table.h"
+#include "utils/crypto_utils.h"
+#include <algorithm>
+#include <random>
+
+RoutingTable::RoutingTable()
+{
+    size_ = 0;
+    for (auto &bucket : buckets_)
+    {
+        bucket.last_update = std::chrono::steady_clock::now();
+    }
+}
+
+std::string RoutingTable::GetKey(const std::string &base58addr)
+{
+    std::string hash;
+    std::string key;
+    GetSha256Hash(base58addr, hash);
+    Hex2Bytes(hash, key);
+    return key;
+}
+
+std::string RoutingTable::Distance(const std::string &key1, const std::string &key2)
+{
+    std::string distance(kKeyBits / 8, '\0');
+    for (size_t i = 0; i < distance.size() && i < key1.size() && i < key2.size(); ++i)
+    {
+        distance[i] = key1[i] ^ key2[i];
+    }
+    return distance;
+}
+
+void RoutingTable::set_self(const std::string &base58addr)
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    self_key_ = GetKey(base58addr);
+}
+
+void RoutingTable::Update(const NodeId &id, const std::string &base58addr, const std::string &nodeinfo, NodeId &out_probe)
+{
+    out_probe = NodeId();
+    std::string key;
+    std::unique_lock<std::mutex> lck(mutex_);
+    auto found = indexes_.find(id);
+    if (indexes_.end() == found)
+    {
+        //只有新加入的节点需要计算key
+        lck.unlock();
+        key = GetKey(base58addr);
+        lck.lock();
+        found = indexes_.find(id);
+    }
+    int index = indexes_.end() == found ? BucketIndex(key) : found->second;
+    if (index < 0)
+    {
+        return;
+    }
+    Bucket &bucket = buckets_[index];
+    bucket.last_update = std::chrono::steady_clock::now();
+    auto it = std::find_if(bucket.entries.begin(), bucket.entries.end(), [&id](const Entry &entry)
+                           { return entry.id == id; });
+    if (bucket.entries.end() != it)
+    {
+        if (!nodeinfo.empty())
+        {
+            it->nodeinfo = nodeinfo;
+        }
+        bucket.entries.splice(bucket.entries.end(), bucket.entries, it);
+        return;
+    }
+    Entry entry{id, key, nodeinfo};
+    it = std::find_if(bucket.replacements.begin(), bucket.replacements.end(), [&id](const Entry &entry)
+                      { return entry.id == id; });
+    if (bucket.replacements.end() != it)
+    {
+        entry.key = it->key;
+        if (entry.nodeinfo.empty())
+        {
+            entry.nodeinfo = it->nodeinfo;
+        }
+        bucket.replacements.erase(it);
+    }
+    indexes_[id] = index;
+    if (bucket.entries.size() < kBucketSize)
+    {
+        bucket.entries.push_back(entry);
+        ++size_;
+        return;
+    }
+    bucket.replacements.push_back(entry);
+    if (bucket.replacements.size() > kBucketSize)
+    {
+        indexes_.erase(bucket.replacements.front().id);
+        bucket.replacements.pop_front();
+    }
+    //同一个桶同时只探测一个节点
+    if (bucket.probe.empty())
+    {
+        bucket.probe = bucket.entries.front().id;
+        out_probe = bucket.probe;
+    }
+}
+
+void RoutingTable::OnProbe(const NodeId &id, bool alive)
+{
+    {
+        std::lock_guard<std::mutex> lck(mutex_);
+        auto found = indexes_.find(id);
+        if (indexes_.end() == found)
+        {
+            return;
+        }
+        Bucket &bucket = buckets_[found->second];
+        if (bucket.probe == id)
+        {
+            bucket.probe = NodeId();
+        }
+        if (alive)
+        {
+            auto it = std::find_if(bucket.entries.begin(), bucket.entries.end(), [&id](const Entry &entry)
+                                   { return entry.id == id; });
+            if (bucket.entries.end() != it)
+            {
+                bucket.entries.splice(bucket.entries.end(), bucket.entries, it);
+            }
+            return;
+        }
+    }
+    Remove(id);
+}
+
+void RoutingTable::Remove(const NodeId &id)
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    auto found = indexes_.find(id);
+    if (indexes_.end() == found)
+    {
+        return;
+    }
+    Bucket &bucket = buckets_[found->second];
+    indexes_.erase(found);
+    if (bucket.probe == id)
+    {
+        bucket.probe = NodeId();
+    }
+    bucket.replacements.remove_if([&id](const Entry &entry)
+                                  { return entry.id == id; });
+    auto it = std::find_if(bucket.entries.begin(), bucket.entries.end(), [&id](const Entry &entry)
+                           { return entry.id == id; });
+    if (bucket.entries.end() == it)
+    {
+        return;
+    }
+    bucket.entries.erase(it);
+    --size_;
+    //以最近加入的候补节点补充
+    if (!bucket.replacements.empty())
+    {
+        bucket.entries.push_back(bucket.replacements.back());
+        bucket.replacements.pop_back();
+        ++size_;
+    }
+}
+
+void RoutingTable::FindClosest(const std::string &key, size_t count, std::vector<NodeId> &out_ids)
+{
+    out_ids.clear();
+    std::vector<std::pair<std::string, NodeId>> nodes;
+    {
+        std::lock_guard<std::mutex> lck(mutex_);
+        nodes.reserve(size_);
+        for (auto &bucket : buckets_)
+        {
+            for (auto &entry : bucket.entries)
+            {
+                nodes.push_back(std::make_pair(Distance(entry.key, key), entry.id));
+            }
+        }
+    }
+    count = std::min(count, nodes.size());
+    std::partial_sort(nodes.begin(), nodes.begin() + count, nodes.end());
+    out_ids.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        out_ids.push_back(nodes.at(i).second);
+    }
+}
+
+bool RoutingTable::GetNodeInfo(const NodeId &id, std::string &out_nodeinfo)
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    auto found = indexes_.find(id);
+    if (indexes_.end() == found)
+    {
+        return false;
+    }
+    Bucket &bucket = buckets_[found->second];
+    auto it = std::find_if(bucket.entries.begin(), bucket.entries.end(), [&id](const Entry &entry)
+                           { return entry.id == id; });
+    if (bucket.entries.end() == it || it->nodeinfo.empty())
+    {
+        return false;
+    }
+    out_nodeinfo = it->nodeinfo;
+    return true;
+}
+
+void RoutingTable::GetStaleBuckets(std::chrono::seconds refresh_time, std::vector<uint32_t> &out_indexes)
+{
+    out_indexes.clear();
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lck(mutex_);
+    for (uint32_t i = 0; i < buckets_.size(); ++i)
+    {
+        if (!buckets_[i].entries.empty() && now - buckets_[i].last_update >= refresh_time)
+        {
+            out_indexes.push_back(i);
+        }
+    }
+}
+
+std::string RoutingTable::RefreshBucket(uint32_t index)
+{
+    static thread_local std::mt19937 engine(std::random_device{}());
+    std::lock_guard<std::mutex> lck(mutex_);
+    std::string key = self_key_;
+    if (index >= kKeyBits || key.size() != kKeyBits / 8)
+    {
+        return key;
+    }
+    buckets_[index].last_update = std::chrono::steady_clock::now();
+    //高于index的位与自身相同,第index位相反,低于index的位随机
+    size_t byte = key.size() - 1 - index / 8;
+    uint8_t bit = 1 << (index % 8);
+    uint8_t low_mask = bit - 1;
+    key[byte] = (key[byte] & ~(bit | low_mask)) | (~key[byte] & bit) | (engine() & low_mask);
+    for (size_t i = byte + 1; i < key.size(); ++i)
+    {
+        key[i] = (char)engine();
+    }
+    return key;
+}
+
+size_t RoutingTable::size()
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    return size_;
+}
+
+int RoutingTable::BucketIndex(const std::string &key) const
+{
+    std::string distance = Distance(self_key_, key);
+    for (size_t i = 0; i < distance.size(); ++i)
+    {
+        uint8_t byte = distance[i];
+        if (0 == byte)
+        {
+            continue;
+        }
+        int bit = 7;
+        while (0 == (byte & (1 << bit)))
+        {
+            --bit;
+        }
+        return (distance.size() - 1 - i) * 8 + bit;
+    }
+    return -1;
+}
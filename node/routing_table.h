@@ -0,0 +1,78 @@
+#ifndef UENC_NODE_ROUTING_TABLE_H_
+#define UENC_NODE_ROUTING_TABLE_H_
+
+#include "node/node_id.h"
+#include <array>
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//每个桶最多保存的节点数
+const size_t kBucketSize = 20;
+//节点key的位数,key为base58地址的sha256
+const size_t kKeyBits = 256;
+
+//按异或距离划分的k桶路由表,第i个桶保存与自身距离在[2^i, 2^(i+1))之间的节点
+class RoutingTable
+{
+public:
+    RoutingTable();
+    ~RoutingTable() = default;
+    RoutingTable(RoutingTable &&) = delete;
+    RoutingTable(const RoutingTable &) = delete;
+    RoutingTable &operator=(RoutingTable &&) = delete;
+    RoutingTable &operator=(const RoutingTable &) = delete;
+
+    static std::string GetKey(const std::string &base58addr);
+    //两个key的异或距离,可直接按字节序比较大小
+    static std::string Distance(const std::string &key1, const std::string &key2);
+
+    void set_self(const std::string &base58addr);
+    const std::string &self_key() const { return self_key_; }
+
+    //加入或刷新节点,桶已满时节点进入候补列表,base58addr只在节点第一次加入时用于计算key
+    //nodeinfo为编码的NodeInfo,不在节点表中的节点用于回复FindNodeReq,为空时保留原来的值
+    //out_probe不为空时调用者需探测该节点,并以结果调用OnProbe
+    void Update(const NodeId &id, const std::string &base58addr, const std::string &nodeinfo, NodeId &out_probe);
+    //alive为false时移除该节点并以候补节点补充
+    void OnProbe(const NodeId &id, bool alive);
+    void Remove(const NodeId &id);
+
+    //距离key最近的count个节点,由近到远
+    void FindClosest(const std::string &key, size_t count, std::vector<NodeId> &out_ids);
+    //桶中节点的NodeInfo编码,没有时返回false
+    bool GetNodeInfo(const NodeId &id, std::string &out_nodeinfo);
+    //超过refresh_time未更新的非空桶
+    void GetStaleBuckets(std::chrono::seconds refresh_time, std::vector<uint32_t> &out_indexes);
+    //生成落在第index个桶中的随机key,并将该桶标记为已刷新
+    std::string RefreshBucket(uint32_t index);
+    size_t size();
+
+private:
+    struct Entry
+    {
+        NodeId id;
+        std::string key;
+        std::string nodeinfo;
+    };
+    struct Bucket
+    {
+        std::list<Entry> entries;      //按最近联系时间排序,最久未联系的在前
+        std::list<Entry> replacements; //桶满时新加入的候补节点
+        NodeId probe; //正在探测的节点,同一个桶同时只探测一个节点
+        std::chrono::steady_clock::time_point last_update;
+    };
+    //与自身key相同时返回-1
+    int BucketIndex(const std::string &key) const;
+
+    std::mutex mutex_;
+    std::string self_key_;
+    std::array<Bucket, kKeyBits> buckets_;
+    size_t size_;
+    std::unordered_map<NodeId, int, NodeIdHash> indexes_; //桶中和候补列表中的节点 -> 所在的桶
+};
+
+#endif
@@ -0,0 +1,187 @@
+#include "node/state_announcer.h"
+#include "common/config.h"
+#include "node/msg_process.h"
+#include "node/peer_node.h"
+#include <algorithm>
+
+//以时间(微秒)作为序号,重启后仍大于之前发出的序号
+static uint64_t NextSeq(uint64_t seq)
+{
+    uint64_t now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    return std::max(seq + 1, now);
+}
+
+StateAnnouncer::StateAnnouncer()
+{
+    seq_ = NextSeq(0);
+}
+
+void StateAnnouncer::Announce(Field field)
+{
+    uint32_t delay = 0;
+    {
+        std::lock_guard<std::mutex> lck(mutex_);
+        seq_ = NextSeq(seq_);
+        auto &pending = pendings_.at(field);
+        pending.dirty = true;
+        if (pending.scheduled)
+        {
+            return;
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - pending.last_send).count();
+        if (elapsed < interval(field))
+        {
+            delay = interval(field) - elapsed;
+            pending.scheduled = true;
+        }
+    }
+    if (0 == delay)
+    {
+        Flush(field);
+        return;
+    }
+    Singleton<RpcManager>::instance()->AddTimer(delay, [this, field]()
+                                                { Flush(field); });
+}
+
+void StateAnnouncer::GetState(NodeState &out_state)
+{
+    //先取序号再取值,值不会旧于序号
+    {
+        std::lock_guard<std::mutex> lck(mutex_);
+        out_state.set_seq(seq_);
+    }
+    Node self_node = Singleton<PeerNode>::instance()->self_node();
+    out_state.set_height(self_node.runtime->height);
+    out_state.set_sign_fee(self_node.runtime->sign_fee);
+    out_state.set_package_fee(self_node.runtime->package_fee);
+}
+
+//seq比已收到的序号新时记录并返回true
+static bool UpdateSeq(std::array<uint64_t, StateAnnouncer::kField_Num> &seqs, StateAnnouncer::Field field, uint64_t seq)
+{
+    if (seq <= seqs.at(field))
+    {
+        return false;
+    }
+    seqs.at(field) = seq;
+    return true;
+}
+
+bool StateAnnouncer::Accept(const NodeId &id, Field field, uint64_t seq)
+{
+    if (0 == seq)
+    {
+        return true;
+    }
+    std::lock_guard<std::mutex> lck(mutex_);
+    //只记录节点表中的节点,节点删除后由RemovePeer清除,在锁内查找避免与删除交错
+    if (nullptr == Singleton<PeerNode>::instance()->FindNode(id))
+    {
+        return false;
+    }
+    return UpdateSeq(peer_seqs_[id], field, seq);
+}
+
+void StateAnnouncer::OnState(const NodeId &id, const NodeState &state)
+{
+    std::shared_ptr<const Node> node;
+    std::array<bool, kField_Num> accepted;
+    accepted.fill(true);
+    {
+        std::lock_guard<std::mutex> lck(mutex_);
+        node = Singleton<PeerNode>::instance()->FindNode(id);
+        if (nullptr == node)
+        {
+            return;
+        }
+        if (0 != state.seq())
+        {
+            auto &seqs = peer_seqs_[id];
+            for (int field = 0; field < kField_Num; ++field)
+            {
+                accepted.at(field) = UpdateSeq(seqs, (Field)field, state.seq());
+            }
+        }
+    }
+    //各字段在同一个节点中原地修改
+    if (accepted.at(kField_Height) && node->runtime->height != state.height())
+    {
+        node->runtime->height = state.height();
+    }
+    if (accepted.at(kField_SignFee) && node->runtime->sign_fee != state.sign_fee())
+    {
+        node->runtime->sign_fee = state.sign_fee();
+    }
+    if (accepted.at(kField_PackageFee) && node->runtime->package_fee != state.package_fee())
+    {
+        node->runtime->package_fee = state.package_fee();
+    }
+}
+
+void StateAnnouncer::RemovePeer(const NodeId &id)
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    peer_seqs_.erase(id);
+}
+
+void StateAnnouncer::Flush(Field field)
+{
+    uint64_t seq = 0;
+    {
+        std::lock_guard<std::mutex> lck(mutex_);
+        auto &pending = pendings_.at(field);
+        pending.scheduled = false;
+        if (!pending.dirty)
+        {
+            return;
+        }
+        pending.dirty = false;
+        pending.last_send = std::chrono::steady_clock::now();
+        seq = seq_;
+    }
+    Send(field, seq);
+}
+
+uint32_t StateAnnouncer::interval(Field field)
+{
+    auto conf = Singleton<Config>::instance();
+    return kField_Height == field ? conf->height_announce_interval() : conf->fee_announce_interval();
+}
+
+void StateAnnouncer::Send(Field field, uint64_t seq)
+{
+    Node self_node = Singleton<PeerNode>::instance()->self_node();
+    switch (field)
+    {
+    case kField_Height:
+    {
+        NodeHeightChangedReq req;
+        req.set_base58addr(self_node.base58addr);
+        req.set_height(self_node.runtime->height);
+        req.set_seq(seq);
+        SendBroadcaseMsgReq(req, Priority::kPriority_High_2);
+        break;
+    }
+    case kField_SignFee:
+    {
+        UpdateFeeReq req;
+        req.set_base58addr(self_node.base58addr);
+        req.set_fee(self_node.runtime->sign_fee);
+        req.set_seq(seq);
+        SendBroadcaseMsgReq(req, Priority::kPriority_Low_0);
+        break;
+    }
+    case kField_PackageFee:
+    {
+        UpdatePackageFeeReq req;
+        req.set_base58addr(self_node.base58addr);
+        req.set_package_fee(self_node.runtime->package_fee);
+        req.set_seq(seq);
+        SendBroadcaseMsgReq(req, Priority::kPriority_Low_0);
+        break;
+    }
+    default:
+        break;
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef UENC_NODE_STATE_ANNOUNCER_H_
+#define UENC_NODE_STATE_ANNOUNCER_H_
+
+#include "node/node_id.h"
+#include "proto/node.pb.h"
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+//广播自身高度和手续费的变化
+//同一字段在最小间隔内的多次变化合并,间隔到达时只广播最新的值
+//每次变化分配递增的序号,接收方忽略序号不大于已收到序号的更新
+class StateAnnouncer
+{
+public:
+    enum Field
+    {
+        kField_Height = 0,
+        kField_SignFee,
+        kField_PackageFee,
+        kField_Num
+    };
+
+    StateAnnouncer();
+    ~StateAnnouncer() = default;
+    StateAnnouncer(StateAnnouncer &&) = delete;
+    StateAnnouncer(const StateAnnouncer &) = delete;
+    StateAnnouncer &operator=(StateAnnouncer &&) = delete;
+    StateAnnouncer &operator=(const StateAnnouncer &) = delete;
+
+    //自身节点的字段已修改,距上次广播不足最小间隔时延后到间隔结束再广播
+    void Announce(Field field);
+    //心跳中附带的自身状态
+    void GetState(NodeState &out_state);
+
+    //节点id序号为seq的field更新是否比已收到的新,seq为0的旧版本消息总是接受,不在节点表中的节点不接受
+    bool Accept(const NodeId &id, Field field, uint64_t seq);
+    //收到心跳中附带的状态,只查找一次节点并更新有变化的字段
+    void OnState(const NodeId &id, const NodeState &state);
+    void RemovePeer(const NodeId &id);
+
+private:
+    struct Pending
+    {
+        bool dirty = false;     //有未广播的变化
+        bool scheduled = false; //已设置定时广播
+        std::chrono::steady_clock::time_point last_send;
+    };
+
+    //广播field的最新值
+    void Flush(Field field);
+    static uint32_t interval(Field field);
+    static void Send(Field field, uint64_t seq);
+
+    std::mutex mutex_;
+    uint64_t seq_;
+    std::array<Pending, kField_Num> pendings_;
+    std::unordered_map<NodeId, std::array<uint64_t, kField_Num>, NodeIdHash> peer_seqs_; //节点 -> 各字段已收到的序号
+};
+
+#endif
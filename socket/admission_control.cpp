@@ -0,0 +1,120 @@
+#include "socket/admission_control.h"
+#include "common/logging.h"
+#include "socket/protobuf_process.h"
+#include "socket/strand.h"
+#include "utils/singleton.hpp"
+#include <fstream>
+#include <unistd.h>
+
+const char *AdmissionLevelName(AdmissionLevel level)
+{
+    switch (level)
+    {
+    case kAdmission_Normal:
+        return "normal";
+    case kAdmission_Shed:
+        return "shed";
+    case kAdmission_Pause:
+        return "pause";
+    default:
+        return "unknown";
+    }
+}
+
+AdmissionControl::AdmissionControl()
+{
+    queue_soft_limit_ = 0;
+    queue_hard_limit_ = 0;
+    memory_soft_limit_ = 0;
+    memory_hard_limit_ = 0;
+    level_ = kAdmission_Normal;
+    queued_ = 0;
+    memory_ = 0;
+    rejected_ = 0;
+    slow_down_ = 0;
+    paused_ = 0;
+}
+
+void AdmissionControl::SetQueueLimit(uint64_t soft_limit, uint64_t hard_limit)
+{
+    queue_soft_limit_ = soft_limit;
+    queue_hard_limit_ = hard_limit;
+}
+
+void AdmissionControl::SetMemoryLimit(uint64_t soft_limit_mb, uint64_t hard_limit_mb)
+{
+    memory_soft_limit_ = soft_limit_mb * 1024 * 1024;
+    memory_hard_limit_ = hard_limit_mb * 1024 * 1024;
+}
+
+AdmissionLevel AdmissionControl::Update()
+{
+    uint64_t queued = Singleton<ProtobufProcess>::instance()->queued();
+    uint64_t memory = 0;
+    if (0 != memory_soft_limit_ || 0 != memory_hard_limit_)
+    {
+        memory = GetMemoryUsage();
+    }
+    AdmissionLevel level = kAdmission_Normal;
+    if ((0 != queue_hard_limit_ && queued >= queue_hard_limit_) ||
+        (0 != memory_hard_limit_ && memory >= memory_hard_limit_))
+    {
+        level = kAdmission_Pause;
+    }
+    else if ((0 != queue_soft_limit_ && queued >= queue_soft_limit_) ||
+             (0 != memory_soft_limit_ && memory >= memory_soft_limit_))
+    {
+        level = kAdmission_Shed;
+    }
+    AdmissionLevel prev_level = level_.exchange(level, std::memory_order_relaxed);
+    if (prev_level != level)
+    {
+        WARNLOG("admission level {} -> {}, queued {}, memory {}",
+                AdmissionLevelName(prev_level), AdmissionLevelName(level), queued, memory);
+    }
+    queued_.store(queued, std::memory_order_relaxed);
+    memory_.store(memory, std::memory_order_relaxed);
+    return level;
+}
+
+bool AdmissionControl::Admit(const std::string &type, Priority priority, bool is_response)
+{
+    AdmissionLevel level = level_.load(std::memory_order_relaxed);
+    if (kAdmission_Normal == level || is_response)
+    {
+        return true;
+    }
+    PriorityBand band = GetPriorityBand(priority);
+    if (kPriorityBand_High == band || (kAdmission_Shed == level && kPriorityBand_Middle == band))
+    {
+        return true;
+    }
+    if (Singleton<ProtobufProcess>::instance()->IsControl(type))
+    {
+        return true;
+    }
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void AdmissionControl::GetStats(AdmissionStats &out_stats) const
+{
+    out_stats.level = level_.load(std::memory_order_relaxed);
+    out_stats.queued = queued_.load(std::memory_order_relaxed);
+    out_stats.memory = memory_.load(std::memory_order_relaxed);
+    out_stats.rejected = rejected_.load(std::memory_order_relaxed);
+    out_stats.slow_down = slow_down_.load(std::memory_order_relaxed);
+    out_stats.paused = paused_.load(std::memory_order_relaxed);
+}
+
+uint64_t AdmissionControl::GetMemoryUsage()
+{
+    std::ifstream statm("/proc/self/statm");
+    uint64_t size = 0;
+    uint64_t resident = 0;
+    if (!(statm >> size >> resident))
+    {
+        return 0;
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+}
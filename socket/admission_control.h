@@ -0,0 +1,70 @@
+#ifndef UENC_SOCKET_ADMISSION_CONTROL_H_
+#define UENC_SOCKET_ADMISSION_CONTROL_H_
+
+#include "socket/define.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+//当前负载等级,等级越高拒绝的消息越多
+enum AdmissionLevel : uint8_t
+{
+    kAdmission_Normal = 0, //接收所有消息
+    kAdmission_Shed,       //拒绝低优先级消息并通知对端减速
+    kAdmission_Pause,      //拒绝非高优先级消息并暂停读取流量最大的连接
+};
+
+struct AdmissionStats
+{
+    AdmissionLevel level;
+    uint64_t queued;    //待处理的消息数
+    uint64_t memory;    //进程占用的内存(字节)
+    uint64_t rejected;  //被拒绝的消息数
+    uint64_t slow_down; //发送的减速通知数
+    uint64_t paused;    //暂停读取连接的次数
+};
+
+const char *AdmissionLevelName(AdmissionLevel level);
+
+//根据待处理消息数和内存占用决定是否接收新消息
+class AdmissionControl
+{
+public:
+    AdmissionControl();
+    ~AdmissionControl() = default;
+    AdmissionControl(AdmissionControl &&) = delete;
+    AdmissionControl(const AdmissionControl &) = delete;
+    AdmissionControl &operator=(AdmissionControl &&) = delete;
+    AdmissionControl &operator=(const AdmissionControl &) = delete;
+
+    void SetQueueLimit(uint64_t soft_limit, uint64_t hard_limit);
+    //单位MB,0表示不限制
+    void SetMemoryLimit(uint64_t soft_limit_mb, uint64_t hard_limit_mb);
+
+    //重新计算负载等级,由网络线程定时调用
+    AdmissionLevel Update();
+    AdmissionLevel level() const { return level_.load(std::memory_order_relaxed); }
+    //控制消息和回复总是被接收,丢弃回复只会让等待中的请求超时
+    bool Admit(const std::string &type, Priority priority, bool is_response);
+
+    void AddSlowDown() { slow_down_.fetch_add(1, std::memory_order_relaxed); }
+    void AddPaused() { paused_.fetch_add(1, std::memory_order_relaxed); }
+    void GetStats(AdmissionStats &out_stats) const;
+
+private:
+    static uint64_t GetMemoryUsage();
+
+    uint64_t queue_soft_limit_;
+    uint64_t queue_hard_limit_;
+    uint64_t memory_soft_limit_;
+    uint64_t memory_hard_limit_;
+
+    std::atomic<AdmissionLevel> level_;
+    std::atomic<uint64_t> queued_;
+    std::atomic<uint64_t> memory_;
+    std::atomic<uint64_t> rejected_;
+    std::atomic<uint64_t> slow_down_;
+    std::atomic<uint64_t> paused_;
+};
+
+#endif
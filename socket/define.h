@@ -40,4 +40,13 @@ enum Priority : uint8_t
     kPriority_High_2 = 15,
 };
 
+//连接的发送结果
+enum WriteResult : int
+{
+    kWrite_Success = 0,
+    kWrite_Disconnected = -1, //连接不存在或已断开
+    kWrite_SlowDown = -2,     //对端要求减速,未发送低优先级消息
+    kWrite_Backpressure = -3, //对端积压的待发送数据过多
+};
+
 #endif
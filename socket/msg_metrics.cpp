@@ -0,0 +1,145 @@
+#include "socket/msg_metrics.h"
+#include <mutex>
+
+void MsgMetrics::RecordQueueWait(const std::string &type, Priority priority, uint64_t wait_us)
+{
+    GetEntry(type, priority).queue_wait.Record(wait_us);
+}
+
+void MsgMetrics::RecordExpired(const std::string &type, Priority priority)
+{
+    GetEntry(type, priority).expired.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MsgMetrics::GetStats(std::vector<MsgTypeStats> &out_stats)
+{
+    out_stats.clear();
+    std::shared_lock<std::shared_mutex> lck(entries_mutex_);
+    MsgTypeStats stats;
+    for (auto &item : entries_)
+    {
+        stats.type = item.first.first;
+        stats.priority = (Priority)item.first.second;
+        auto &entry = *item.second;
+        stats.dispatched = entry.queue_wait.count();
+        stats.expired = entry.expired.load(std::memory_order_relaxed);
+        stats.wait_p50_us = entry.queue_wait.Percentile(50);
+        stats.wait_p99_us = entry.queue_wait.Percentile(99);
+        stats.wait_p999_us = entry.queue_wait.Percentile(99.9);
+        stats.wait_max_us = entry.queue_wait.max();
+        out_stats.push_back(stats);
+    }
+}
+
+void MsgMetrics::RecordHandle(const std::string &type, int ret, uint64_t latency_us)
+{
+    auto &entry = GetHandlerEntry(type);
+    entry.latency.Record(latency_us);
+    if (0 != ret)
+    {
+        std::lock_guard<std::mutex> lck(entry.errors_mutex);
+        ++entry.errors[ret];
+    }
+}
+
+void MsgMetrics::RecordBytesIn(const std::string &type, uint64_t bytes)
+{
+    auto &entry = GetHandlerEntry(type);
+    entry.msgs_in.fetch_add(1, std::memory_order_relaxed);
+    entry.bytes_in.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void MsgMetrics::RecordBytesOut(const std::string &type, uint64_t bytes, uint64_t msgs)
+{
+    auto &entry = GetHandlerEntry(type);
+    entry.msgs_out.fetch_add(msgs, std::memory_order_relaxed);
+    entry.bytes_out.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void MsgMetrics::RecordRpc(const std::string &type, int ret, uint64_t latency_us)
+{
+    auto &entry = GetHandlerEntry(type);
+    if (0 != ret)
+    {
+        entry.rpc_failed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    entry.rpc_latency.Record(latency_us);
+}
+
+void MsgMetrics::RecordLateResponse(const std::string &type)
+{
+    GetHandlerEntry(type).rpc_late.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MsgMetrics::GetHandlerStats(std::vector<HandlerStats> &out_stats)
+{
+    out_stats.clear();
+    std::shared_lock<std::shared_mutex> lck(handlers_mutex_);
+    for (auto &item : handlers_)
+    {
+        HandlerStats stats;
+        stats.type = item.first;
+        auto &entry = *item.second;
+        stats.calls = entry.latency.count();
+        {
+            std::lock_guard<std::mutex> errors_lck(entry.errors_mutex);
+            stats.errors = entry.errors;
+        }
+        stats.latency_p50_us = entry.latency.Percentile(50);
+        stats.latency_p99_us = entry.latency.Percentile(99);
+        stats.latency_p999_us = entry.latency.Percentile(99.9);
+        stats.latency_max_us = entry.latency.max();
+        stats.latency_total_us = entry.latency.sum();
+        stats.msgs_in = entry.msgs_in.load(std::memory_order_relaxed);
+        stats.bytes_in = entry.bytes_in.load(std::memory_order_relaxed);
+        stats.msgs_out = entry.msgs_out.load(std::memory_order_relaxed);
+        stats.bytes_out = entry.bytes_out.load(std::memory_order_relaxed);
+        stats.rpc_failed = entry.rpc_failed.load(std::memory_order_relaxed);
+        stats.rpc_calls = entry.rpc_latency.count() + stats.rpc_failed;
+        stats.rpc_p50_us = entry.rpc_latency.Percentile(50);
+        stats.rpc_p99_us = entry.rpc_latency.Percentile(99);
+        stats.rpc_max_us = entry.rpc_latency.max();
+        stats.rpc_late = entry.rpc_late.load(std::memory_order_relaxed);
+        out_stats.push_back(std::move(stats));
+    }
+}
+
+MsgMetrics::Entry &MsgMetrics::GetEntry(const std::string &type, Priority priority)
+{
+    auto key = std::make_pair(type, (uint8_t)priority);
+    {
+        std::shared_lock<std::shared_mutex> lck(entries_mutex_);
+        auto it = entries_.find(key);
+        if (entries_.end() != it)
+        {
+            return *it->second;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lck(entries_mutex_);
+    auto &entry = entries_[key];
+    if (nullptr == entry)
+    {
+        entry = std::make_unique<Entry>();
+    }
+    return *entry;
+}
+
+MsgMetrics::HandlerEntry &MsgMetrics::GetHandlerEntry(const std::string &type)
+{
+    {
+        std::shared_lock<std::shared_mutex> lck(handlers_mutex_);
+        auto it = handlers_.find(type);
+        if (handlers_.end() != it)
+        {
+            return *it->second;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lck(handlers_mutex_);
+    auto &entry = handlers_[type];
+    if (nullptr == entry)
+    {
+        entry = std::make_unique<HandlerEntry>();
+    }
+    return *entry;
+}
@@ -0,0 +1,100 @@
+#ifndef UENC_SOCKET_MSG_METRICS_H_
+#define UENC_SOCKET_MSG_METRICS_H_
+
+#include "socket/define.h"
+#include "utils/histogram.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+struct MsgTypeStats
+{
+    std::string type;
+    Priority priority;
+    uint64_t dispatched;  //出队处理的消息数
+    uint64_t expired;     //过期丢弃的消息数
+    uint64_t wait_p50_us; //排队时间
+    uint64_t wait_p99_us;
+    uint64_t wait_p999_us;
+    uint64_t wait_max_us;
+};
+
+struct HandlerStats
+{
+    std::string type;
+    uint64_t calls;
+    std::map<int, uint64_t> errors; //返回值 -> 次数
+    uint64_t latency_p50_us;        //处理函数耗时
+    uint64_t latency_p99_us;
+    uint64_t latency_p999_us;
+    uint64_t latency_max_us;
+    uint64_t latency_total_us;
+    uint64_t msgs_in;
+    uint64_t bytes_in;
+    uint64_t msgs_out;
+    uint64_t bytes_out;
+    uint64_t rpc_calls;  //以该类型消息发起的请求数
+    uint64_t rpc_failed; //超时等原因未收到回复的请求数
+    uint64_t rpc_p50_us; //从发出请求到收到回复的时间
+    uint64_t rpc_p99_us;
+    uint64_t rpc_max_us;
+    uint64_t rpc_late; //请求超时后才收到的该类型回复数
+};
+
+//按消息类型和优先级统计的消息处理指标
+class MsgMetrics
+{
+public:
+    MsgMetrics() = default;
+    ~MsgMetrics() = default;
+    MsgMetrics(MsgMetrics &&) = delete;
+    MsgMetrics(const MsgMetrics &) = delete;
+    MsgMetrics &operator=(MsgMetrics &&) = delete;
+    MsgMetrics &operator=(const MsgMetrics &) = delete;
+
+    void RecordQueueWait(const std::string &type, Priority priority, uint64_t wait_us);
+    void RecordExpired(const std::string &type, Priority priority);
+    void GetStats(std::vector<MsgTypeStats> &out_stats);
+
+    void RecordHandle(const std::string &type, int ret, uint64_t latency_us);
+    void RecordBytesIn(const std::string &type, uint64_t bytes);
+    //msgs条消息共bytes字节,同一消息广播给多个连接时合并记录
+    void RecordBytesOut(const std::string &type, uint64_t bytes, uint64_t msgs = 1);
+    void RecordRpc(const std::string &type, int ret, uint64_t latency_us);
+    void RecordLateResponse(const std::string &type);
+    void GetHandlerStats(std::vector<HandlerStats> &out_stats);
+
+private:
+    struct Entry
+    {
+        std::atomic<uint64_t> expired;
+        Histogram queue_wait;
+        Entry() : expired(0) {}
+    };
+    struct HandlerEntry
+    {
+        std::atomic<uint64_t> msgs_in;
+        std::atomic<uint64_t> bytes_in;
+        std::atomic<uint64_t> msgs_out;
+        std::atomic<uint64_t> bytes_out;
+        std::atomic<uint64_t> rpc_failed;
+        std::atomic<uint64_t> rpc_late;
+        Histogram latency;
+        Histogram rpc_latency;
+        std::mutex errors_mutex;
+        std::map<int, uint64_t> errors;
+        HandlerEntry() : msgs_in(0), bytes_in(0), msgs_out(0), bytes_out(0), rpc_failed(0), rpc_late(0) {}
+    };
+    Entry &GetEntry(const std::string &type, Priority priority);
+    HandlerEntry &GetHandlerEntry(const std::string &type);
+
+    std::shared_mutex entries_mutex_;
+    std::map<std::pair<std::string, uint8_t>, std::unique_ptr<Entry>> entries_;
+    std::shared_mutex handlers_mutex_;
+    std::map<std::string, std::unique_ptr<HandlerEntry>> handlers_;
+};
+
+#endif
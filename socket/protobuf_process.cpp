@@ -1,90 +1,433 @@
 #include "protobuf_process.h"
+#include "common/config.h"
+#include "common/logging.h"
+#include "socket/msg_metrics.h"
+#include "socket/rpc.h"
 #include "socket_api.h"
+#include <algorithm>
 #include <functional>
+#include <time.h>
 
-void ProtobufProcess::AddProcessData(const MsgData &msg)
+const std::string kControlPoolName("control");
+const std::string kBulkPoolName("bulk");
+const std::string kBlockingPoolName("blocking");
+const uint32_t kDefaultControlThreadNum = 2;
+const uint32_t kDefaultBlockingThreadNum = 2;
+const uint32_t kDefaultDedicatedThreadNum = 1;
+const uint32_t kDefaultQueueLimit = 100000;
+const uint32_t kAdjustInterval = 1000; //调整线程数的间隔,毫秒
+
+thread_local const MsgData *ProtobufProcess::current_msg_ = nullptr;
+thread_local int64_t ProtobufProcess::inline_remain_ns_ = -1;
+
+static int64_t ThreadCpuTimeNs()
 {
+    struct timespec ts;
+    if (0 != clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+    {
+        return 0;
+    }
+    return (int64_t)ts.tv_sec * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
+
+static void GetWorkPoolConfig(const std::string &name, WorkPoolConfig &out_conf)
+{
+    auto conf = Singleton<Config>::instance();
+    if (conf->work_pool(name, out_conf))
+    {
+        return;
+    }
+    out_conf.queue_limit = kDefaultQueueLimit;
+    out_conf.cpus.clear();
+    if (kControlPoolName == name)
     {
-        std::lock_guard<std::mutex> lck(process_mutex_);
-        process_queue_.push(std::move(msg));
+        out_conf.thread_num = kDefaultControlThreadNum;
     }
-    if (!process_queue_.empty())
+    else if (kBulkPoolName == name)
     {
-        process_condition_.notify_all();
+        out_conf.thread_num = conf->work_thread_num();
+    }
+    else if (kBlockingPoolName == name)
+    {
+        out_conf.thread_num = kDefaultBlockingThreadNum;
+    }
+    else
+    {
+        out_conf.thread_num = kDefaultDedicatedThreadNum;
+    }
+    out_conf.max_thread_num = out_conf.thread_num;
+    if (kBulkPoolName == name)
+    {
+        out_conf.max_thread_num = out_conf.thread_num * 2;
+    }
+}
+
+ProtobufProcess::ProtobufProcess()
+{
+    is_started_ = false;
+    continue_runing_ = false;
+    weights_.fill(1);
+    aging_time_ = 1000;
+    queued_ = 0;
+    inline_budget_ns_ = 2 * 1000 * 1000;
+    inline_handled_ = 0;
+    inline_overflow_ = 0;
+    control_pool_ = AddWorkPool(kControlPoolName);
+    bulk_pool_ = AddWorkPool(kBulkPoolName);
+    blocking_pool_ = AddWorkPool(kBlockingPoolName);
+}
+
+bool ProtobufProcess::AddProcessData(const MsgData &msg_data)
+{
+    if (nullptr == msg_data.msg)
+    {
+        return false;
+    }
+    MsgData msg = msg_data;
+    const std::string &name = msg.msg->GetDescriptor()->name();
+    if (msg.ttl <= std::chrono::milliseconds::zero())
+    {
+        msg.ttl = GetTimeToLive(name);
+    }
+    ExecutionClass execution = kExecution_Bulk;
+    auto pool = GetWorkPool(name, execution);
+    if (kExecution_Inline == execution)
+    {
+        if (0 != inline_remain_ns_)
+        {
+            int64_t start = ThreadCpuTimeNs();
+            Handle(msg);
+            ++inline_handled_;
+            if (inline_remain_ns_ > 0)
+            {
+                inline_remain_ns_ = std::max<int64_t>(0, inline_remain_ns_ - (ThreadCpuTimeNs() - start));
+            }
+            return true;
+        }
+        //本次回调的CPU时间已用完
+        ++inline_overflow_;
+        pool = control_pool_;
+    }
+    //回复只用于完成等待中的调用,处理函数挂起等待同一连接的回复时不能被排在其后
+    //直接处理的消息只更新带序号的状态或不依赖之前的消息,可以与其他消息乱序
+    msg.ordered = nullptr != msg.connection && kExecution_Inline != execution && !msg.is_response;
+    ++queued_;
+    if (msg.ordered && !order_.Acquire(msg))
+    {
+        //连接上之前的消息还未处理完
+        return true;
+    }
+    if (nullptr == pool || !pool->AddProcessData(msg))
+    {
+        --queued_;
+        WARNLOG("work pool queue is full, drop message {}", name);
+        Release(msg);
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<WorkPool> ProtobufProcess::GetWorkPool(const std::string &name, ExecutionClass &out_execution)
+{
+    std::lock_guard<std::mutex> lck(pools_mutex_);
+    out_execution = kExecution_Bulk;
+    auto it = executions_.find(name);
+    if (executions_.end() != it)
+    {
+        out_execution = it->second;
+    }
+    switch (out_execution)
+    {
+    case kExecution_Inline:
+        return nullptr;
+    case kExecution_Control:
+        return control_pool_;
+    case kExecution_Dedicated:
+    {
+        auto pool_it = pools_.find(name);
+        return pools_.end() == pool_it ? nullptr : pool_it->second;
+    }
+    default:
+        return bulk_pool_;
+    }
+}
+
+void ProtobufProcess::Release(const MsgData &msg)
+{
+    if (!msg.ordered || nullptr == msg.connection)
+    {
+        return;
+    }
+    MsgData next;
+    while (order_.Release(msg.connection->connection_id(), next))
+    {
+        const std::string &name = next.msg->GetDescriptor()->name();
+        ExecutionClass execution = kExecution_Bulk;
+        auto pool = GetWorkPool(name, execution);
+        if (nullptr != pool && pool->AddProcessData(next))
+        {
+            return;
+        }
+        //丢弃后继续交出连接上的下一条消息
+        --queued_;
+        WARNLOG("work pool queue is full, drop message {}", name);
     }
 }
 
 void ProtobufProcess::AddProcessData(const std::vector<MsgData> &msgs)
 {
+    for (auto &msg : msgs)
     {
-        std::lock_guard<std::mutex> lck(process_mutex_);
-        for (auto &msg : msgs)
+        AddProcessData(msg);
+    }
+}
+
+const MsgData *ProtobufProcess::SwapCurrentMsg(const MsgData *msg)
+{
+    const MsgData *prev_msg = current_msg_;
+    current_msg_ = msg;
+    return prev_msg;
+}
+
+void ProtobufProcess::Offload(std::function<void()> func)
+{
+    blocking_pool_->Post(func, Priority::kPriority_Middle_0);
+}
+
+int ProtobufProcess::RunTask(const std::string &name, Task task)
+{
+    struct TaskState
+    {
+        std::atomic<int> phase; // 0执行中 1已完成 2已挂起
+        int ret;
+    };
+    auto state = std::make_shared<TaskState>();
+    state->phase = 0;
+    state->ret = 0;
+    auto start = std::chrono::steady_clock::now();
+    //挂起后完成时才释放连接上的顺序
+    MsgData order_msg;
+    order_msg.connection = current_msg_->connection;
+    order_msg.ordered = current_msg_->ordered;
+    task.Start(*current_msg_, [state, name, start, order_msg](int ret)
+               {
+                   state->ret = ret;
+                   if (2 == state->phase.exchange(1))
+                   {
+                       auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+                       Singleton<MsgMetrics>::instance()->RecordHandle(name, ret, latency);
+                       Singleton<ProtobufProcess>::instance()->Release(order_msg);
+                   } });
+    if (1 == state->phase.exchange(2))
+    {
+        return state->ret;
+    }
+    return kHandle_Suspended;
+}
+
+bool ProtobufProcess::IsControl(const std::string &name)
+{
+    std::lock_guard<std::mutex> lck(pools_mutex_);
+    auto it = executions_.find(name);
+    if (executions_.end() == it)
+    {
+        return false;
+    }
+    return kExecution_Inline == it->second || kExecution_Control == it->second;
+}
+
+void ProtobufProcess::BeginInlineBudget()
+{
+    inline_remain_ns_ = inline_budget_ns_;
+}
+
+void ProtobufProcess::EndInlineBudget()
+{
+    inline_remain_ns_ = -1;
+}
+
+void ProtobufProcess::GetInlineStats(uint64_t &out_handled, uint64_t &out_overflow) const
+{
+    out_handled = inline_handled_.load(std::memory_order_relaxed);
+    out_overflow = inline_overflow_.load(std::memory_order_relaxed);
+}
+
+void ProtobufProcess::SetSchedulePolicy(const std::array<uint32_t, kPriorityBand_Count> &weights, uint32_t aging_time_ms)
+{
+    std::lock_guard<std::mutex> lck(pools_mutex_);
+    weights_ = weights;
+    aging_time_ = aging_time_ms;
+    for (auto &item : pools_)
+    {
+        item.second->SetSchedulePolicy(weights_, aging_time_);
+    }
+}
+
+void ProtobufProcess::GetWorkPoolStats(std::vector<WorkPoolStats> &out_stats)
+{
+    std::vector<std::shared_ptr<WorkPool>> pools;
+    {
+        std::lock_guard<std::mutex> lck(pools_mutex_);
+        for (auto &item : pools_)
         {
-            process_queue_.push(msg);
+            pools.push_back(item.second);
         }
     }
-    if (!process_queue_.empty())
+    out_stats.clear();
+    out_stats.resize(pools.size());
+    for (size_t i = 0; i < pools.size(); ++i)
     {
-        process_condition_.notify_all();
+        pools.at(i)->GetStats(out_stats.at(i));
     }
 }
 
-void ProtobufProcess::ThreadStart(std::uint32_t thread_num)
+void ProtobufProcess::ThreadStart()
 {
-    continue_wait_ = true;
-    for (size_t i = 0; i < thread_num; ++i)
+    std::lock_guard<std::mutex> lck(pools_mutex_);
+    if (is_started_)
     {
-        threads_.push_back(std::thread(std::bind(&ProtobufProcess::ThreadWork, this)));
-        threads_.back().detach();
+        return;
     }
+    is_started_ = true;
+    for (auto &item : pools_)
+    {
+        StartWorkPool(item.second);
+    }
+    continue_runing_ = true;
+    std::thread(std::bind(&ProtobufProcess::AdjustWork, this)).detach();
 }
-void ProtobufProcess::ThreadWork()
+
+void ProtobufProcess::ThreadStop()
 {
-    pthread_setname_np(pthread_self(), "uenc_work");
-    MsgData msg;
-    while (continue_wait_)
+    std::lock_guard<std::mutex> lck(pools_mutex_);
+    is_started_ = false;
+    {
+        std::lock_guard<std::mutex> adjust_lck(adjust_mutex_);
+        continue_runing_ = false;
+    }
+    adjust_condition_.notify_all();
+    for (auto &item : pools_)
+    {
+        item.second->ThreadStop();
+    }
+}
+
+void ProtobufProcess::AdjustWork()
+{
+    pthread_setname_np(pthread_self(), "uenc_pool_adj");
+    while (true)
     {
-        std::unique_lock<std::mutex> process_locker(process_mutex_);
-        while (process_queue_.empty())
         {
-            if (!continue_wait_)
+            std::unique_lock<std::mutex> lck(adjust_mutex_);
+            adjust_condition_.wait_for(lck, std::chrono::milliseconds(kAdjustInterval), [this]()
+                                       { return !continue_runing_; });
+            if (!continue_runing_)
             {
                 return;
             }
-            process_condition_.wait(process_locker);
-            if (!continue_wait_)
+        }
+        std::vector<std::shared_ptr<WorkPool>> pools;
+        {
+            std::lock_guard<std::mutex> lck(pools_mutex_);
+            for (auto &item : pools_)
             {
-                return;
+                pools.push_back(item.second);
             }
         }
-        msg = std::move(process_queue_.top());
-        process_queue_.pop();
-        process_locker.unlock();
-        Handle(msg);
-        msg.Clear();
+        for (auto &pool : pools)
+        {
+            pool->Adjust();
+        }
     }
 }
 
-void ProtobufProcess::ThreadStop()
-{
-    continue_wait_ = false;
-    process_condition_.notify_all();
-}
-
 int ProtobufProcess::Handle(const MsgData &msg)
 {
     if(nullptr == msg.msg)
     {
         return -1;
     }
+    //等待中的调用的回复交给调用者处理
+    if (Singleton<RpcManager>::instance()->OnResponse(msg))
+    {
+        return 0;
+    }
     std::string name = msg.msg->GetDescriptor()->name();
     auto it = protocbs_.find(name);
-    if (it != protocbs_.end())
+    if (it == protocbs_.end())
     {
-        return it->second(msg.msg, msg.connection);
+        return -2;
     }
-    else
+    auto ttl = msg.ttl > std::chrono::milliseconds::zero() ? msg.ttl : GetTimeToLive(name);
+    if (ttl > std::chrono::milliseconds::zero() && std::chrono::steady_clock::now() - msg.recv_time > ttl)
     {
-        return -2;
+        Singleton<MsgMetrics>::instance()->RecordExpired(name, msg.priority);
+        return -3;
+    }
+    const MsgData *prev_msg = current_msg_;
+    current_msg_ = &msg;
+    auto start = std::chrono::steady_clock::now();
+    auto ret = it->second(msg.msg, msg.connection);
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    current_msg_ = prev_msg;
+    if (kHandle_Suspended == ret)
+    {
+        return ret;
+    }
+    Singleton<MsgMetrics>::instance()->RecordHandle(name, ret, latency);
+    if (0 != ret)
+    {
+        DEBUGLOG("handle {} failed, ret {}", name, ret);
+    }
+    return ret;
+}
+
+void ProtobufProcess::SetExecutionClass(const std::string &name, ExecutionClass execution)
+{
+    std::lock_guard<std::mutex> lck(pools_mutex_);
+    executions_[name] = execution;
+    if (kExecution_Dedicated != execution || pools_.end() != pools_.find(name))
+    {
+        return;
     }
+    auto pool = AddWorkPool(name);
+    if (is_started_)
+    {
+        StartWorkPool(pool);
+    }
+}
+
+std::chrono::milliseconds ProtobufProcess::GetTimeToLive(const std::string &name) const
+{
+    auto it = ttls_.find(name);
+    if (ttls_.end() == it)
+    {
+        return std::chrono::milliseconds::zero();
+    }
+    return it->second;
+}
+
+void ProtobufProcess::StartWorkPool(const std::shared_ptr<WorkPool> &pool)
+{
+    WorkPoolConfig pool_conf;
+    GetWorkPoolConfig(pool->name(), pool_conf);
+    pool->set_queue_limit(pool_conf.queue_limit);
+    pool->SetThreadRange(pool_conf.thread_num, pool_conf.max_thread_num);
+    pool->set_cpus(pool_conf.cpus);
+    pool->ThreadStart(pool_conf.thread_num);
+}
+
+std::shared_ptr<WorkPool> ProtobufProcess::AddWorkPool(const std::string &name)
+{
+    auto pool = std::make_shared<WorkPool>(name, [this](const MsgData &msg)
+                                           {
+                                               //挂起的协程完成时再释放
+                                               if (kHandle_Suspended != Handle(msg))
+                                               {
+                                                   Release(msg);
+                                               }
+                                               --queued_; });
+    pool->SetSchedulePolicy(weights_, aging_time_);
+    pools_[name] = pool;
+    return pool;
 }
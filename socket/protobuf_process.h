@@ -3,71 +3,130 @@
 
 #include "define.h"
 #include "socket/socket_manager.h"
+#include "socket/strand.h"
+#include "socket/task.h"
+#include "socket/work_pool.h"
+#include <atomic>
 #include <condition_variable>
 #include <functional>
 #include <google/protobuf/message.h>
+#include <map>
 #include <mutex>
-#include <queue>
-#include <thread>
 
-struct MsgData
+//消息处理函数的执行方式
+enum ExecutionClass : uint8_t
 {
-    Priority priority;
-    std::shared_ptr<google::protobuf::Message> msg;
-    std::shared_ptr<SocketConnection> connection;
-
-    void Clear()
-    {
-        priority = Priority::kPriority_Low_0;
-        msg.reset();
-        connection.reset();
-    }
-    MsgData()
-    {
-        Clear();
-    }
-    bool operator<(const MsgData &msg_data) const
-    {
-        return priority < msg_data.priority;
-    }
+    kExecution_Inline = 0, //在收到消息的线程中直接执行
+    kExecution_Control,    //控制消息线程池
+    kExecution_Bulk,       //普通消息线程池
+    kExecution_Dedicated,  //该消息类型独占的线程池
 };
 
 class ProtobufProcess
 {
 public:
-    ProtobufProcess() = default;
+    ProtobufProcess();
     ~ProtobufProcess() = default;
     ProtobufProcess(ProtobufProcess &&) = delete;
     ProtobufProcess(const ProtobufProcess &) = delete;
     ProtobufProcess &operator=(ProtobufProcess &&) = delete;
     ProtobufProcess &operator=(const ProtobufProcess &) = delete;
 
-    void AddProcessData(const MsgData &msg);
+    bool AddProcessData(const MsgData &msg);
     void AddProcessData(const std::vector<MsgData> &msgs);
 
-    void ThreadStart(std::uint32_t thread_num);
-    void ThreadWork();
+    void SetSchedulePolicy(const std::array<uint32_t, kPriorityBand_Count> &weights, uint32_t aging_time_ms);
+    void GetWorkPoolStats(std::vector<WorkPoolStats> &out_stats);
+    //在线程池中排队和正在处理的消息数
+    uint64_t queued() const { return queued_.load(std::memory_order_relaxed); }
+    bool IsControl(const std::string &name);
+    //等待同一连接之前的消息处理完成的消息数
+    size_t order_waiting() { return order_.waiting(); }
+
+    //在当前线程中限制直接处理消息的CPU时间,超出后转入控制消息线程池
+    //只在处理每条消息前检查,单条消息可能超出预算,直接处理的函数不应执行耗时操作
+    void set_inline_budget(uint32_t budget_us) { inline_budget_ns_ = (int64_t)budget_us * 1000; }
+    void BeginInlineBudget();
+    void EndInlineBudget();
+    void GetInlineStats(uint64_t &out_handled, uint64_t &out_overflow) const;
+
+    void ThreadStart();
     void ThreadStop();
 
     int Handle(const MsgData &data);
+    //当前线程正在处理的消息,不在消息处理函数中时为nullptr
+    static const MsgData *current_msg() { return current_msg_; }
+    //设置当前处理的消息,返回之前的值
+    static const MsgData *SwapCurrentMsg(const MsgData *msg);
+    //在阻塞操作线程池中执行
+    void Offload(std::function<void()> func);
 
     template <typename T>
-    void RegisterCallback(std::function<int(const std::shared_ptr<T> &, std::shared_ptr<SocketConnection>)> cb)
+    void SetTimeToLive(uint32_t ttl_ms)
     {
-        protocbs_[T::descriptor()->name()] = [cb](const std::shared_ptr<google::protobuf::Message> &msg, std::shared_ptr<SocketConnection> connection)
+        ttls_[T::descriptor()->name()] = std::chrono::milliseconds(ttl_ms);
+    }
+
+    template <typename T>
+    void RegisterCallback(std::function<int(const std::shared_ptr<T> &, std::shared_ptr<SocketConnection>)> cb, ExecutionClass execution = kExecution_Bulk)
+    {
+        const std::string &name = T::descriptor()->name();
+        protocbs_[name] = [cb](const std::shared_ptr<google::protobuf::Message> &msg, std::shared_ptr<SocketConnection> connection)
         {
             return cb(std::static_pointer_cast<T>(msg), connection);
         };
+        SetExecutionClass(name, execution);
+    }
+
+    //协程形式的处理函数,参数按值传递以便在挂起后继续使用
+    template <typename T>
+    void RegisterCallback(std::function<Task(std::shared_ptr<T>, std::shared_ptr<SocketConnection>)> cb, ExecutionClass execution = kExecution_Bulk)
+    {
+        const std::string &name = T::descriptor()->name();
+        protocbs_[name] = [cb, name](const std::shared_ptr<google::protobuf::Message> &msg, std::shared_ptr<SocketConnection> connection)
+        {
+            return RunTask(name, cb(std::static_pointer_cast<T>(msg), connection));
+        };
+        SetExecutionClass(name, execution);
     }
 
 private:
+    static int RunTask(const std::string &name, Task task);
+    //消息类型的执行方式及其线程池,直接处理的消息没有线程池
+    std::shared_ptr<WorkPool> GetWorkPool(const std::string &name, ExecutionClass &out_execution);
+    //按连接排序的消息处理完成,将连接上等待的下一条消息交给其线程池
+    void Release(const MsgData &msg);
+    void SetExecutionClass(const std::string &name, ExecutionClass execution);
+    std::shared_ptr<WorkPool> AddWorkPool(const std::string &name);
+    //调用者加锁
+    void StartWorkPool(const std::shared_ptr<WorkPool> &pool);
+    //定时根据负载调整各线程池的线程数
+    void AdjustWork();
+
+    std::chrono::milliseconds GetTimeToLive(const std::string &name) const;
+
     std::map<const std::string, std::function<int(const std::shared_ptr<google::protobuf::Message> &, std::shared_ptr<SocketConnection>)>> protocbs_;
+    std::map<const std::string, std::chrono::milliseconds> ttls_;
+    static thread_local const MsgData *current_msg_;
+    static thread_local int64_t inline_remain_ns_; //小于0表示不限制
+    int64_t inline_budget_ns_;
+    std::atomic<uint64_t> inline_handled_;
+    std::atomic<uint64_t> inline_overflow_;
 
-    std::vector<std::thread> threads_;
-    bool continue_wait_;
-    std::mutex process_mutex_;
-    std::condition_variable process_condition_;
-    std::priority_queue<MsgData> process_queue_;
+    bool is_started_;
+    bool continue_runing_;
+    std::mutex adjust_mutex_;
+    std::condition_variable adjust_condition_;
+    std::array<uint32_t, kPriorityBand_Count> weights_;
+    uint32_t aging_time_;
+    std::atomic<uint64_t> queued_;
+    ConnectionOrder order_;
+    std::mutex pools_mutex_;
+    std::map<std::string, ExecutionClass> executions_;
+    std::map<std::string, std::shared_ptr<WorkPool>> pools_;
+    std::shared_ptr<WorkPool> control_pool_;
+    std::shared_ptr<WorkPool> bulk_pool_;
+    std::shared_ptr<WorkPool> blocking_pool_;
 };
 
 #endif
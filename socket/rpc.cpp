@@ -0,0 +1,163 @@
+#include "socket/rpc.h"
+#include "common/logging.h"
+#include "socket/msg_metrics.h"
+#include "socket/socket_manager.h"
+#include "utils/singleton.hpp"
+#include <random>
+#include <vector>
+
+RpcManager::RpcManager()
+{
+    //起始id随机,其他节点无法猜测等待中的请求
+    std::random_device rd;
+    next_id_ = ((uint64_t)rd() << 32 | rd()) >> 1 | 1;
+    continue_runing_ = false;
+}
+
+uint64_t RpcManager::AddPendingCall(const std::string &type, uint32_t timeout_ms, const std::string &connection_id, RpcCallback<google::protobuf::Message> cb)
+{
+    uint64_t correlation_id = next_id_.fetch_add(1);
+    auto now = std::chrono::steady_clock::now();
+    bool notify = false;
+    {
+        std::lock_guard<std::mutex> lck(calls_mutex_);
+        auto &call = calls_[correlation_id];
+        call.type = type;
+        call.connection_id = connection_id;
+        call.cb = cb;
+        call.start = now;
+        call.deadline = deadlines_.insert(std::make_pair(now + std::chrono::milliseconds(timeout_ms), correlation_id));
+        notify = (deadlines_.begin() == call.deadline);
+    }
+    if (notify)
+    {
+        calls_condition_.notify_one();
+    }
+    return correlation_id;
+}
+
+void RpcManager::AddTimer(uint32_t delay_ms, std::function<void()> cb)
+{
+    AddPendingCall(std::string(), delay_ms, std::string(), [cb](int ret, const std::shared_ptr<google::protobuf::Message> &rsp)
+                   { cb(); });
+}
+
+void RpcManager::CancelPendingCall(uint64_t correlation_id)
+{
+    std::lock_guard<std::mutex> lck(calls_mutex_);
+    auto it = calls_.find(correlation_id);
+    if (calls_.end() == it)
+    {
+        return;
+    }
+    deadlines_.erase(it->second.deadline);
+    calls_.erase(it);
+}
+
+bool RpcManager::OnResponse(const MsgData &msg)
+{
+    if (!msg.is_response || 0 == msg.correlation_id)
+    {
+        return false;
+    }
+    //经TransMsgReq转发的回复以转发的连接为来源
+    const std::string &connection_id = nullptr != msg.connection ? msg.connection->connection_id() : msg.relay_connection_id;
+    const std::string &type = msg.msg->GetDescriptor()->name();
+    PendingCall call;
+    bool found = false;
+    {
+        std::lock_guard<std::mutex> lck(calls_mutex_);
+        auto it = calls_.find(msg.correlation_id);
+        //定时器没有连接,不能被回复触发
+        if (calls_.end() != it && (it->second.connection_id.empty() || it->second.connection_id != connection_id))
+        {
+            WARNLOG("drop response {} {} from unexpected connection {}", type, msg.correlation_id, connection_id);
+            return true;
+        }
+        if (calls_.end() != it)
+        {
+            deadlines_.erase(it->second.deadline);
+            call = std::move(it->second);
+            calls_.erase(it);
+            found = true;
+        }
+    }
+    if (!found)
+    {
+        //调用者已按超时处理,不能再交给普通的处理函数
+        DEBUGLOG("drop late response {} {}", type, msg.correlation_id);
+        Singleton<MsgMetrics>::instance()->RecordLateResponse(type);
+        return true;
+    }
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - call.start).count();
+    Singleton<MsgMetrics>::instance()->RecordRpc(call.type, kRpc_Success, latency);
+    call.cb(kRpc_Success, msg.msg);
+    return true;
+}
+
+size_t RpcManager::pending_size()
+{
+    std::lock_guard<std::mutex> lck(calls_mutex_);
+    return calls_.size();
+}
+
+void RpcManager::ThreadStart()
+{
+    continue_runing_ = true;
+    timer_thread_ = std::thread(std::bind(&RpcManager::ThreadWork, this));
+    timer_thread_.detach();
+}
+
+void RpcManager::ThreadWork()
+{
+    pthread_setname_np(pthread_self(), "uenc_rpc");
+    std::vector<PendingCall> expired_calls;
+    auto metrics = Singleton<MsgMetrics>::instance();
+    while (continue_runing_)
+    {
+        {
+            std::unique_lock<std::mutex> lck(calls_mutex_);
+            if (deadlines_.empty())
+            {
+                calls_condition_.wait_for(lck, std::chrono::seconds(1));
+            }
+            else
+            {
+                calls_condition_.wait_until(lck, deadlines_.begin()->first);
+            }
+            auto now = std::chrono::steady_clock::now();
+            while (!deadlines_.empty() && (!continue_runing_ || deadlines_.begin()->first <= now))
+            {
+                auto it = calls_.find(deadlines_.begin()->second);
+                deadlines_.erase(deadlines_.begin());
+                if (calls_.end() == it)
+                {
+                    continue;
+                }
+                expired_calls.push_back(std::move(it->second));
+                calls_.erase(it);
+            }
+        }
+        int ret = continue_runing_ ? kRpc_Timeout : kRpc_Shutdown;
+        for (auto &call : expired_calls)
+        {
+            //定时器没有消息类型
+            if (!call.type.empty())
+            {
+                DEBUGLOG("rpc {} failed, ret {}", call.type, ret);
+                metrics->RecordRpc(call.type, ret, 0);
+            }
+            call.cb(ret, nullptr);
+        }
+        expired_calls.clear();
+    }
+}
+
+void RpcManager::ThreadStop()
+{
+    {
+        std::lock_guard<std::mutex> lck(calls_mutex_);
+        continue_runing_ = false;
+    }
+    calls_condition_.notify_all();
+}
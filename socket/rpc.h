@@ -0,0 +1,106 @@
+#ifndef UENC_SOCKET_RPC_H_
+#define UENC_SOCKET_RPC_H_
+
+#include "socket/strand.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <google/protobuf/message.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+enum RpcError : int
+{
+    kRpc_Success = 0,
+    kRpc_Timeout = -1,   //等待回复超时
+    kRpc_WrongType = -2, //回复的消息类型与预期不符
+    kRpc_Shutdown = -3,  //等待期间停止了服务
+};
+
+template <typename T>
+struct RpcResult
+{
+    int ret;
+    std::shared_ptr<T> rsp;
+};
+
+//回调在处理回复的线程中执行,超时的回调在超时检测线程中执行
+template <typename T>
+using RpcCallback = std::function<void(int ret, const std::shared_ptr<T> &rsp)>;
+
+//等待回复的请求表
+class RpcManager
+{
+public:
+    RpcManager();
+    ~RpcManager() = default;
+    RpcManager(RpcManager &&) = delete;
+    RpcManager(const RpcManager &) = delete;
+    RpcManager &operator=(RpcManager &&) = delete;
+    RpcManager &operator=(const RpcManager &) = delete;
+
+    //登记一个等待回复的请求,返回写入请求中的关联id
+    //connection_id为请求写入的连接,只接受从该连接收到的回复
+    uint64_t AddPendingCall(const std::string &type, uint32_t timeout_ms, const std::string &connection_id, RpcCallback<google::protobuf::Message> cb);
+    template <typename T>
+    uint64_t AddPendingCall(const std::string &type, uint32_t timeout_ms, const std::string &connection_id, RpcCallback<T> cb)
+    {
+        return AddPendingCall(type, timeout_ms, connection_id, [cb](int ret, const std::shared_ptr<google::protobuf::Message> &rsp)
+                              {
+                                  std::shared_ptr<T> typed_rsp = std::dynamic_pointer_cast<T>(rsp);
+                                  if (kRpc_Success == ret && nullptr == typed_rsp)
+                                  {
+                                      ret = kRpc_WrongType;
+                                  }
+                                  cb(ret, typed_rsp); });
+    }
+    //delay_ms后在超时检测线程中执行cb
+    void AddTimer(uint32_t delay_ms, std::function<void()> cb);
+    //请求发送失败时撤销,不调用回调
+    void CancelPendingCall(uint64_t correlation_id);
+    //收到回复时调用,有对应的请求时执行回调并返回true
+    //请求已超时或撤销的回复、来自其他连接的回复直接丢弃并返回true,不再交给消息处理函数
+    bool OnResponse(const MsgData &msg);
+    size_t pending_size();
+
+    void ThreadStart();
+    void ThreadWork();
+    void ThreadStop();
+
+private:
+    struct PendingCall
+    {
+        std::string type;
+        std::string connection_id;
+        RpcCallback<google::protobuf::Message> cb;
+        std::chrono::steady_clock::time_point start;
+        std::multimap<std::chrono::steady_clock::time_point, uint64_t>::iterator deadline;
+    };
+
+    std::atomic<uint64_t> next_id_;
+    std::mutex calls_mutex_;
+    std::condition_variable calls_condition_;
+    std::unordered_map<uint64_t, PendingCall> calls_;
+    std::multimap<std::chrono::steady_clock::time_point, uint64_t> deadlines_;
+
+    std::thread timer_thread_;
+    bool continue_runing_;
+};
+
+//生成一个回调及与之关联的future
+template <typename T>
+RpcCallback<T> MakeRpcPromise(std::future<RpcResult<T>> &out_future)
+{
+    auto promise = std::make_shared<std::promise<RpcResult<T>>>();
+    out_future = promise->get_future();
+    return [promise](int ret, const std::shared_ptr<T> &rsp)
+    {
+        promise->set_value(RpcResult<T>{ret, rsp});
+    };
+}
+
+#endif
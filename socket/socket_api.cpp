@@ -1,4 +1,6 @@
 #include "socket_api.h"
+#include "admission_control.h"
+#include "msg_metrics.h"
 #include "common/config.h"
 #include "common/logging.h"
 #include <endian.h>
@@ -6,6 +8,18 @@
 #include <zlib.h>
 #include "utils/net_utils.h"
 
+static const uint32_t kMaxSlowDownTime = 10 * 1000;
+
+static int HandlerSlowDownReq(const std::shared_ptr<SlowDownReq> &req, std::shared_ptr<SocketConnection> connection)
+{
+    if (nullptr == connection)
+    {
+        return -1;
+    }
+    connection->SlowDown(std::min(req->delay(), kMaxSlowDownTime));
+    return 0;
+}
+
 int SocketInit()
 {
     auto conf = Singleton<Config>::instance();
@@ -22,8 +36,22 @@ int SocketInit()
     {
         return ret - 20000;
     }
+    auto admission = Singleton<AdmissionControl>::instance();
+    admission->SetQueueLimit(conf->admission_queue_soft_limit(), conf->admission_queue_hard_limit());
+    admission->SetMemoryLimit(conf->admission_memory_soft_limit(), conf->admission_memory_hard_limit());
+    socket_manager->SetAdmissionPolicy(conf->admission_pause_num(), conf->slow_down_time());
+    socket_manager->set_reactor_cpus(conf->reactor_cpus());
     socket_manager->ThreadStart();
-    Singleton<ProtobufProcess>::instance()->ThreadStart(conf->work_thread_num());
+    Singleton<RpcManager>::instance()->ThreadStart();
+    RegisterCallback<SlowDownReq>(HandlerSlowDownReq, kExecution_Inline);
+    auto protobuf_process = Singleton<ProtobufProcess>::instance();
+    std::array<uint32_t, kPriorityBand_Count> weights;
+    weights[kPriorityBand_Low] = conf->schedule_weight_low();
+    weights[kPriorityBand_Middle] = conf->schedule_weight_middle();
+    weights[kPriorityBand_High] = conf->schedule_weight_high();
+    protobuf_process->SetSchedulePolicy(weights, conf->schedule_aging_time());
+    protobuf_process->set_inline_budget(conf->inline_cpu_budget());
+    protobuf_process->ThreadStart();
     return 0;
 }
 
@@ -31,6 +59,7 @@ void SocketDestory()
 {
     Singleton<SocketManager>::instance()->ThreadStop();
     Singleton<ProtobufProcess>::instance()->ThreadStop();
+    Singleton<RpcManager>::instance()->ThreadStop();
 }
 
 static bool ZlibCompressor(const std::string &bytes, std::string &out)
@@ -65,6 +94,16 @@ static bool ZlibUnCompressor(const std::string &bytes, std::string &out)
 
 int Bytes2Proto(const std::string &bytes, Priority &priority, std::shared_ptr<google::protobuf::Message> &out_msg)
 {
+    MsgData msg;
+    auto ret = Bytes2Proto(bytes, msg);
+    priority = msg.priority;
+    out_msg = msg.msg;
+    return ret;
+}
+
+int Bytes2Proto(const std::string &bytes, MsgData &out_msg)
+{
+    Priority &priority = out_msg.priority;
     uint32_t length = 0;
     int pos = sizeof(length);
     if (bytes.size() < pos)
@@ -128,20 +167,30 @@ int Bytes2Proto(const std::string &bytes, Priority &priority, std::shared_ptr<go
         }
         sub_data = common_msg.data();
     }
-    out_msg.reset(proto->New());
-    if (!out_msg->ParseFromString(sub_data))
+    out_msg.msg.reset(proto->New());
+    if (!out_msg.msg->ParseFromString(sub_data))
     {
         return -7;
     }
+    out_msg.correlation_id = common_msg.correlation_id();
+    out_msg.is_response = common_msg.is_response();
     return sizeof(length) + length;
 }
 
 void Proto2Bytes(const std::string &msg_byte, const std::string &type, Priority priority, Compress compress, Encrypt encrypt, std::string &out_bytes)
+{
+    Proto2Bytes(msg_byte, type, priority, compress, encrypt, 0, false, out_bytes);
+}
+
+void Proto2Bytes(const std::string &msg_byte, const std::string &type, Priority priority, Compress compress, Encrypt encrypt,
+                 uint64_t correlation_id, bool is_response, std::string &out_bytes)
 {
     CommonMsg common_msg;
     common_msg.set_version(g_msg_version);
     common_msg.set_type(type);
     common_msg.set_encrypt(encrypt);
+    common_msg.set_correlation_id(correlation_id);
+    common_msg.set_is_response(is_response);
     std::string comp_data;
     if (Compress::kCompress_True == common_msg.compress() && ZlibCompressor(msg_byte, comp_data) && comp_data.size() < msg_byte.size())
     {
@@ -172,6 +221,12 @@ void Proto2Bytes(const std::string &msg_byte, const std::string &type, Priority
     out_bytes.append((char *)&end, sizeof(end));
 }
 int WriteMessage(std::shared_ptr<SocketConnection> connection, const std::string &msg_byte, const std::string &type, Priority priority, Compress compress, Encrypt encrypt)
+{
+    return WriteMessage(connection, msg_byte, type, priority, compress, encrypt, 0, false);
+}
+
+int WriteMessage(std::shared_ptr<SocketConnection> connection, const std::string &msg_byte, const std::string &type, Priority priority, Compress compress, Encrypt encrypt,
+                 uint64_t correlation_id, bool is_response)
 {
     if (nullptr == connection)
     {
@@ -181,12 +236,61 @@ int WriteMessage(std::shared_ptr<SocketConnection> connection, const std::string
     {
         return -2;
     }
+    if (kPriorityBand_Low == GetPriorityBand(priority) && connection->IsSlowDown())
+    {
+        return -3;
+    }
     std::string msg;
-    Proto2Bytes(msg_byte, type, priority, compress, encrypt, msg);
+    Proto2Bytes(msg_byte, type, priority, compress, encrypt, correlation_id, is_response, msg);
     auto ret = connection->WriteMsg(msg);
     if(ret < 0)
     {
         return ret - 100;
     }
+    Singleton<MsgMetrics>::instance()->RecordBytesOut(type, msg.size());
     return ret;
 }
+
+int ReplyMessage(std::shared_ptr<SocketConnection> connection, const std::string &msg_byte, const std::string &type, Priority priority, Compress compress, Encrypt encrypt)
+{
+    const MsgData *current = ProtobufProcess::current_msg();
+    uint64_t correlation_id = (nullptr == current || current->is_response) ? 0 : current->correlation_id;
+    return WriteMessage(connection, msg_byte, type, priority, compress, encrypt, correlation_id, 0 != correlation_id);
+}
+
+void BroadcastMessage(const std::vector<std::shared_ptr<SocketConnection>> &connections, const std::string &msg_byte, const std::string &type,
+                      Priority priority, std::vector<int> &out_results, Compress compress, Encrypt encrypt)
+{
+    out_results.assign(connections.size(), kWrite_Success);
+    bool is_low = kPriorityBand_Low == GetPriorityBand(priority);
+    std::shared_ptr<std::string> frame;
+    size_t write_num = 0;
+    for (size_t i = 0; i < connections.size(); ++i)
+    {
+        auto &connection = connections.at(i);
+        if (nullptr == connection || !connection->IsConnected())
+        {
+            out_results.at(i) = kWrite_Disconnected;
+            continue;
+        }
+        if (is_low && connection->IsSlowDown())
+        {
+            out_results.at(i) = kWrite_SlowDown;
+            continue;
+        }
+        if (nullptr == frame)
+        {
+            frame = std::make_shared<std::string>();
+            Proto2Bytes(msg_byte, type, priority, compress, encrypt, *frame);
+        }
+        out_results.at(i) = connection->WriteFrame(frame);
+        if (kWrite_Success == out_results.at(i))
+        {
+            ++write_num;
+        }
+    }
+    if (0 != write_num)
+    {
+        Singleton<MsgMetrics>::instance()->RecordBytesOut(type, frame->size() * write_num, write_num);
+    }
+}
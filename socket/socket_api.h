@@ -5,6 +5,7 @@
 #include "define.h"
 #include "proto/common.pb.h"
 #include "protobuf_process.h"
+#include "rpc.h"
 #include "socket_manager.h"
 #include "utils/singleton.hpp"
 #include <google/protobuf/message.h>
@@ -13,10 +14,16 @@ int SocketInit();
 void SocketDestory();
 
 int Bytes2Proto(const std::string &bytes, Priority &priority, std::shared_ptr<google::protobuf::Message> &out_msg);
+//同时解析出关联id
+int Bytes2Proto(const std::string &bytes, MsgData &out_msg);
 
 void Proto2Bytes(const std::string &msg_byte, const std::string &type, Priority priority, Compress compress, Encrypt encrypt, std::string &out_bytes);
+void Proto2Bytes(const std::string &msg_byte, const std::string &type, Priority priority, Compress compress, Encrypt encrypt,
+                 uint64_t correlation_id, bool is_response, std::string &out_bytes);
 
 int WriteMessage(std::shared_ptr<SocketConnection> connection, const std::string &msg_byte, const std::string &type, Priority priority, Compress compress = Compress::kCompress_True, Encrypt encrypt = Encrypt::kEncrypt_Unencrypted);
+int WriteMessage(std::shared_ptr<SocketConnection> connection, const std::string &msg_byte, const std::string &type, Priority priority, Compress compress, Encrypt encrypt,
+                 uint64_t correlation_id, bool is_response);
 
 template <typename T>
 int WriteMessage(std::shared_ptr<SocketConnection> connection, T msg, Priority priority, Compress compress = Compress::kCompress_True, Encrypt encrypt = Encrypt::kEncrypt_Unencrypted)
@@ -24,10 +31,94 @@ int WriteMessage(std::shared_ptr<SocketConnection> connection, T msg, Priority p
     return WriteMessage(connection, msg.SerializeAsString(), msg.GetDescriptor()->name(), priority, compress, encrypt);
 }
 
+//同一条消息发给多个连接,只编码一次,各连接共享同一块数据
+//out_results与connections一一对应,为各连接的WriteResult
+void BroadcastMessage(const std::vector<std::shared_ptr<SocketConnection>> &connections, const std::string &msg_byte, const std::string &type,
+                      Priority priority, std::vector<int> &out_results, Compress compress = Compress::kCompress_True, Encrypt encrypt = Encrypt::kEncrypt_Unencrypted);
+
+template <typename T>
+void BroadcastMessage(const std::vector<std::shared_ptr<SocketConnection>> &connections, const T &msg, Priority priority, std::vector<int> &out_results,
+                      Compress compress = Compress::kCompress_True, Encrypt encrypt = Encrypt::kEncrypt_Unencrypted)
+{
+    BroadcastMessage(connections, msg.SerializeAsString(), msg.GetDescriptor()->name(), priority, out_results, compress, encrypt);
+}
+
+//回复当前正在处理的请求,请求方据此匹配等待中的调用
+int ReplyMessage(std::shared_ptr<SocketConnection> connection, const std::string &msg_byte, const std::string &type, Priority priority,
+                 Compress compress = Compress::kCompress_True, Encrypt encrypt = Encrypt::kEncrypt_Unencrypted);
+
+template <typename T>
+int ReplyMessage(std::shared_ptr<SocketConnection> connection, const T &msg, Priority priority, Compress compress = Compress::kCompress_True, Encrypt encrypt = Encrypt::kEncrypt_Unencrypted)
+{
+    return ReplyMessage(connection, msg.SerializeAsString(), msg.GetDescriptor()->name(), priority, compress, encrypt);
+}
+
+//发送已编码的type类型请求并等待Rsp类型的回复,返回值小于0时请求未发出且不会调用回调
+template <typename Rsp>
+int CallMessage(std::shared_ptr<SocketConnection> connection, const std::string &msg_byte, const std::string &type, Priority priority, uint32_t timeout_ms, RpcCallback<Rsp> cb)
+{
+    if (nullptr == connection)
+    {
+        return -1;
+    }
+    auto rpc = Singleton<RpcManager>::instance();
+    uint64_t correlation_id = rpc->AddPendingCall<Rsp>(type, timeout_ms, connection->connection_id(), cb);
+    auto ret = WriteMessage(connection, msg_byte, type, priority, Compress::kCompress_True, Encrypt::kEncrypt_Unencrypted, correlation_id, false);
+    if (ret < 0)
+    {
+        rpc->CancelPendingCall(correlation_id);
+        return ret;
+    }
+    return 0;
+}
+
+//发送请求并等待Rsp类型的回复,返回值小于0时请求未发出且不会调用回调
+template <typename Rsp, typename Req>
+int CallMessage(std::shared_ptr<SocketConnection> connection, const Req &req, Priority priority, uint32_t timeout_ms, RpcCallback<Rsp> cb)
+{
+    return CallMessage<Rsp>(connection, req.SerializeAsString(), req.GetDescriptor()->name(), priority, timeout_ms, cb);
+}
+
+template <typename Rsp, typename Req>
+std::future<RpcResult<Rsp>> CallMessage(std::shared_ptr<SocketConnection> connection, const Req &req, Priority priority, uint32_t timeout_ms)
+{
+    std::future<RpcResult<Rsp>> future;
+    auto cb = MakeRpcPromise<Rsp>(future);
+    auto ret = CallMessage<Rsp>(connection, req, priority, timeout_ms, cb);
+    if (ret < 0)
+    {
+        cb(ret, nullptr);
+    }
+    return future;
+}
+
+//在协程处理函数中co_await,等待回复期间不占用线程
+template <typename Rsp, typename Req>
+RpcAwaiter<Rsp> CallMessageAsync(std::shared_ptr<SocketConnection> connection, const Req &req, Priority priority, uint32_t timeout_ms)
+{
+    return RpcAwaiter<Rsp>([connection, req, priority, timeout_ms](RpcCallback<Rsp> cb)
+                           { return CallMessage<Rsp>(connection, req, priority, timeout_ms, cb); });
+}
+
+template <typename T>
+void RegisterCallback(std::function<int(const std::shared_ptr<T> &msg, std::shared_ptr<SocketConnection> connection)> cb,
+                      ExecutionClass execution = kExecution_Bulk)
+{
+    Singleton<ProtobufProcess>::instance()->RegisterCallback<T>(cb, execution);
+}
+
+template <typename T>
+void RegisterCallback(std::function<Task(std::shared_ptr<T> msg, std::shared_ptr<SocketConnection> connection)> cb,
+                      ExecutionClass execution = kExecution_Bulk)
+{
+    Singleton<ProtobufProcess>::instance()->RegisterCallback<T>(cb, execution);
+}
+
+//设置该类型消息的有效期,排队超过有效期的消息不再处理
 template <typename T>
-void RegisterCallback(std::function<int(const std::shared_ptr<T> &msg, std::shared_ptr<SocketConnection> connection)> cb)
+void SetMsgTimeToLive(uint32_t ttl_ms)
 {
-    Singleton<ProtobufProcess>::instance()->RegisterCallback<T>(cb);
+    Singleton<ProtobufProcess>::instance()->SetTimeToLive<T>(ttl_ms);
 }
 
 #endif
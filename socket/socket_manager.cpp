@@ -1,16 +1,33 @@
 #include "socket/socket_manager.h"
 #include "common/logging.h"
+#include "socket/admission_control.h"
 #include "socket/connection_netv4.h"
 #include "socket/connection_unix_domain.h"
 #include "socket/listen_netv4.h"
 #include "socket/listen_unix_domain.h"
+#include "socket/msg_metrics.h"
 #include "socket/socket_api.h"
 #include "utils/net_utils.h"
+#include "utils/thread_utils.h"
+#include <algorithm>
 #include <bitset>
+#include <event2/thread.h>
 #include <random>
 #include <string.h>
 #include <unistd.h>
 
+static const struct timeval kAdmissionInterval = {0, 100 * 1000};
+
+static int64_t SteadyNowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void ReleaseFrame(const void *data, size_t datalen, void *extra)
+{
+    delete (std::shared_ptr<const std::string> *)extra;
+}
+
 static void MakeRandId(std::string &id)
 {
     std::bitset<160> bit;
@@ -70,6 +87,14 @@ SocketConnection::SocketConnection()
     is_connected_ = false;
     fd_ = -1;
     buffer_event_ = nullptr;
+    last_received_time_ = time(nullptr);
+    slow_down_until_ = 0;
+    window_recv_bytes_ = 0;
+    window_rejected_ = 0;
+    read_paused_ = false;
+    write_queue_bytes_ = 0;
+    flush_pending_ = false;
+    output_bytes_ = 0;
     MakeRandId(connection_id_);
 }
 
@@ -87,7 +112,7 @@ int SocketConnection::Init(event_base *eventbase, evutil_socket_t fd)
     {
         return -1;
     }
-    bufferevent_setcb(buffer_event_, &SocketManager::read_callback, nullptr,
+    bufferevent_setcb(buffer_event_, &SocketManager::read_callback, &SocketManager::write_callback,
                       &SocketManager::event_callback, &connection_id_);
     bufferevent_enable(buffer_event_, EV_READ | EV_WRITE);
     if (-1 != fd)
@@ -109,59 +134,74 @@ void SocketConnection::Destroy()
     is_connected_ = false;
 }
 
+void SocketConnection::SlowDown(uint32_t delay_ms)
+{
+    slow_down_until_ = SteadyNowMs() + delay_ms;
+}
+
+bool SocketConnection::IsSlowDown()
+{
+    return SteadyNowMs() < slow_down_until_.load();
+}
+
 int SocketConnection::WriteMsg(const std::string &bytes_msg)
 {
-    if (!is_connected_)
-    {
-        return -1;
-    }
-    {
-        std::lock_guard<std::mutex> lck(write_mutex_);
-        write_data_ += bytes_msg;
-    }
-    auto ret = WriteData();
-    if (ret < 0)
-    {
-        return ret - 10;
-    }
-    return 0;
+    return WriteFrame(std::make_shared<const std::string>(bytes_msg));
 }
 
 int SocketConnection::WriteMsg(const std::vector<std::string> &bytes_msgs)
 {
-    if (!is_connected_)
-    {
-        return -1;
-    }
     std::string data;
     for (auto &msg : bytes_msgs)
     {
         data += msg;
     }
+    return WriteFrame(std::make_shared<const std::string>(std::move(data)));
+}
+
+int SocketConnection::WriteFrame(const std::shared_ptr<const std::string> &frame)
+{
+    if (!is_connected_)
     {
-        std::lock_guard<std::mutex> lck(write_mutex_);
-        write_data_ += data;
+        return kWrite_Disconnected;
     }
-    auto ret = WriteData();
-    if (ret < 0)
     {
-        return ret - 10;
+        std::lock_guard<std::mutex> lck(write_mutex_);
+        //单个超过上限的消息在没有积压时仍然发送
+        size_t pending = write_queue_bytes_ + output_bytes_;
+        if (0 != pending && pending + frame->size() > kMaxWriteBufferBytes)
+        {
+            return kWrite_Backpressure;
+        }
+        write_queue_.push_back(frame);
+        write_queue_bytes_ += frame->size();
+        if (flush_pending_)
+        {
+            return kWrite_Success;
+        }
+        flush_pending_ = true;
     }
-    return 0;
+    Singleton<SocketManager>::instance()->ScheduleFlush(shared_from_this());
+    return kWrite_Success;
+}
+
+size_t SocketConnection::pending_write_bytes()
+{
+    std::lock_guard<std::mutex> lck(write_mutex_);
+    return write_queue_bytes_ + output_bytes_;
 }
 
-int SocketConnection::ReadData(const std::string &data, std::vector<std::pair<std::shared_ptr<google::protobuf::Message>, Priority>> &msgs)
+int SocketConnection::ReadData(const std::string &data, std::vector<MsgData> &msgs)
 {
     std::lock_guard<std::mutex> lck(read_mutex_);
     int ret = 0;
     read_data_ += data;
-    Priority priority;
-    std::shared_ptr<google::protobuf::Message> msg;
+    auto metrics = Singleton<MsgMetrics>::instance();
+    MsgData msg;
     do
     {
-        priority = Priority::kPriority_Low_0;
-        msg.reset();
-        ret = Bytes2Proto(read_data_, priority, msg);
+        msg.Clear();
+        ret = Bytes2Proto(read_data_, msg);
         if (ret < 0)
         {
             if (read_data_.size() > sizeof(uint32_t))
@@ -186,7 +226,8 @@ int SocketConnection::ReadData(const std::string &data, std::vector<std::pair<st
         else if (ret > 0)
         {
             read_data_.erase(0, ret);
-            msgs.push_back(std::make_pair(msg, priority));
+            metrics->RecordBytesIn(msg.msg->GetDescriptor()->name(), ret);
+            msgs.push_back(msg);
         }
 
     } while (0 != ret);
@@ -199,31 +240,69 @@ int SocketConnection::ReadData(const std::string &data, std::vector<std::pair<st
     return 0;
 }
 
-int SocketConnection::WriteData()
+void SocketConnection::FlushWrite()
 {
-    if (!is_connected_)
+    std::deque<std::shared_ptr<const std::string>> frames;
     {
-        return -1;
+        std::lock_guard<std::mutex> lck(write_mutex_);
+        frames.swap(write_queue_);
+        write_queue_bytes_ = 0;
+        flush_pending_ = false;
     }
-    std::lock_guard<std::mutex> lck(write_mutex_);
-    int ret = bufferevent_write(buffer_event_, write_data_.c_str(), write_data_.size());
-    if (0 != ret)
+    if (!is_connected_ || nullptr == buffer_event_)
     {
-        return -2;
+        return;
     }
-    std::string().swap(write_data_);
-    return 0;
+    evbuffer *output = bufferevent_get_output(buffer_event_);
+    for (auto &frame : frames)
+    {
+        auto ref = new std::shared_ptr<const std::string>(frame);
+        if (0 != evbuffer_add_reference(output, frame->data(), frame->size(), &ReleaseFrame, ref))
+        {
+            delete ref;
+            ERRORLOG("write {} bytes to connection {} failed", frame->size(), connection_id_);
+            break;
+        }
+    }
+    output_bytes_ = evbuffer_get_length(output);
+}
+
+void SocketConnection::PauseRead()
+{
+    if (read_paused_ || nullptr == buffer_event_)
+    {
+        return;
+    }
+    bufferevent_disable(buffer_event_, EV_READ);
+    read_paused_ = true;
+}
+
+void SocketConnection::ResumeRead()
+{
+    if (!read_paused_ || nullptr == buffer_event_)
+    {
+        return;
+    }
+    bufferevent_enable(buffer_event_, EV_READ);
+    read_paused_ = false;
 }
 
 SocketManager::SocketManager()
 {
     disconnect_callback_ = nullptr;
+    admission_event_ = nullptr;
+    pause_num_ = 2;
+    slow_down_time_ = 1000;
+    flush_event_ = nullptr;
     event_base_ = nullptr;
+    //其他线程通过event_active通知网络线程发送数据
+    evthread_use_pthreads();
     event_base_ = event_base_new();
     if (nullptr == event_base_)
     {
         return;
     }
+    flush_event_ = event_new(event_base_, -1, 0, &SocketManager::flush_callback, this);
     event_set_log_callback(
         [](int severity, const char *msg)
         {
@@ -260,6 +339,16 @@ SocketManager::SocketManager()
 
 SocketManager::~SocketManager()
 {
+    if (nullptr != flush_event_)
+    {
+        event_free(flush_event_);
+    }
+    flush_event_ = nullptr;
+    if (nullptr != admission_event_)
+    {
+        event_free(admission_event_);
+    }
+    admission_event_ = nullptr;
     if (nullptr != event_base_)
     {
         event_base_free(event_base_);
@@ -279,8 +368,37 @@ std::shared_ptr<SocketConnection> SocketManager::GetConnection(const std::string
     return it->second;
 }
 
+void SocketManager::ScheduleFlush(std::shared_ptr<SocketConnection> connection)
+{
+    if (nullptr == flush_event_)
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex_);
+        flush_connections_.push_back(connection);
+        //已通知过的网络线程会一起处理
+        if (flush_connections_.size() > 1)
+        {
+            return;
+        }
+    }
+    event_active(flush_event_, EV_WRITE, 0);
+}
+
+void SocketManager::SetAdmissionPolicy(uint32_t pause_num, uint32_t slow_down_time_ms)
+{
+    pause_num_ = pause_num;
+    slow_down_time_ = slow_down_time_ms;
+}
+
 void SocketManager::ThreadStart()
 {
+    if (nullptr != event_base_ && nullptr == admission_event_)
+    {
+        admission_event_ = event_new(event_base_, -1, EV_PERSIST, &SocketManager::admission_callback, this);
+        event_add(admission_event_, &kAdmissionInterval);
+    }
     event_thread_ = std::thread(std::bind(&SocketManager::ThreadWork, this));
     event_thread_.detach();
 
@@ -320,6 +438,10 @@ void SocketManager::ThreadStart()
 
 void SocketManager::ThreadWork()
 {
+    if (!reactor_cpus_.empty() && !SetThreadAffinity(pthread_self(), reactor_cpus_))
+    {
+        WARNLOG("set reactor cpu affinity {} failed", reactor_cpus_);
+    }
     event_base_dispatch(event_base_);
 }
 
@@ -540,16 +662,17 @@ void SocketManager::read_callback(bufferevent *bufevent, void *ptr)
     {
         return;
     }
-    MsgData msg;
     std::string * connection_id = (std::string *)ptr;
-    msg.connection = Singleton<SocketManager>::instance()->FindConnectionById(*connection_id);
-    if (nullptr == msg.connection)
+    auto connection = Singleton<SocketManager>::instance()->FindConnectionById(*connection_id);
+    if (nullptr == connection)
     {
         Singleton<SocketManager>::instance()->DeleteConnection(*connection_id);
         return;
     }
-    std::vector<std::pair<std::shared_ptr<google::protobuf::Message>, Priority>> msgs;
-    if (0 != msg.connection->ReadData(std::string(buf, size), msgs))
+    connection->last_received_time_ = time(nullptr);
+    connection->window_recv_bytes_ += size;
+    std::vector<MsgData> msgs;
+    if (0 != connection->ReadData(std::string(buf, size), msgs))
     {
         return;
     }
@@ -557,11 +680,48 @@ void SocketManager::read_callback(bufferevent *bufevent, void *ptr)
     {
         return;
     }
-    for (auto &item : msgs)
+    auto recv_time = std::chrono::steady_clock::now();
+    auto admission = Singleton<AdmissionControl>::instance();
+    auto protobuf_process = Singleton<ProtobufProcess>::instance();
+    protobuf_process->BeginInlineBudget();
+    for (auto &msg : msgs)
+    {
+        if (!admission->Admit(msg.msg->GetDescriptor()->name(), msg.priority, msg.is_response))
+        {
+            ++connection->window_rejected_;
+            continue;
+        }
+        msg.connection = connection;
+        msg.recv_time = recv_time;
+        protobuf_process->AddProcessData(msg);
+    }
+    protobuf_process->EndInlineBudget();
+}
+
+void SocketManager::write_callback(bufferevent *bufevent, void *ptr)
+{
+    if (nullptr == bufevent || nullptr == ptr)
+    {
+        return;
+    }
+    auto connection = Singleton<SocketManager>::instance()->FindConnectionById(*(std::string *)ptr);
+    if (nullptr != connection)
     {
-        msg.msg = item.first;
-        msg.priority = item.second;
-        Singleton<ProtobufProcess>::instance()->AddProcessData(msg);
+        connection->output_bytes_ = evbuffer_get_length(bufferevent_get_output(bufevent));
+    }
+}
+
+void SocketManager::flush_callback(evutil_socket_t fd, short events, void *ptr)
+{
+    SocketManager *manager = (SocketManager *)ptr;
+    std::vector<std::shared_ptr<SocketConnection>> connections;
+    {
+        std::lock_guard<std::mutex> lock(manager->flush_mutex_);
+        connections.swap(manager->flush_connections_);
+    }
+    for (auto &connection : connections)
+    {
+        connection->FlushWrite();
     }
 }
 
@@ -606,3 +766,76 @@ void SocketManager::event_callback(bufferevent *bufevent, short events, void *pt
         }
     }
 }
+
+void SocketManager::admission_callback(evutil_socket_t fd, short events, void *ptr)
+{
+    SocketManager *manager = (SocketManager *)ptr;
+    auto admission = Singleton<AdmissionControl>::instance();
+    AdmissionLevel level = admission->Update();
+
+    std::vector<std::shared_ptr<SocketConnection>> connections;
+    {
+        std::lock_guard<std::mutex> lock(manager->connections_mutex_);
+        for (auto &item : manager->connections_)
+        {
+            if (nullptr != item.second && item.second->IsConnected())
+            {
+                connections.push_back(item.second);
+            }
+        }
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    auto slow_down_interval = std::chrono::milliseconds(manager->slow_down_time_ / 2);
+    std::vector<std::shared_ptr<SocketConnection>> candidates;
+    uint32_t paused_num = 0;
+    for (auto &connection : connections)
+    {
+        //拒绝过该连接的消息时通知对端减速
+        if (0 != connection->window_rejected_ && now - connection->last_slow_down_time_ >= slow_down_interval)
+        {
+            SlowDownReq req;
+            req.set_delay(manager->slow_down_time_);
+            WriteMessage(connection, req, Priority::kPriority_High_2);
+            connection->last_slow_down_time_ = now;
+            admission->AddSlowDown();
+        }
+        if (connection->read_paused_)
+        {
+            if (kAdmission_Pause == level)
+            {
+                ++paused_num;
+            }
+            else
+            {
+                INFOLOG("resume reading connection {}", connection->connection_id());
+                connection->ResumeRead();
+            }
+        }
+        else if (0 != connection->window_recv_bytes_)
+        {
+            candidates.push_back(connection);
+        }
+    }
+
+    if (kAdmission_Pause == level && paused_num < manager->pause_num_)
+    {
+        //暂停读取本周期内流量最大的连接
+        size_t pause_num = std::min<size_t>(manager->pause_num_ - paused_num, candidates.size());
+        std::partial_sort(candidates.begin(), candidates.begin() + pause_num, candidates.end(),
+                          [](const std::shared_ptr<SocketConnection> &a, const std::shared_ptr<SocketConnection> &b)
+                          { return a->window_recv_bytes_ > b->window_recv_bytes_; });
+        for (size_t i = 0; i < pause_num; ++i)
+        {
+            WARNLOG("pause reading connection {}, received {} bytes", candidates.at(i)->connection_id(), candidates.at(i)->window_recv_bytes_);
+            candidates.at(i)->PauseRead();
+            admission->AddPaused();
+        }
+    }
+
+    for (auto &connection : connections)
+    {
+        connection->window_recv_bytes_ = 0;
+        connection->window_rejected_ = 0;
+    }
+}
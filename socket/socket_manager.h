@@ -3,7 +3,11 @@
 
 #include <google/protobuf/message.h>
 #include "socket/define.h"
+#include "socket/strand.h"
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <event.h>
 #include <event2/listener.h>
 #include <functional>
@@ -35,8 +39,11 @@ protected:
 private:
 };
 
+//连接待发送的数据超过该值后拒绝新的消息
+const size_t kMaxWriteBufferBytes = 32 * 1024 * 1024;
+
 class SocketManager;
-class SocketConnection
+class SocketConnection : public std::enable_shared_from_this<SocketConnection>
 {
 public:
     SocketConnection();
@@ -50,11 +57,18 @@ public:
     void Destroy();
     int WriteMsg(const std::string &bytes_msg);
     int WriteMsg(const std::vector<std::string> &bytes_msgs);
+    //frame由网络线程以引用方式发送,同一个frame可以同时发给多个连接,返回WriteResult
+    int WriteFrame(const std::shared_ptr<const std::string> &frame);
+    //尚未发出的字节数
+    size_t pending_write_bytes();
     bool IsConnected() { return is_connected_; }
     time_t GetLastRecvIntervalTime() { return time(nullptr) - last_received_time_; }
     const std::string &connection_id() { return connection_id_; }
     DataSource data_source() { return data_source_; }
     evutil_socket_t fd() { return fd_; }
+    //对端要求减速,delay_ms内不再发送低优先级消息
+    void SlowDown(uint32_t delay_ms);
+    bool IsSlowDown();
 
 protected:
     DataSource data_source_;
@@ -64,17 +78,30 @@ protected:
 
 private:
     friend class SocketManager;
-    int ReadData(const std::string &data, std::vector<std::pair<std::shared_ptr<google::protobuf::Message>, Priority>> &msgs);
-    int WriteData();
+    int ReadData(const std::string &data, std::vector<MsgData> &msgs);
+    //在网络线程中把待发送的frame加入bufferevent
+    void FlushWrite();
+    void PauseRead();
+    void ResumeRead();
 
     time_t last_received_time_;
     std::string connection_id_;
+    std::atomic<int64_t> slow_down_until_;
+
+    //以下成员只在网络线程中访问
+    uint64_t window_recv_bytes_; //本统计周期内收到的字节数
+    uint32_t window_rejected_;   //本统计周期内被拒绝的消息数
+    bool read_paused_;
+    std::chrono::steady_clock::time_point last_slow_down_time_;
 
     std::mutex read_mutex_;
     std::string read_data_;
 
     std::mutex write_mutex_;
-    std::string write_data_;
+    std::deque<std::shared_ptr<const std::string>> write_queue_;
+    size_t write_queue_bytes_;
+    bool flush_pending_;               //已通知网络线程发送
+    std::atomic<size_t> output_bytes_; //bufferevent中尚未发出的字节数,由网络线程更新
 };
 
 class SocketManager
@@ -86,8 +113,13 @@ public:
     SocketManager(const SocketManager &) = delete;
     SocketManager &operator=(SocketManager &&) = delete;
     SocketManager &operator=(const SocketManager &) = delete;
+    void SetAdmissionPolicy(uint32_t pause_num, uint32_t slow_down_time_ms);
+    //事件循环线程绑定的cpu,需在ThreadStart之前设置
+    void set_reactor_cpus(const std::string &cpus) { reactor_cpus_ = cpus; }
     void SetDisConnectCallBack(std::function<void(const std::string &connection_id)> disconnect_callback) { disconnect_callback_ = disconnect_callback; }
     std::shared_ptr<SocketConnection> GetConnection(const std::string &connection_id);
+    //通知网络线程发送连接中排队的数据
+    void ScheduleFlush(std::shared_ptr<SocketConnection> connection);
 
     void ThreadStart();
     void ThreadWork();
@@ -117,17 +149,29 @@ private:
 
     std::thread event_thread_;
     event_base *event_base_;
+    std::string reactor_cpus_;
     std::mutex listens_mutex_;
     std::unordered_map<std::string, std::shared_ptr<SocketListen>> listens_;
     std::mutex connections_mutex_;
     std::unordered_map<std::string, std::shared_ptr<SocketConnection>> connections_;
     std::function<void(const std::string &connection_id)> disconnect_callback_;
 
+    event *flush_event_;
+    std::mutex flush_mutex_;
+    std::vector<std::shared_ptr<SocketConnection>> flush_connections_;
+
+    event *admission_event_;
+    uint32_t pause_num_;      //负载过高时同时暂停读取的连接数上限
+    uint32_t slow_down_time_; //通知对端减速的时间(毫秒)
+
     friend class SocketListen;
     friend class SocketConnection;
     static void listener_callback(struct evconnlistener *listener, evutil_socket_t fd, struct sockaddr *addr, int len, void *ptr);
     static void read_callback(bufferevent *bufevent, void *ptr);
+    static void write_callback(bufferevent *bufevent, void *ptr);
+    static void flush_callback(evutil_socket_t fd, short events, void *ptr);
     static void event_callback(bufferevent *bufevent, short events, void *ptr);
+    static void admission_callback(evutil_socket_t fd, short events, void *ptr);
 };
 
 #endif
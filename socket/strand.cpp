@@ -0,0 +1,316 @@
+#include "socket/strand.h"
+#include "socket/socket_manager.h"
+#include <algorithm>
+
+static const uint64_t kStride = 1 << 20;
+
+PriorityBand GetPriorityBand(Priority priority)
+{
+    if (priority >= Priority::kPriority_High_0)
+    {
+        return kPriorityBand_High;
+    }
+    if (priority >= Priority::kPriority_Middle_0)
+    {
+        return kPriorityBand_Middle;
+    }
+    return kPriorityBand_Low;
+}
+
+const char *PriorityBandName(PriorityBand band)
+{
+    switch (band)
+    {
+    case kPriorityBand_Low:
+        return "low";
+    case kPriorityBand_Middle:
+        return "middle";
+    case kPriorityBand_High:
+        return "high";
+    default:
+        return "unknown";
+    }
+}
+
+StrandQueue::StrandQueue()
+{
+    aging_time_ = std::chrono::milliseconds(1000);
+    virtual_time_ = 0;
+    msg_count_ = 0;
+    for (auto &band : bands_)
+    {
+        band.weight = 1;
+        band.pass = 0;
+        band.stats = ScheduleStats{};
+    }
+    SetWeight(kPriorityBand_Low, 1);
+    SetWeight(kPriorityBand_Middle, 4);
+    SetWeight(kPriorityBand_High, 16);
+}
+
+void StrandQueue::SetWeight(PriorityBand band, uint32_t weight)
+{
+    if (band >= kPriorityBand_Count)
+    {
+        return;
+    }
+    bands_[band].weight = (0 == weight) ? 1 : weight;
+    bands_[band].stats.weight = bands_[band].weight;
+}
+
+void StrandQueue::Push(const MsgData &msg)
+{
+    std::shared_ptr<Strand> strand;
+    if (nullptr == msg.connection || !msg.ordered)
+    {
+        //没有连接或不按连接排序的消息不需要保序
+        strand = std::make_shared<Strand>();
+    }
+    else
+    {
+        auto &item = strands_[msg.connection->connection_id()];
+        if (nullptr == item)
+        {
+            item = std::make_shared<Strand>();
+            item->id = msg.connection->connection_id();
+        }
+        strand = item;
+    }
+    strand->msgs.push_back(msg);
+    ++msg_count_;
+    ++bands_[GetPriorityBand(msg.priority)].stats.queued;
+    if (!strand->running && !strand->suspended && 1 == strand->msgs.size())
+    {
+        MakeReady(strand);
+    }
+}
+
+void StrandQueue::PushFront(const std::shared_ptr<Strand> &strand, const MsgData &msg)
+{
+    strand->msgs.push_front(msg);
+    ++msg_count_;
+    ++bands_[GetPriorityBand(msg.priority)].stats.queued;
+    if (strand->running)
+    {
+        //在await_suspend中就被恢复,挂起的处理函数返回后再调度
+        strand->resumed = true;
+        return;
+    }
+    strand->suspended = false;
+    MakeReady(strand);
+}
+
+bool StrandQueue::Pop(std::shared_ptr<Strand> &out_strand, MsgData &out_msg, uint64_t &out_wait_us)
+{
+    auto now = std::chrono::steady_clock::now();
+    bool aged = false;
+    int index = SelectBand(now, aged);
+    if (index < 0)
+    {
+        return false;
+    }
+    Band &band = bands_[index];
+    out_strand = band.ready.front();
+    band.ready.pop_front();
+    if (!aged)
+    {
+        virtual_time_ = band.pass;
+    }
+    //老化调度同样计入配额,之后按权重补偿其他段
+    band.pass += kStride / band.weight;
+
+    out_strand->running = true;
+    out_msg = std::move(out_strand->msgs.front());
+    out_strand->msgs.pop_front();
+    auto wait_us = std::chrono::duration_cast<std::chrono::microseconds>(now - out_msg.recv_time).count();
+    if (wait_us < 0)
+    {
+        wait_us = 0;
+    }
+    out_wait_us = wait_us;
+    --msg_count_;
+
+    ScheduleStats &stats = bands_[GetPriorityBand(out_msg.priority)].stats;
+    --stats.queued;
+    ++stats.dispatched;
+    if (aged)
+    {
+        ++stats.aged;
+    }
+    stats.total_wait_us += wait_us;
+    if ((uint64_t)wait_us > stats.max_wait_us)
+    {
+        stats.max_wait_us = wait_us;
+    }
+    return true;
+}
+
+void StrandQueue::Done(const std::shared_ptr<Strand> &strand)
+{
+    if (nullptr == strand)
+    {
+        return;
+    }
+    strand->running = false;
+    if (!strand->msgs.empty())
+    {
+        MakeReady(strand);
+        return;
+    }
+    if (!strand->id.empty())
+    {
+        auto it = strands_.find(strand->id);
+        if (strands_.end() != it && it->second == strand)
+        {
+            strands_.erase(it);
+        }
+    }
+}
+
+void StrandQueue::Suspend(const std::shared_ptr<Strand> &strand)
+{
+    if (nullptr == strand)
+    {
+        return;
+    }
+    strand->running = false;
+    if (strand->resumed)
+    {
+        strand->resumed = false;
+        MakeReady(strand);
+        return;
+    }
+    strand->suspended = true;
+}
+
+void StrandQueue::Clear()
+{
+    for (auto &band : bands_)
+    {
+        band.ready.clear();
+        band.stats.queued = 0;
+    }
+    strands_.clear();
+    msg_count_ = 0;
+}
+
+bool StrandQueue::empty() const
+{
+    for (auto &band : bands_)
+    {
+        if (!band.ready.empty())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void StrandQueue::GetStats(std::array<ScheduleStats, kPriorityBand_Count> &out_stats) const
+{
+    for (size_t i = 0; i < bands_.size(); ++i)
+    {
+        out_stats[i] = bands_[i].stats;
+    }
+}
+
+void StrandQueue::MakeReady(const std::shared_ptr<Strand> &strand)
+{
+    Band &band = bands_[GetPriorityBand(strand->msgs.front().priority)];
+    if (band.ready.empty() && band.pass < virtual_time_)
+    {
+        //空闲的段不累积配额,避免恢复后突发占满工作线程
+        band.pass = virtual_time_;
+    }
+    band.ready.push_back(strand);
+}
+
+int StrandQueue::SelectBand(std::chrono::steady_clock::time_point now, bool &aged)
+{
+    aged = false;
+    int index = -1;
+    uint64_t min_pass = UINT64_MAX;
+    for (auto &band : bands_)
+    {
+        if (!band.ready.empty())
+        {
+            min_pass = std::min(min_pass, band.pass);
+        }
+    }
+    std::chrono::steady_clock::time_point oldest;
+    for (size_t i = 0; i < bands_.size(); ++i)
+    {
+        if (bands_[i].ready.empty())
+        {
+            continue;
+        }
+        //老化最多领先加权公平调度一个步长,过载时所有消息都超时也不会退化为先进先出
+        if (bands_[i].pass >= min_pass + kStride)
+        {
+            continue;
+        }
+        auto recv_time = bands_[i].ready.front()->msgs.front().recv_time;
+        if (now - recv_time >= aging_time_ && (index < 0 || recv_time < oldest))
+        {
+            index = i;
+            oldest = recv_time;
+        }
+    }
+    if (index >= 0)
+    {
+        aged = true;
+        return index;
+    }
+    for (size_t i = 0; i < bands_.size(); ++i)
+    {
+        if (bands_[i].ready.empty())
+        {
+            continue;
+        }
+        if (index < 0 || bands_[i].pass < bands_[index].pass ||
+            (bands_[i].pass == bands_[index].pass && bands_[i].weight > bands_[index].weight))
+        {
+            index = i;
+        }
+    }
+    return index;
+}
+
+bool ConnectionOrder::Acquire(const MsgData &msg)
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    auto it = connections_.find(msg.connection->connection_id());
+    if (connections_.end() == it)
+    {
+        connections_.emplace(msg.connection->connection_id(), std::deque<MsgData>());
+        return true;
+    }
+    it->second.push_back(msg);
+    ++waiting_;
+    return false;
+}
+
+bool ConnectionOrder::Release(const std::string &connection_id, MsgData &out_msg)
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    auto it = connections_.find(connection_id);
+    if (connections_.end() == it)
+    {
+        return false;
+    }
+    if (it->second.empty())
+    {
+        connections_.erase(it);
+        return false;
+    }
+    out_msg = std::move(it->second.front());
+    it->second.pop_front();
+    --waiting_;
+    return true;
+}
+
+size_t ConnectionOrder::waiting()
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    return waiting_;
+}
@@ -0,0 +1,163 @@
+#ifndef UENC_SOCKET_STRAND_H_
+#define UENC_SOCKET_STRAND_H_
+
+#include "socket/define.h"
+#include <array>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <google/protobuf/message.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+class SocketConnection;
+struct MsgData
+{
+    Priority priority;
+    std::shared_ptr<google::protobuf::Message> msg;
+    std::shared_ptr<SocketConnection> connection;
+    std::string relay_connection_id;                 //经TransMsgReq转发时为转发的连接,此时connection为空
+    std::chrono::steady_clock::time_point recv_time; //收到消息的时间
+    std::chrono::milliseconds ttl;                   //消息的有效期,0表示永不过期
+    uint64_t correlation_id;                         //请求和回复的关联id,0表示不需要回复
+    bool is_response;
+    bool ordered;                                    //按连接的到达顺序执行,处理完成后才交出下一条消息
+    std::function<void()> closure;                   //不为空时在strand中执行该函数而不是处理msg
+
+    void Clear()
+    {
+        priority = Priority::kPriority_Low_0;
+        msg.reset();
+        connection.reset();
+        relay_connection_id.clear();
+        recv_time = std::chrono::steady_clock::now();
+        ttl = std::chrono::milliseconds::zero();
+        correlation_id = 0;
+        is_response = false;
+        ordered = false;
+        closure = nullptr;
+    }
+    MsgData()
+    {
+        Clear();
+    }
+    bool IsExpired(std::chrono::steady_clock::time_point now) const
+    {
+        return ttl > std::chrono::milliseconds::zero() && now - recv_time > ttl;
+    }
+    bool operator<(const MsgData &msg_data) const
+    {
+        return priority < msg_data.priority;
+    }
+};
+
+enum PriorityBand : uint8_t
+{
+    kPriorityBand_Low = 0,
+    kPriorityBand_Middle,
+    kPriorityBand_High,
+    kPriorityBand_Count,
+};
+
+PriorityBand GetPriorityBand(Priority priority);
+const char *PriorityBandName(PriorityBand band);
+
+//同一连接的消息按到达顺序串行执行,不同连接之间并行,不按连接排序的消息各自使用一个strand
+struct Strand
+{
+    std::string id;
+    std::deque<MsgData> msgs;
+    bool running;
+    bool suspended; //处理函数挂起,恢复前strand中的其他消息不能执行
+    bool resumed;   //挂起的处理函数返回前已被恢复
+    Strand() : running(false), suspended(false), resumed(false) {}
+};
+
+struct ScheduleStats
+{
+    uint32_t weight;        //调度权重
+    uint64_t queued;        //当前排队的消息数
+    uint64_t dispatched;    //累计调度的消息数
+    uint64_t aged;          //因等待超时被提前调度的消息数
+    uint64_t total_wait_us; //累计排队时间(从收到消息开始计算)
+    uint64_t max_wait_us;   //最长排队时间
+};
+
+//按优先级分段加权公平调度,段内按连接轮转,等待超过老化时间的消息优先调度,老化调度同样消耗段的配额且领先不超过一个步长
+//非线程安全,由调用者加锁
+class StrandQueue
+{
+public:
+    StrandQueue();
+    ~StrandQueue() = default;
+    StrandQueue(StrandQueue &&) = delete;
+    StrandQueue(const StrandQueue &) = delete;
+    StrandQueue &operator=(StrandQueue &&) = delete;
+    StrandQueue &operator=(const StrandQueue &) = delete;
+
+    void SetWeight(PriorityBand band, uint32_t weight);
+    void SetAgingTime(uint32_t aging_time_ms) { aging_time_ = std::chrono::milliseconds(aging_time_ms); }
+
+    void Push(const MsgData &msg);
+    //插入到strand的队首,用于恢复在该strand中挂起的执行
+    //挂起的处理函数还未返回时等到Suspend再调度
+    void PushFront(const std::shared_ptr<Strand> &strand, const MsgData &msg);
+    //取出下一个应调度的空闲strand的队首消息,并将该strand标记为执行中
+    bool Pop(std::shared_ptr<Strand> &out_strand, MsgData &out_msg, uint64_t &out_wait_us);
+    //消息处理完成,释放strand
+    void Done(const std::shared_ptr<Strand> &strand);
+    //处理函数挂起后返回,保留strand直到PushFront恢复执行
+    void Suspend(const std::shared_ptr<Strand> &strand);
+    void Clear();
+
+    bool empty() const;
+    size_t size() const { return msg_count_; }
+    void GetStats(std::array<ScheduleStats, kPriorityBand_Count> &out_stats) const;
+
+private:
+    struct Band
+    {
+        uint32_t weight;
+        uint64_t pass;
+        std::deque<std::shared_ptr<Strand>> ready;
+        ScheduleStats stats;
+    };
+    void MakeReady(const std::shared_ptr<Strand> &strand);
+    int SelectBand(std::chrono::steady_clock::time_point now, bool &aged);
+
+    std::chrono::milliseconds aging_time_;
+    uint64_t virtual_time_;
+    size_t msg_count_;
+    std::array<Band, kPriorityBand_Count> bands_;
+    std::unordered_map<std::string, std::shared_ptr<Strand>> strands_;
+};
+
+//同一连接的消息在所有线程池之间按到达顺序串行执行,线程池只提供线程
+//连接上有消息在排队或执行时,之后的消息在此等待,前一条处理完成后再交给各自的线程池
+//线程安全
+class ConnectionOrder
+{
+public:
+    ConnectionOrder() = default;
+    ~ConnectionOrder() = default;
+    ConnectionOrder(ConnectionOrder &&) = delete;
+    ConnectionOrder(const ConnectionOrder &) = delete;
+    ConnectionOrder &operator=(ConnectionOrder &&) = delete;
+    ConnectionOrder &operator=(const ConnectionOrder &) = delete;
+
+    //连接上没有未完成的消息时返回true,可以立即交给线程池,否则加入连接的等待队列
+    bool Acquire(const MsgData &msg);
+    //连接当前的消息已处理完成,有等待的消息时取出下一条并返回true,没有时释放连接
+    bool Release(const std::string &connection_id, MsgData &out_msg);
+    //等待中的消息数
+    size_t waiting();
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::deque<MsgData>> connections_; //有未完成消息的连接 -> 等待的消息
+    size_t waiting_ = 0;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "socket/task.h"
+#include "common/logging.h"
+#include "socket/protobuf_process.h"
+#include "socket/work_pool.h"
+#include "utils/singleton.hpp"
+
+void Task::promise_type::return_value(int ret)
+{
+    if (nullptr != on_done)
+    {
+        on_done(ret);
+    }
+}
+
+void Task::promise_type::unhandled_exception()
+{
+    ERRORLOG("{} handler throw exception", nullptr == msg.msg ? "" : msg.msg->GetDescriptor()->name());
+    if (nullptr != on_done)
+    {
+        on_done(-1);
+    }
+}
+
+Task::~Task()
+{
+    //没有开始执行的协程需要手动销毁
+    if (handle_)
+    {
+        handle_.destroy();
+    }
+}
+
+void Task::Start(const MsgData &msg, std::function<void(int)> on_done)
+{
+    if (!handle_)
+    {
+        return;
+    }
+    auto handle = handle_;
+    handle_ = nullptr;
+    handle.promise().msg = msg;
+    handle.promise().on_done = on_done;
+    handle.resume();
+}
+
+void TaskResumer::Suspend(std::coroutine_handle<Task::promise_type> handle)
+{
+    handle_ = handle;
+    pool_ = nullptr;
+    strand_.reset();
+    WorkPool::SuspendCurrent(pool_, strand_);
+}
+
+void TaskResumer::Cancel()
+{
+    if (nullptr != pool_)
+    {
+        WorkPool::CancelSuspend();
+    }
+    pool_ = nullptr;
+    strand_.reset();
+}
+
+void TaskResumer::Resume()
+{
+    auto handle = handle_;
+    auto closure = [handle]()
+    {
+        auto prev_msg = ProtobufProcess::SwapCurrentMsg(&handle.promise().msg);
+        handle.resume();
+        ProtobufProcess::SwapCurrentMsg(prev_msg);
+    };
+    if (nullptr == pool_)
+    {
+        //不在线程池中挂起的协程在当前线程中恢复
+        closure();
+        return;
+    }
+    //恢复后本对象可能已被销毁,先取出成员
+    auto pool = pool_;
+    auto strand = strand_;
+    auto priority = handle.promise().msg.priority;
+    pool_ = nullptr;
+    strand_.reset();
+    pool->Resume(strand, closure, priority);
+}
+
+void SleepFor::await_suspend(std::coroutine_handle<Task::promise_type> handle)
+{
+    resumer_.Suspend(handle);
+    Singleton<RpcManager>::instance()->AddTimer(delay_ms_, [this]()
+                                                { resumer_.Resume(); });
+}
+
+void Offload::await_suspend(std::coroutine_handle<Task::promise_type> handle)
+{
+    resumer_.Suspend(handle);
+    Singleton<ProtobufProcess>::instance()->Offload([this]()
+                                                    {
+                                                        func_();
+                                                        resumer_.Resume(); });
+}
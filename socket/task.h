@@ -0,0 +1,127 @@
+#ifndef UENC_SOCKET_TASK_H_
+#define UENC_SOCKET_TASK_H_
+
+#include "socket/rpc.h"
+#include "socket/strand.h"
+#include <coroutine>
+#include <functional>
+#include <memory>
+
+//消息处理协程挂起后返回该值,处理完成后再记录结果
+const int kHandle_Suspended = 1;
+
+//消息处理协程,co_return的值与普通消息处理函数的返回值含义相同
+//创建后不立即执行,由Start开始执行,执行完后自动销毁
+class Task
+{
+public:
+    struct promise_type
+    {
+        MsgData msg; //协程恢复执行时作为当前处理的消息
+        std::function<void(int)> on_done;
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_value(int ret);
+        void unhandled_exception();
+    };
+
+    Task() = default;
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+    ~Task();
+    Task(Task &&task) : handle_(task.handle_) { task.handle_ = nullptr; }
+    Task(const Task &) = delete;
+    Task &operator=(Task &&) = delete;
+    Task &operator=(const Task &) = delete;
+
+    void Start(const MsgData &msg, std::function<void(int)> on_done);
+
+private:
+    std::coroutine_handle<promise_type> handle_;
+};
+
+//记录协程挂起的位置,恢复时回到原来的线程池和strand中执行
+class TaskResumer
+{
+public:
+    TaskResumer() : pool_(nullptr) {}
+    ~TaskResumer() = default;
+    TaskResumer(TaskResumer &&) = delete;
+    TaskResumer(const TaskResumer &) = delete;
+    TaskResumer &operator=(TaskResumer &&) = delete;
+    TaskResumer &operator=(const TaskResumer &) = delete;
+
+    //在await_suspend中调用
+    void Suspend(std::coroutine_handle<Task::promise_type> handle);
+    //await_suspend决定不挂起时调用
+    void Cancel();
+    //可在任意线程中调用
+    void Resume();
+
+private:
+    std::coroutine_handle<Task::promise_type> handle_;
+    class WorkPool *pool_;
+    std::shared_ptr<Strand> strand_;
+};
+
+//co_await SleepFor(ms),不占用线程等待
+class SleepFor
+{
+public:
+    explicit SleepFor(uint32_t delay_ms) : delay_ms_(delay_ms) {}
+    bool await_ready() const noexcept { return 0 == delay_ms_; }
+    void await_suspend(std::coroutine_handle<Task::promise_type> handle);
+    void await_resume() const noexcept {}
+
+private:
+    uint32_t delay_ms_;
+    TaskResumer resumer_;
+};
+
+//co_await Offload(func),在阻塞操作线程池中执行func(如数据库操作),完成后回到原strand
+class Offload
+{
+public:
+    explicit Offload(std::function<void()> func) : func_(func) {}
+    bool await_ready() const noexcept { return nullptr == func_; }
+    void await_suspend(std::coroutine_handle<Task::promise_type> handle);
+    void await_resume() const noexcept {}
+
+private:
+    std::function<void()> func_;
+    TaskResumer resumer_;
+};
+
+//等待RPC回复,call发出请求并在收到回复时调用回调,返回值小于0表示请求未发出
+template <typename T>
+class RpcAwaiter
+{
+public:
+    explicit RpcAwaiter(std::function<int(RpcCallback<T>)> call) : call_(call) {}
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<Task::promise_type> handle)
+    {
+        resumer_.Suspend(handle);
+        auto ret = call_([this](int ret, const std::shared_ptr<T> &rsp)
+                         {
+                             result_.ret = ret;
+                             result_.rsp = rsp;
+                             resumer_.Resume(); });
+        if (ret < 0)
+        {
+            resumer_.Cancel();
+            result_.ret = ret;
+            return false;
+        }
+        return true;
+    }
+    RpcResult<T> await_resume() { return result_; }
+
+private:
+    std::function<int(RpcCallback<T>)> call_;
+    RpcResult<T> result_;
+    TaskResumer resumer_;
+};
+
+#endif
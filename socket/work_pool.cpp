@@ -0,0 +1,267 @@
+#include "socket/work_pool.h"
+#include "common/logging.h"
+#include "socket/msg_metrics.h"
+#include "utils/thread_utils.h"
+#include "utils/singleton.hpp"
+#include <algorithm>
+
+//线程利用率高于该值且有排队时增加线程,低于该值时减少线程
+static const double kGrowUtilization = 0.8;
+static const double kShrinkUtilization = 0.3;
+
+thread_local WorkPool *WorkPool::current_pool_ = nullptr;
+thread_local std::shared_ptr<Strand> WorkPool::current_strand_;
+thread_local bool WorkPool::current_suspended_ = false;
+
+WorkPool::WorkPool(const std::string &name, std::function<void(const MsgData &)> handler)
+    : name_(name), handler_(handler)
+{
+    thread_num_ = 0;
+    min_thread_num_ = 0;
+    max_thread_num_ = 0;
+    retire_num_ = 0;
+    queue_limit_ = 0;
+    rejected_ = 0;
+    next_worker_id_ = 0;
+    total_busy_us_ = 0;
+    last_busy_us_ = 0;
+    continue_wait_ = false;
+}
+
+void WorkPool::SetThreadRange(uint32_t min_thread_num, uint32_t max_thread_num)
+{
+    std::lock_guard<std::mutex> lck(process_mutex_);
+    min_thread_num_ = min_thread_num;
+    max_thread_num_ = std::max(min_thread_num, max_thread_num);
+}
+
+void WorkPool::SetSchedulePolicy(const std::array<uint32_t, kPriorityBand_Count> &weights, uint32_t aging_time_ms)
+{
+    std::lock_guard<std::mutex> lck(process_mutex_);
+    for (size_t i = 0; i < weights.size(); ++i)
+    {
+        process_queue_.SetWeight((PriorityBand)i, weights.at(i));
+    }
+    process_queue_.SetAgingTime(aging_time_ms);
+}
+
+void WorkPool::GetStats(WorkPoolStats &out_stats)
+{
+    std::lock_guard<std::mutex> lck(process_mutex_);
+    out_stats.name = name_;
+    out_stats.thread_num = thread_num_;
+    out_stats.min_thread_num = min_thread_num_;
+    out_stats.max_thread_num = max_thread_num_;
+    out_stats.queue_limit = queue_limit_;
+    out_stats.rejected = rejected_;
+    process_queue_.GetStats(out_stats.bands);
+    auto now = std::chrono::steady_clock::now();
+    out_stats.workers.clear();
+    for (auto &worker : workers_)
+    {
+        WorkerStats stats;
+        stats.id = worker->id;
+        stats.busy_us = worker->busy_us.load(std::memory_order_relaxed);
+        uint64_t total_us = std::chrono::duration_cast<std::chrono::microseconds>(now - worker->start).count();
+        stats.idle_us = total_us > stats.busy_us ? total_us - stats.busy_us : 0;
+        out_stats.workers.push_back(stats);
+    }
+}
+
+bool WorkPool::AddProcessData(const MsgData &msg)
+{
+    {
+        std::lock_guard<std::mutex> lck(process_mutex_);
+        if (0 != queue_limit_ && process_queue_.size() >= queue_limit_)
+        {
+            ++rejected_;
+            return false;
+        }
+        process_queue_.Push(msg);
+        if (process_queue_.empty())
+        {
+            return true;
+        }
+    }
+    process_condition_.notify_one();
+    return true;
+}
+
+void WorkPool::Post(std::function<void()> closure, Priority priority)
+{
+    MsgData msg;
+    msg.priority = priority;
+    msg.closure = closure;
+    {
+        std::lock_guard<std::mutex> lck(process_mutex_);
+        process_queue_.Push(msg);
+    }
+    process_condition_.notify_one();
+}
+
+void WorkPool::Resume(const std::shared_ptr<Strand> &strand, std::function<void()> closure, Priority priority)
+{
+    MsgData msg;
+    msg.priority = priority;
+    msg.closure = closure;
+    {
+        std::lock_guard<std::mutex> lck(process_mutex_);
+        process_queue_.PushFront(strand, msg);
+    }
+    process_condition_.notify_one();
+}
+
+bool WorkPool::SuspendCurrent(WorkPool *&out_pool, std::shared_ptr<Strand> &out_strand)
+{
+    if (nullptr == current_pool_)
+    {
+        return false;
+    }
+    current_suspended_ = true;
+    out_pool = current_pool_;
+    out_strand = current_strand_;
+    return true;
+}
+
+void WorkPool::CancelSuspend()
+{
+    current_suspended_ = false;
+}
+
+void WorkPool::ThreadStart(uint32_t thread_num)
+{
+    std::lock_guard<std::mutex> lck(process_mutex_);
+    continue_wait_ = true;
+    if (0 == min_thread_num_ && 0 == max_thread_num_)
+    {
+        min_thread_num_ = thread_num;
+        max_thread_num_ = thread_num;
+    }
+    retire_num_ = 0;
+    last_adjust_time_ = std::chrono::steady_clock::now();
+    last_busy_us_ = total_busy_us_;
+    for (size_t i = 0; i < thread_num; ++i)
+    {
+        AddThread();
+    }
+    INFOLOG("work pool {} start {} threads, max {} threads, queue limit {}", name_, thread_num_, max_thread_num_, queue_limit_);
+}
+
+void WorkPool::Adjust()
+{
+    std::lock_guard<std::mutex> lck(process_mutex_);
+    auto now = std::chrono::steady_clock::now();
+    uint64_t elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(now - last_adjust_time_).count() * thread_num_;
+    uint64_t busy_us = total_busy_us_ - last_busy_us_;
+    last_adjust_time_ = now;
+    last_busy_us_ = total_busy_us_;
+    if (!continue_wait_ || max_thread_num_ <= min_thread_num_ || 0 == elapsed_us)
+    {
+        return;
+    }
+    double utilization = (double)busy_us / elapsed_us;
+    if (utilization >= kGrowUtilization && process_queue_.size() > thread_num_ && thread_num_ < max_thread_num_)
+    {
+        AddThread();
+        INFOLOG("work pool {} grow to {} threads, utilization {:.2f}, queued {}", name_, thread_num_, utilization, process_queue_.size());
+    }
+    else if (utilization < kShrinkUtilization && thread_num_ > min_thread_num_ && 0 == retire_num_)
+    {
+        ++retire_num_;
+        process_condition_.notify_all();
+    }
+}
+
+void WorkPool::AddThread()
+{
+    auto worker = std::make_shared<Worker>();
+    worker->id = next_worker_id_++;
+    worker->busy_us = 0;
+    worker->start = std::chrono::steady_clock::now();
+    workers_.push_back(worker);
+    ++thread_num_;
+    std::thread(std::bind(&WorkPool::ThreadWork, this, worker)).detach();
+}
+
+void WorkPool::ThreadWork(std::shared_ptr<Worker> worker)
+{
+    std::string thread_name = "uenc_" + name_;
+    thread_name.resize(std::min<size_t>(thread_name.size(), 15));
+    pthread_setname_np(pthread_self(), thread_name.c_str());
+    if (!cpus_.empty() && !SetThreadAffinity(pthread_self(), cpus_))
+    {
+        WARNLOG("work pool {} set cpu affinity {} failed", name_, cpus_);
+    }
+    MsgData msg;
+    std::shared_ptr<Strand> strand;
+    uint64_t wait_us = 0;
+    auto metrics = Singleton<MsgMetrics>::instance();
+    while (continue_wait_)
+    {
+        std::unique_lock<std::mutex> process_locker(process_mutex_);
+        while (!process_queue_.Pop(strand, msg, wait_us))
+        {
+            if (!continue_wait_)
+            {
+                return;
+            }
+            if (0 != retire_num_ && thread_num_ > min_thread_num_)
+            {
+                --retire_num_;
+                --thread_num_;
+                workers_.erase(std::remove(workers_.begin(), workers_.end(), worker), workers_.end());
+                INFOLOG("work pool {} shrink to {} threads", name_, thread_num_);
+                return;
+            }
+            process_condition_.wait(process_locker);
+            if (!continue_wait_)
+            {
+                return;
+            }
+        }
+        process_locker.unlock();
+        auto start = std::chrono::steady_clock::now();
+        current_pool_ = this;
+        current_strand_ = strand;
+        current_suspended_ = false;
+        if (nullptr != msg.closure)
+        {
+            msg.closure();
+        }
+        else
+        {
+            metrics->RecordQueueWait(msg.msg->GetDescriptor()->name(), msg.priority, wait_us);
+            handler_(msg);
+        }
+        bool suspended = current_suspended_;
+        current_pool_ = nullptr;
+        current_strand_.reset();
+        current_suspended_ = false;
+        msg.Clear();
+        uint64_t busy_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        worker->busy_us.fetch_add(busy_us, std::memory_order_relaxed);
+        total_busy_us_.fetch_add(busy_us, std::memory_order_relaxed);
+        process_locker.lock();
+        if (suspended)
+        {
+            process_queue_.Suspend(strand);
+        }
+        else
+        {
+            process_queue_.Done(strand);
+        }
+        bool notify = !process_queue_.empty();
+        process_locker.unlock();
+        strand.reset();
+        if (notify)
+        {
+            process_condition_.notify_one();
+        }
+    }
+}
+
+void WorkPool::ThreadStop()
+{
+    continue_wait_ = false;
+    process_condition_.notify_all();
+}
@@ -0,0 +1,103 @@
+#ifndef UENC_SOCKET_WORK_POOL_H_
+#define UENC_SOCKET_WORK_POOL_H_
+
+#include "socket/strand.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct WorkerStats
+{
+    uint32_t id;
+    uint64_t busy_us; //处理消息的时间
+    uint64_t idle_us; //等待消息的时间
+};
+
+struct WorkPoolStats
+{
+    std::string name;
+    uint32_t thread_num;
+    uint32_t min_thread_num;
+    uint32_t max_thread_num;
+    uint32_t queue_limit;
+    uint64_t rejected; //队列已满被拒绝的消息数
+    std::array<ScheduleStats, kPriorityBand_Count> bands;
+    std::vector<WorkerStats> workers;
+};
+
+//拥有独立线程和队列的消息处理线程池
+class WorkPool
+{
+public:
+    WorkPool(const std::string &name, std::function<void(const MsgData &)> handler);
+    ~WorkPool() = default;
+    WorkPool(WorkPool &&) = delete;
+    WorkPool(const WorkPool &) = delete;
+    WorkPool &operator=(WorkPool &&) = delete;
+    WorkPool &operator=(const WorkPool &) = delete;
+
+    const std::string &name() const { return name_; }
+    void set_queue_limit(uint32_t queue_limit) { queue_limit_ = queue_limit; }
+    //线程数在[min_thread_num, max_thread_num]之间随负载变化
+    void SetThreadRange(uint32_t min_thread_num, uint32_t max_thread_num);
+    //线程绑定的cpu,需在ThreadStart之前设置
+    void set_cpus(const std::string &cpus) { cpus_ = cpus; }
+    void SetSchedulePolicy(const std::array<uint32_t, kPriorityBand_Count> &weights, uint32_t aging_time_ms);
+    void GetStats(WorkPoolStats &out_stats);
+
+    bool AddProcessData(const MsgData &msg);
+    //在新的strand中执行closure
+    void Post(std::function<void()> closure, Priority priority);
+    //在strand中继续执行挂起的处理
+    void Resume(const std::shared_ptr<Strand> &strand, std::function<void()> closure, Priority priority);
+
+    //在处理函数中调用,处理函数返回后不释放当前strand,直到Resume的函数执行完
+    static bool SuspendCurrent(WorkPool *&out_pool, std::shared_ptr<Strand> &out_strand);
+    //撤销本次SuspendCurrent
+    static void CancelSuspend();
+
+    void ThreadStart(uint32_t thread_num);
+    void ThreadStop();
+    //根据排队长度和线程利用率增减线程,由管理线程定时调用
+    void Adjust();
+
+private:
+    struct Worker
+    {
+        uint32_t id;
+        std::atomic<uint64_t> busy_us;
+        std::chrono::steady_clock::time_point start;
+    };
+    //调用者加锁
+    void AddThread();
+    void ThreadWork(std::shared_ptr<Worker> worker);
+
+    std::string name_;
+    std::function<void(const MsgData &)> handler_;
+    uint32_t thread_num_;
+    uint32_t min_thread_num_;
+    uint32_t max_thread_num_;
+    uint32_t retire_num_;  //等待退出的线程数
+    uint32_t queue_limit_; // 0表示不限制
+    uint64_t rejected_;
+    std::string cpus_;
+
+    std::vector<std::shared_ptr<Worker>> workers_;
+    uint32_t next_worker_id_;
+    std::atomic<uint64_t> total_busy_us_;
+    uint64_t last_busy_us_;
+    std::chrono::steady_clock::time_point last_adjust_time_;
+    bool continue_wait_;
+    std::mutex process_mutex_;
+    std::condition_variable process_condition_;
+    StrandQueue process_queue_;
+
+    static thread_local WorkPool *current_pool_;
+    static thread_local std::shared_ptr<Strand> current_strand_;
+    static thread_local bool current_suspended_;
+};
+
+#endif
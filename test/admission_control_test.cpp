@@ -0,0 +1,68 @@
+#include "socket/admission_control.h"
+#include <gtest/gtest.h>
+
+//进程占用的内存一定超过1MB,用内存限制触发各负载等级
+TEST(AdmissionControlTest, Normal)
+{
+    AdmissionControl admission;
+    EXPECT_EQ(kAdmission_Normal, admission.Update());
+    EXPECT_TRUE(admission.Admit("BroadcaseMsgReq", Priority::kPriority_Low_0, false));
+    EXPECT_TRUE(admission.Admit("BroadcaseMsgReq", Priority::kPriority_Middle_0, false));
+
+    admission.SetMemoryLimit(1024 * 1024, 0);
+    EXPECT_EQ(kAdmission_Normal, admission.Update());
+    AdmissionStats stats;
+    admission.GetStats(stats);
+    EXPECT_EQ(kAdmission_Normal, stats.level);
+    EXPECT_GT(stats.memory, 0);
+    EXPECT_EQ(0, stats.rejected);
+}
+
+TEST(AdmissionControlTest, Shed)
+{
+    AdmissionControl admission;
+    admission.SetMemoryLimit(1, 0);
+    EXPECT_EQ(kAdmission_Shed, admission.Update());
+    EXPECT_EQ(kAdmission_Shed, admission.level());
+    EXPECT_FALSE(admission.Admit("BroadcaseMsgReq", Priority::kPriority_Low_2, false));
+    EXPECT_TRUE(admission.Admit("BroadcaseMsgReq", Priority::kPriority_Middle_0, false));
+    EXPECT_TRUE(admission.Admit("BroadcaseMsgReq", Priority::kPriority_High_0, false));
+    //回复总是接收,否则等待中的请求只能超时
+    EXPECT_TRUE(admission.Admit("EchoAck", Priority::kPriority_Low_0, true));
+
+    AdmissionStats stats;
+    admission.GetStats(stats);
+    EXPECT_EQ(1, stats.rejected);
+}
+
+TEST(AdmissionControlTest, Pause)
+{
+    AdmissionControl admission;
+    admission.SetMemoryLimit(1, 1);
+    EXPECT_EQ(kAdmission_Pause, admission.Update());
+    EXPECT_FALSE(admission.Admit("BroadcaseMsgReq", Priority::kPriority_Low_0, false));
+    EXPECT_FALSE(admission.Admit("BroadcaseMsgReq", Priority::kPriority_Middle_2, false));
+    EXPECT_TRUE(admission.Admit("BroadcaseMsgReq", Priority::kPriority_High_0, false));
+    EXPECT_TRUE(admission.Admit("EchoAck", Priority::kPriority_Middle_0, true));
+
+    AdmissionStats stats;
+    admission.GetStats(stats);
+    EXPECT_EQ(2, stats.rejected);
+
+    //负载下降后恢复接收
+    admission.SetMemoryLimit(0, 0);
+    EXPECT_EQ(kAdmission_Normal, admission.Update());
+    EXPECT_TRUE(admission.Admit("BroadcaseMsgReq", Priority::kPriority_Low_0, false));
+}
+
+TEST(AdmissionControlTest, QueueLimit)
+{
+    AdmissionControl admission;
+    //没有待处理的消息
+    admission.SetQueueLimit(1, 2);
+    EXPECT_EQ(kAdmission_Normal, admission.Update());
+    AdmissionStats stats;
+    admission.GetStats(stats);
+    EXPECT_EQ(0, stats.queued);
+    EXPECT_EQ(0, stats.memory);
+}
@@ -0,0 +1,83 @@
+#include "common/config.h"
+#include "node/broadcast.h"
+#include "utils/singleton.hpp"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+TEST(BroadcastCacheTest, MsgId)
+{
+    std::string id = BroadcastCache::GetMsgId("node1", "data");
+    EXPECT_EQ(32, id.size());
+    EXPECT_EQ(id, BroadcastCache::GetMsgId("node1", "data"));
+    EXPECT_NE(id, BroadcastCache::GetMsgId("node2", "data"));
+    EXPECT_NE(id, BroadcastCache::GetMsgId("node1", "data2"));
+}
+
+TEST(BroadcastCacheTest, Duplicate)
+{
+    BroadcastCache cache;
+    std::string id = BroadcastCache::GetMsgId("node1", "data");
+    EXPECT_FALSE(cache.Contains(id));
+    EXPECT_TRUE(cache.Insert(id));
+    EXPECT_TRUE(cache.Contains(id));
+    EXPECT_FALSE(cache.Insert(id));
+    EXPECT_FALSE(cache.Insert(id));
+    EXPECT_EQ(1, cache.size());
+    EXPECT_EQ(2, cache.duplicate_num());
+}
+
+TEST(BroadcastCacheTest, SizeLimit)
+{
+    BroadcastCache cache;
+    for (size_t i = 0; i < kMaxBroadcastSeen + 10; ++i)
+    {
+        EXPECT_TRUE(cache.Insert(std::to_string(i)));
+    }
+    //超过上限时提前丢弃最早的
+    EXPECT_EQ(kMaxBroadcastSeen, cache.size());
+    EXPECT_FALSE(cache.Contains("0"));
+    EXPECT_FALSE(cache.Contains("9"));
+    EXPECT_TRUE(cache.Contains("10"));
+    EXPECT_TRUE(cache.Contains(std::to_string(kMaxBroadcastSeen + 9)));
+}
+
+//保留时间只能由配置文件设置
+static void SetSeenTime(uint32_t seen_time)
+{
+    auto config = Singleton<Config>::instance();
+    std::string file_name = config->file_name();
+    std::string test_file_name = "/tmp/broadcast_cache_test.json";
+    {
+        std::ofstream file(test_file_name);
+        file << "{\"broadcast_seen_time\": " << seen_time << "}";
+    }
+    config->set_file_name(test_file_name);
+    config->LoadFile();
+    config->set_file_name(file_name);
+    std::remove(test_file_name.c_str());
+}
+
+TEST(BroadcastCacheTest, Expire)
+{
+    auto config = Singleton<Config>::instance();
+    uint32_t seen_time = config->broadcast_seen_time();
+    SetSeenTime(1);
+    ASSERT_EQ(1, config->broadcast_seen_time());
+
+    BroadcastCache cache;
+    EXPECT_TRUE(cache.Insert("msg1"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    EXPECT_TRUE(cache.Insert("msg2"));
+    EXPECT_FALSE(cache.Insert("msg1"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    //过期的id在下次插入时清理,之后再收到时重新处理
+    EXPECT_TRUE(cache.Insert("msg1"));
+    EXPECT_FALSE(cache.Insert("msg2"));
+    EXPECT_EQ(2, cache.size());
+
+    SetSeenTime(seen_time);
+    EXPECT_EQ(seen_time, config->broadcast_seen_time());
+}
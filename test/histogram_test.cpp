@@ -0,0 +1,64 @@
+#include "utils/histogram.h"
+#include <gtest/gtest.h>
+
+TEST(HistogramTest, Empty)
+{
+    Histogram histogram;
+    EXPECT_EQ(0, histogram.count());
+    EXPECT_EQ(0, histogram.Percentile(50));
+    EXPECT_EQ(0, histogram.Percentile(100));
+}
+
+TEST(HistogramTest, SmallValuesExact)
+{
+    Histogram histogram;
+    for (uint64_t i = 1; i <= 8; ++i)
+    {
+        histogram.Record(i);
+    }
+    EXPECT_EQ(8, histogram.count());
+    EXPECT_EQ(36, histogram.sum());
+    EXPECT_EQ(8, histogram.max());
+    EXPECT_EQ(1, histogram.Percentile(0));
+    EXPECT_EQ(4, histogram.Percentile(50));
+    EXPECT_EQ(8, histogram.Percentile(100));
+}
+
+TEST(HistogramTest, PercentileRelativeError)
+{
+    Histogram histogram;
+    for (uint64_t i = 1; i <= 100000; ++i)
+    {
+        histogram.Record(i);
+    }
+    EXPECT_EQ(100000, histogram.max());
+    //相对误差不超过1/8,且不小于真实值
+    const double percentiles[] = {50, 90, 99, 99.9};
+    for (auto percentile : percentiles)
+    {
+        double expected = percentile / 100 * 100000;
+        double value = histogram.Percentile(percentile);
+        EXPECT_GE(value, expected) << percentile;
+        EXPECT_LE(value, expected * 9 / 8) << percentile;
+    }
+    EXPECT_EQ(100000, histogram.Percentile(100));
+    //超出范围的百分位按边界处理
+    EXPECT_EQ(histogram.Percentile(100), histogram.Percentile(200));
+    EXPECT_EQ(histogram.Percentile(0), histogram.Percentile(-1));
+}
+
+TEST(HistogramTest, LargeValuesAndClear)
+{
+    Histogram histogram;
+    histogram.Record(0);
+    histogram.Record(UINT64_MAX);
+    EXPECT_EQ(UINT64_MAX, histogram.max());
+    EXPECT_EQ(0, histogram.Percentile(50));
+    EXPECT_EQ(UINT64_MAX, histogram.Percentile(100));
+
+    histogram.Clear();
+    EXPECT_EQ(0, histogram.count());
+    EXPECT_EQ(0, histogram.sum());
+    EXPECT_EQ(0, histogram.max());
+    EXPECT_EQ(0, histogram.Percentile(99));
+}
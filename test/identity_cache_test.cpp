@@ -0,0 +1,53 @@
+#include "account/account.h"
+#include "node/identity_cache.h"
+#include <gtest/gtest.h>
+
+class IdentityCacheTest : public testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        ASSERT_EQ(0, account_.GenerateAccount());
+        ASSERT_TRUE(account_.private_key().GenerateSign(account_.base58addr(), sign_));
+    }
+
+    Account::AccountAddr account_;
+    std::string sign_;
+};
+
+TEST_F(IdentityCacheTest, Verify)
+{
+    IdentityCache cache;
+    EXPECT_EQ(0, cache.Verify(account_.public_key().bytes(), sign_, account_.base58addr()));
+    EXPECT_EQ(1, cache.size());
+    EXPECT_EQ(0, cache.hit_num());
+
+    //再次验证时直接使用缓存的结果
+    EXPECT_EQ(0, cache.Verify(account_.public_key().bytes(), sign_, account_.base58addr()));
+    EXPECT_EQ(1, cache.size());
+    EXPECT_EQ(1, cache.hit_num());
+}
+
+TEST_F(IdentityCacheTest, WrongAddress)
+{
+    Account::AccountAddr other;
+    ASSERT_EQ(0, other.GenerateAccount());
+    IdentityCache cache;
+    EXPECT_EQ(-1, cache.Verify(account_.public_key().bytes(), sign_, other.base58addr()));
+    EXPECT_EQ(0, cache.size());
+}
+
+TEST_F(IdentityCacheTest, WrongSign)
+{
+    std::string sign;
+    ASSERT_TRUE(account_.private_key().GenerateSign("other", sign));
+    IdentityCache cache;
+    //验证失败的身份不缓存
+    EXPECT_LT(cache.Verify(account_.public_key().bytes(), sign, account_.base58addr()), 0);
+    EXPECT_LT(cache.Verify(account_.public_key().bytes(), sign, account_.base58addr()), 0);
+    EXPECT_EQ(0, cache.size());
+    EXPECT_EQ(0, cache.hit_num());
+
+    EXPECT_LT(cache.Verify("invalid", sign_, account_.base58addr()), 0);
+    EXPECT_EQ(0, cache.size());
+}
@@ -0,0 +1,87 @@
+#include "node/node_id.h"
+#include "utils/interned_string.h"
+#include <gtest/gtest.h>
+#include <unordered_set>
+
+static NodeId MakeId()
+{
+    NodeId id;
+    for (size_t i = 0; i < kNodeIdSize; ++i)
+    {
+        id.bytes[i] = i + 1;
+    }
+    return id;
+}
+
+TEST(NodeIdTest, Base58)
+{
+    NodeId id = MakeId();
+    EXPECT_FALSE(id.empty());
+    std::string base58addr = id.ToBase58();
+    EXPECT_EQ("16L5yRNPTuciSgXGHqYwn9N6NeoKqopAu", base58addr);
+    NodeId parsed;
+    ASSERT_TRUE(NodeId::FromBase58(base58addr, parsed));
+    EXPECT_EQ(id, parsed);
+
+    //空id编码为空字符串
+    EXPECT_TRUE(NodeId().empty());
+    EXPECT_EQ("", NodeId().ToBase58());
+    ASSERT_TRUE(NodeId::FromBase58("1111111111111111111114oLvT2", parsed));
+    EXPECT_TRUE(parsed.empty());
+}
+
+TEST(NodeIdTest, InvalidBase58)
+{
+    NodeId id;
+    EXPECT_FALSE(NodeId::FromBase58("", id));
+    EXPECT_FALSE(NodeId::FromBase58("0OIl", id));
+    EXPECT_FALSE(NodeId::FromBase58("16L5yRNPTuciSgXGHqYwn9N6Neo", id));
+    //校验和错误
+    EXPECT_FALSE(NodeId::FromBase58("16L5yRNPTuciSgXGHqYwn9N6NeoKqopAv", id));
+    EXPECT_TRUE(id.empty());
+}
+
+TEST(NodeIdTest, Compare)
+{
+    NodeId id1 = MakeId();
+    NodeId id2 = MakeId();
+    EXPECT_EQ(id1, id2);
+    EXPECT_EQ(NodeIdHash()(id1), NodeIdHash()(id2));
+    id2.bytes[kNodeIdSize - 1] = 0;
+    EXPECT_NE(id1, id2);
+    EXPECT_TRUE(id2 < id1);
+    EXPECT_FALSE(id1 < id2);
+
+    std::unordered_set<NodeId, NodeIdHash> ids = {id1, id2, MakeId()};
+    EXPECT_EQ(2, ids.size());
+}
+
+TEST(InternedStringTest, Share)
+{
+    std::string version = "1.6.4";
+    InternedString str1(version);
+    InternedString str2(std::string("1.6.") + "4");
+    //内容相同时共享同一份数据
+    EXPECT_EQ(str1, str2);
+    EXPECT_EQ(&str1.str(), &str2.str());
+    EXPECT_EQ(version, str1.str());
+    EXPECT_NE(str1, InternedString("1.6.5"));
+
+    str2 = "1.6.5";
+    EXPECT_NE(str1, str2);
+    EXPECT_EQ("1.6.5", str2.str());
+    str2 = version;
+    EXPECT_EQ(str1, str2);
+}
+
+TEST(InternedStringTest, Empty)
+{
+    InternedString str;
+    EXPECT_TRUE(str.empty());
+    EXPECT_EQ("", str.str());
+    EXPECT_EQ(str, InternedString(""));
+    str = "1.6.4";
+    EXPECT_FALSE(str.empty());
+    const std::string &value = str;
+    EXPECT_EQ("1.6.4", value);
+}
@@ -0,0 +1,164 @@
+#include "node/node_sync.h"
+#include "node/peer_node.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+
+static std::shared_ptr<Node> MakeNode(uint32_t seq)
+{
+    auto node = std::make_shared<Node>();
+    memcpy(node->id.bytes.data(), &seq, sizeof(seq));
+    node->id.bytes[kNodeIdSize - 1] = 1;
+    node->base58addr = "node" + std::to_string(seq);
+    node->local_ip = seq;
+    node->listen_port = 11187;
+    node->public_ip = 100;
+    node->public_port = 11188;
+    return node;
+}
+
+static uint64_t Digest(const std::vector<std::shared_ptr<const Node>> &nodes)
+{
+    uint64_t digest = 0;
+    for (auto &node : nodes)
+    {
+        digest ^= NodeSync::Digest(*node);
+    }
+    return digest;
+}
+
+//将请求和追加的节点编码拼接后解析
+static void BuildSyncNodeReq(NodeSync &sync, const NodeId &peer, const std::vector<std::shared_ptr<const Node>> &subnodes, SyncNodeReq &out_req)
+{
+    SyncNodeReq req;
+    std::string nodes_bytes;
+    sync.BuildSyncNodeReq(peer, subnodes, req, nodes_bytes);
+    ASSERT_TRUE(out_req.ParseFromString(req.SerializeAsString() + nodes_bytes));
+}
+
+static std::vector<std::string> Base58addrs(const SyncNodeReq &req)
+{
+    std::vector<std::string> base58addrs;
+    for (auto &node : req.nodes())
+    {
+        base58addrs.push_back(node.base58addr());
+    }
+    std::sort(base58addrs.begin(), base58addrs.end());
+    return base58addrs;
+}
+
+TEST(NodeSyncTest, Digest)
+{
+    auto node = MakeNode(1);
+    uint64_t digest = NodeSync::Digest(*node);
+    //不参与摘要的字段
+    node->local_ip = 2;
+    node->runtime->height = 100;
+    EXPECT_EQ(digest, NodeSync::Digest(*node));
+    node->public_ip = 200;
+    EXPECT_NE(digest, NodeSync::Digest(*node));
+    EXPECT_NE(NodeSync::Digest(*MakeNode(1)), NodeSync::Digest(*MakeNode(2)));
+}
+
+TEST(NodeSyncTest, FullThenDelta)
+{
+    NodeSync sync;
+    NodeId peer = MakeNode(100)->id;
+    auto node1 = MakeNode(1);
+    auto node2 = MakeNode(2);
+    auto node3 = MakeNode(3);
+    std::vector<std::shared_ptr<const Node>> subnodes = {node1, node2, node3};
+    sync.Refresh(subnodes);
+    EXPECT_EQ(4, sync.seq());
+
+    //没有同步过时全量同步
+    SyncNodeReq req;
+    BuildSyncNodeReq(sync, peer, subnodes, req);
+    EXPECT_TRUE(req.is_full());
+    EXPECT_EQ(0, req.base_seq());
+    EXPECT_EQ(4, req.seq());
+    EXPECT_EQ(Digest(subnodes), req.digest());
+    EXPECT_EQ(3, req.nodes_size());
+    EXPECT_EQ(0, req.removed_size());
+
+    //已是最新版本
+    EXPECT_FALSE(sync.OnSyncNodeAck(peer, 4));
+    req.Clear();
+    BuildSyncNodeReq(sync, peer, subnodes, req);
+    EXPECT_FALSE(req.is_full());
+    EXPECT_EQ(4, req.base_seq());
+    EXPECT_EQ(0, req.nodes_size());
+
+    //修改node2,删除node3,新增node4
+    auto changed = std::make_shared<Node>(*node2);
+    changed->listen_port = 11190;
+    auto node4 = MakeNode(4);
+    subnodes = {node1, changed, node4};
+    sync.Refresh(subnodes);
+    EXPECT_EQ(7, sync.seq());
+    EXPECT_TRUE(sync.OnSyncNodeAck(peer, 4));
+
+    req.Clear();
+    BuildSyncNodeReq(sync, peer, subnodes, req);
+    EXPECT_FALSE(req.is_full());
+    EXPECT_EQ(4, req.base_seq());
+    EXPECT_EQ(7, req.seq());
+    EXPECT_EQ(Digest(subnodes), req.digest());
+    std::vector<std::string> expected = {"node2", "node4"};
+    EXPECT_EQ(expected, Base58addrs(req));
+    ASSERT_EQ(1, req.removed_size());
+    EXPECT_EQ(node3->id.ToBase58(), req.removed(0));
+}
+
+TEST(NodeSyncTest, RuntimeChangeIgnored)
+{
+    NodeSync sync;
+    auto node = MakeNode(1);
+    std::vector<std::shared_ptr<const Node>> subnodes = {node};
+    sync.Refresh(subnodes);
+    uint64_t seq = sync.seq();
+    //高度和手续费由心跳和状态广播更新,不产生增量
+    node->runtime->height = 100;
+    node->runtime->sign_fee = 1;
+    node->runtime->package_fee = 2;
+    sync.Refresh(subnodes);
+    EXPECT_EQ(seq, sync.seq());
+    node->listen_port = 11190;
+    sync.Refresh(subnodes);
+    EXPECT_EQ(seq + 1, sync.seq());
+}
+
+TEST(NodeSyncTest, FullWhenAckInvalid)
+{
+    NodeSync sync;
+    NodeId peer = MakeNode(100)->id;
+    std::vector<std::shared_ptr<const Node>> subnodes = {MakeNode(1), MakeNode(2)};
+    sync.Refresh(subnodes);
+
+    //确认的版本比自身新,如对方重启前同步过
+    EXPECT_FALSE(sync.OnSyncNodeAck(peer, sync.seq() + 10));
+    SyncNodeReq req;
+    BuildSyncNodeReq(sync, peer, subnodes, req);
+    EXPECT_TRUE(req.is_full());
+    EXPECT_EQ(2, req.nodes_size());
+
+    //断开后重新全量同步
+    sync.OnSyncNodeAck(peer, sync.seq());
+    sync.RemovePeer(peer);
+    req.Clear();
+    BuildSyncNodeReq(sync, peer, subnodes, req);
+    EXPECT_TRUE(req.is_full());
+}
+
+TEST(NodeSyncTest, Replica)
+{
+    NodeSync sync;
+    NodeId public_id = MakeNode(100)->id;
+    EXPECT_EQ(0, sync.replica_seq(public_id));
+    EXPECT_EQ(0, sync.replica_self_digest(public_id));
+    sync.SetReplica(public_id, 5, 12345);
+    EXPECT_EQ(5, sync.replica_seq(public_id));
+    EXPECT_EQ(12345, sync.replica_self_digest(public_id));
+    sync.RemovePeer(public_id);
+    EXPECT_EQ(0, sync.replica_seq(public_id));
+    EXPECT_EQ(0, sync.replica_self_digest(public_id));
+}
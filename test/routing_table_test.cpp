@@ -0,0 +1,193 @@
+#include "node/routing_table.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <set>
+
+static NodeId MakeId(uint32_t seq)
+{
+    NodeId id;
+    memcpy(id.bytes.data(), &seq, sizeof(seq));
+    id.bytes[kNodeIdSize - 1] = 1;
+    return id;
+}
+
+//与自身距离的最高位即为所在的桶
+static int BucketIndexOf(const std::string &self_key, const std::string &key)
+{
+    std::string distance = RoutingTable::Distance(self_key, key);
+    for (size_t i = 0; i < distance.size(); ++i)
+    {
+        uint8_t byte = distance[i];
+        for (int bit = 7; bit >= 0; --bit)
+        {
+            if (0 != (byte & (1 << bit)))
+            {
+                return (distance.size() - 1 - i) * 8 + bit;
+            }
+        }
+    }
+    return -1;
+}
+
+TEST(RoutingTableTest, Distance)
+{
+    std::string key1 = RoutingTable::GetKey("node1");
+    std::string key2 = RoutingTable::GetKey("node2");
+    ASSERT_EQ(kKeyBits / 8, key1.size());
+    EXPECT_EQ(key1, RoutingTable::GetKey("node1"));
+    EXPECT_EQ(std::string(kKeyBits / 8, '\0'), RoutingTable::Distance(key1, key1));
+    EXPECT_EQ(RoutingTable::Distance(key1, key2), RoutingTable::Distance(key2, key1));
+    EXPECT_EQ(key2, RoutingTable::Distance(RoutingTable::Distance(key1, key2), key1));
+}
+
+TEST(RoutingTableTest, UpdateAndFindClosest)
+{
+    RoutingTable table;
+    table.set_self("self");
+    NodeId probe;
+    //自身不加入路由表
+    table.Update(MakeId(0), "self", "", probe);
+    EXPECT_EQ(0, table.size());
+
+    std::vector<std::string> keys;
+    for (uint32_t i = 1; i <= 10; ++i)
+    {
+        std::string addr = "node" + std::to_string(i);
+        keys.push_back(RoutingTable::GetKey(addr));
+        table.Update(MakeId(i), addr, "info" + std::to_string(i), probe);
+        EXPECT_TRUE(probe.empty());
+    }
+    EXPECT_EQ(10, table.size());
+    //已加入的节点不重复计数
+    table.Update(MakeId(3), "node3", "", probe);
+    EXPECT_EQ(10, table.size());
+
+    std::vector<NodeId> ids;
+    table.FindClosest(keys[2], 1, ids);
+    ASSERT_EQ(1, ids.size());
+    EXPECT_EQ(MakeId(3), ids[0]);
+
+    table.FindClosest(table.self_key(), 20, ids);
+    ASSERT_EQ(10, ids.size());
+    std::vector<std::string> distances;
+    for (auto &id : ids)
+    {
+        uint32_t seq = 0;
+        memcpy(&seq, id.bytes.data(), sizeof(seq));
+        distances.push_back(RoutingTable::Distance(table.self_key(), keys.at(seq - 1)));
+    }
+    EXPECT_TRUE(std::is_sorted(distances.begin(), distances.end()));
+}
+
+TEST(RoutingTableTest, NodeInfo)
+{
+    RoutingTable table;
+    table.set_self("self");
+    NodeId probe;
+    std::string nodeinfo;
+    EXPECT_FALSE(table.GetNodeInfo(MakeId(1), nodeinfo));
+    table.Update(MakeId(1), "node1", "info1", probe);
+    ASSERT_TRUE(table.GetNodeInfo(MakeId(1), nodeinfo));
+    EXPECT_EQ("info1", nodeinfo);
+    //为空时保留原来的值
+    table.Update(MakeId(1), "node1", "", probe);
+    ASSERT_TRUE(table.GetNodeInfo(MakeId(1), nodeinfo));
+    EXPECT_EQ("info1", nodeinfo);
+    table.Update(MakeId(1), "node1", "info2", probe);
+    ASSERT_TRUE(table.GetNodeInfo(MakeId(1), nodeinfo));
+    EXPECT_EQ("info2", nodeinfo);
+
+    table.Update(MakeId(2), "node2", "", probe);
+    EXPECT_FALSE(table.GetNodeInfo(MakeId(2), nodeinfo));
+
+    table.Remove(MakeId(1));
+    EXPECT_FALSE(table.GetNodeInfo(MakeId(1), nodeinfo));
+    EXPECT_EQ(1, table.size());
+}
+
+TEST(RoutingTableTest, FullBucketProbe)
+{
+    RoutingTable table;
+    table.set_self("self");
+    //约一半的key落在最远的桶中
+    std::vector<uint32_t> seqs;
+    for (uint32_t i = 1; seqs.size() < kBucketSize + 2; ++i)
+    {
+        if ((int)kKeyBits - 1 == BucketIndexOf(table.self_key(), RoutingTable::GetKey("node" + std::to_string(i))))
+        {
+            seqs.push_back(i);
+        }
+    }
+    NodeId probe;
+    for (size_t i = 0; i < kBucketSize; ++i)
+    {
+        table.Update(MakeId(seqs[i]), "node" + std::to_string(seqs[i]), "", probe);
+        EXPECT_TRUE(probe.empty());
+    }
+    EXPECT_EQ(kBucketSize, table.size());
+
+    //桶已满时进入候补列表并探测最久未联系的节点
+    uint32_t first = seqs[0];
+    uint32_t replacement1 = seqs[kBucketSize];
+    uint32_t replacement2 = seqs[kBucketSize + 1];
+    table.Update(MakeId(replacement1), "node" + std::to_string(replacement1), "", probe);
+    EXPECT_EQ(MakeId(first), probe);
+    EXPECT_EQ(kBucketSize, table.size());
+    //同一个桶同时只探测一个节点
+    table.Update(MakeId(replacement2), "node" + std::to_string(replacement2), "", probe);
+    EXPECT_TRUE(probe.empty());
+
+    //探测成功时保留原节点
+    table.OnProbe(MakeId(first), true);
+    std::vector<NodeId> ids;
+    table.FindClosest(RoutingTable::GetKey("node" + std::to_string(first)), 1, ids);
+    ASSERT_EQ(1, ids.size());
+    EXPECT_EQ(MakeId(first), ids[0]);
+
+    //探测失败时以最近加入的候补节点补充
+    table.OnProbe(MakeId(first), false);
+    EXPECT_EQ(kBucketSize, table.size());
+    table.FindClosest(RoutingTable::GetKey("node" + std::to_string(replacement2)), 1, ids);
+    ASSERT_EQ(1, ids.size());
+    EXPECT_EQ(MakeId(replacement2), ids[0]);
+    table.FindClosest(RoutingTable::GetKey("node" + std::to_string(first)), 1, ids);
+    ASSERT_EQ(1, ids.size());
+    EXPECT_NE(MakeId(first), ids[0]);
+}
+
+TEST(RoutingTableTest, RefreshBucket)
+{
+    RoutingTable table;
+    table.set_self("self");
+    const uint32_t indexes[] = {0, 1, 7, 8, 9, 100, 254, 255};
+    for (auto index : indexes)
+    {
+        for (int i = 0; i < 10; ++i)
+        {
+            EXPECT_EQ((int)index, BucketIndexOf(table.self_key(), table.RefreshBucket(index))) << index;
+        }
+    }
+}
+
+TEST(RoutingTableTest, StaleBuckets)
+{
+    RoutingTable table;
+    table.set_self("self");
+    std::vector<uint32_t> indexes;
+    //空桶不需要刷新
+    table.GetStaleBuckets(std::chrono::seconds(0), indexes);
+    EXPECT_TRUE(indexes.empty());
+
+    NodeId probe;
+    std::set<uint32_t> expected;
+    for (uint32_t i = 1; i <= 10; ++i)
+    {
+        std::string addr = "node" + std::to_string(i);
+        table.Update(MakeId(i), addr, "", probe);
+        expected.insert(BucketIndexOf(table.self_key(), RoutingTable::GetKey(addr)));
+    }
+    table.GetStaleBuckets(std::chrono::seconds(0), indexes);
+    EXPECT_EQ(expected, std::set<uint32_t>(indexes.begin(), indexes.end()));
+    table.GetStaleBuckets(std::chrono::seconds(3600), indexes);
+    EXPECT_TRUE(indexes.empty());
+}
@@ -0,0 +1,129 @@
+#include "proto/node.pb.h"
+#include "socket/rpc.h"
+#include "socket/socket_manager.h"
+#include "utils/singleton.hpp"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+class RpcTest : public testing::Test
+{
+protected:
+    static void SetUpTestSuite() { Singleton<RpcManager>::instance()->ThreadStart(); }
+    static void TearDownTestSuite() { Singleton<RpcManager>::instance()->ThreadStop(); }
+};
+
+static MsgData MakeResponse(std::shared_ptr<google::protobuf::Message> rsp, std::shared_ptr<SocketConnection> connection, uint64_t correlation_id)
+{
+    MsgData msg;
+    msg.msg = rsp;
+    msg.connection = connection;
+    msg.correlation_id = correlation_id;
+    msg.is_response = true;
+    return msg;
+}
+
+TEST_F(RpcTest, ResponseDeliveredOnce)
+{
+    auto rpc = Singleton<RpcManager>::instance();
+    auto connection = std::make_shared<SocketConnection>();
+    std::atomic<int> calls(0);
+    int result = 1;
+    size_t pending = rpc->pending_size();
+    uint64_t correlation_id = rpc->AddPendingCall<EchoAck>("EchoReq", 10 * 1000, connection->connection_id(), [&](int ret, const std::shared_ptr<EchoAck> &rsp)
+                                                            {
+                                                                result = ret;
+                                                                ++calls; });
+    EXPECT_NE(0, correlation_id);
+    EXPECT_EQ(pending + 1, rpc->pending_size());
+
+    auto response = MakeResponse(std::make_shared<EchoAck>(), connection, correlation_id);
+    EXPECT_TRUE(rpc->OnResponse(response));
+    EXPECT_EQ(1, calls);
+    EXPECT_EQ(kRpc_Success, result);
+    EXPECT_EQ(pending, rpc->pending_size());
+
+    //重复的回复直接丢弃
+    EXPECT_TRUE(rpc->OnResponse(response));
+    EXPECT_EQ(1, calls);
+}
+
+TEST_F(RpcTest, NotResponse)
+{
+    auto rpc = Singleton<RpcManager>::instance();
+    auto connection = std::make_shared<SocketConnection>();
+    auto request = MakeResponse(std::make_shared<EchoReq>(), connection, 1);
+    request.is_response = false;
+    EXPECT_FALSE(rpc->OnResponse(request));
+    auto response = MakeResponse(std::make_shared<EchoAck>(), connection, 0);
+    EXPECT_FALSE(rpc->OnResponse(response));
+}
+
+TEST_F(RpcTest, DropUnexpectedConnection)
+{
+    auto rpc = Singleton<RpcManager>::instance();
+    auto connection = std::make_shared<SocketConnection>();
+    auto other = std::make_shared<SocketConnection>();
+    std::atomic<int> calls(0);
+    size_t pending = rpc->pending_size();
+    uint64_t correlation_id = rpc->AddPendingCall<EchoAck>("EchoReq", 10 * 1000, connection->connection_id(), [&](int ret, const std::shared_ptr<EchoAck> &rsp)
+                                                            { ++calls; });
+    EXPECT_TRUE(rpc->OnResponse(MakeResponse(std::make_shared<EchoAck>(), other, correlation_id)));
+    EXPECT_EQ(0, calls);
+    EXPECT_EQ(pending + 1, rpc->pending_size());
+
+    //经TransMsgReq转发的回复以转发的连接为来源
+    auto relay = MakeResponse(std::make_shared<EchoAck>(), nullptr, correlation_id);
+    relay.relay_connection_id = connection->connection_id();
+    EXPECT_TRUE(rpc->OnResponse(relay));
+    EXPECT_EQ(1, calls);
+    EXPECT_EQ(pending, rpc->pending_size());
+}
+
+TEST_F(RpcTest, WrongType)
+{
+    auto rpc = Singleton<RpcManager>::instance();
+    auto connection = std::make_shared<SocketConnection>();
+    int result = 1;
+    uint64_t correlation_id = rpc->AddPendingCall<EchoAck>("EchoReq", 10 * 1000, connection->connection_id(), [&](int ret, const std::shared_ptr<EchoAck> &rsp)
+                                                            { result = ret; });
+    EXPECT_TRUE(rpc->OnResponse(MakeResponse(std::make_shared<EchoReq>(), connection, correlation_id)));
+    EXPECT_EQ(kRpc_WrongType, result);
+}
+
+TEST_F(RpcTest, CancelPendingCall)
+{
+    auto rpc = Singleton<RpcManager>::instance();
+    auto connection = std::make_shared<SocketConnection>();
+    std::atomic<int> calls(0);
+    size_t pending = rpc->pending_size();
+    uint64_t correlation_id = rpc->AddPendingCall<EchoAck>("EchoReq", 20, connection->connection_id(), [&](int ret, const std::shared_ptr<EchoAck> &rsp)
+                                                            { ++calls; });
+    rpc->CancelPendingCall(correlation_id);
+    EXPECT_EQ(pending, rpc->pending_size());
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(0, calls);
+}
+
+TEST_F(RpcTest, TimeoutThenLateResponse)
+{
+    auto rpc = Singleton<RpcManager>::instance();
+    auto connection = std::make_shared<SocketConnection>();
+    std::atomic<int> calls(0);
+    std::atomic<int> result(1);
+    uint64_t correlation_id = rpc->AddPendingCall<EchoAck>("EchoReq", 20, connection->connection_id(), [&](int ret, const std::shared_ptr<EchoAck> &rsp)
+                                                            {
+                                                                result = ret;
+                                                                ++calls; });
+    for (int i = 0; i < 100 && 0 == calls; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(1, calls);
+    EXPECT_EQ(kRpc_Timeout, result);
+
+    //超时后到达的回复不能再交给处理函数
+    EXPECT_TRUE(rpc->OnResponse(MakeResponse(std::make_shared<EchoAck>(), connection, correlation_id)));
+    EXPECT_EQ(1, calls);
+}
@@ -0,0 +1,147 @@
+#include "proto/node.pb.h"
+#include "socket/socket_manager.h"
+#include "socket/strand.h"
+#include <gtest/gtest.h>
+#include <array>
+#include <chrono>
+#include <string>
+
+static MsgData MakeMsg(std::shared_ptr<SocketConnection> connection, const std::string &tag, Priority priority, bool ordered = true)
+{
+    MsgData msg;
+    auto echo = std::make_shared<EchoReq>();
+    echo->set_base58addr(tag);
+    msg.msg = echo;
+    msg.connection = connection;
+    msg.ordered = ordered;
+    msg.priority = priority;
+    return msg;
+}
+
+static std::string Tag(const MsgData &msg)
+{
+    return std::static_pointer_cast<EchoReq>(msg.msg)->base58addr();
+}
+
+TEST(StrandQueueTest, OrderedPerConnection)
+{
+    StrandQueue queue;
+    auto connection1 = std::make_shared<SocketConnection>();
+    auto connection2 = std::make_shared<SocketConnection>();
+    queue.Push(MakeMsg(connection1, "1-1", Priority::kPriority_Middle_0));
+    queue.Push(MakeMsg(connection1, "1-2", Priority::kPriority_Middle_0));
+    queue.Push(MakeMsg(connection2, "2-1", Priority::kPriority_Middle_0));
+    EXPECT_EQ(3, queue.size());
+
+    std::shared_ptr<Strand> strand1;
+    std::shared_ptr<Strand> strand2;
+    MsgData msg;
+    uint64_t wait_us = 0;
+    ASSERT_TRUE(queue.Pop(strand1, msg, wait_us));
+    EXPECT_EQ("1-1", Tag(msg));
+    //连接1的消息执行中,只能调度其他连接
+    ASSERT_TRUE(queue.Pop(strand2, msg, wait_us));
+    EXPECT_EQ("2-1", Tag(msg));
+    std::shared_ptr<Strand> other;
+    EXPECT_FALSE(queue.Pop(other, msg, wait_us));
+
+    queue.Done(strand1);
+    ASSERT_TRUE(queue.Pop(other, msg, wait_us));
+    EXPECT_EQ(strand1, other);
+    EXPECT_EQ("1-2", Tag(msg));
+    queue.Done(other);
+    queue.Done(strand2);
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(0, queue.size());
+}
+
+TEST(StrandQueueTest, UnorderedRunsConcurrently)
+{
+    StrandQueue queue;
+    auto connection = std::make_shared<SocketConnection>();
+    queue.Push(MakeMsg(connection, "1", Priority::kPriority_Middle_0, false));
+    queue.Push(MakeMsg(connection, "2", Priority::kPriority_Middle_0, false));
+
+    std::shared_ptr<Strand> strand1;
+    std::shared_ptr<Strand> strand2;
+    MsgData msg;
+    uint64_t wait_us = 0;
+    ASSERT_TRUE(queue.Pop(strand1, msg, wait_us));
+    ASSERT_TRUE(queue.Pop(strand2, msg, wait_us));
+    EXPECT_NE(strand1, strand2);
+}
+
+TEST(StrandQueueTest, WeightedFairness)
+{
+    StrandQueue queue;
+    queue.SetAgingTime(3600 * 1000);
+    for (int i = 0; i < 100; ++i)
+    {
+        queue.Push(MakeMsg(nullptr, "low", Priority::kPriority_Low_0));
+        queue.Push(MakeMsg(nullptr, "high", Priority::kPriority_High_0));
+    }
+    //高优先级权重16,低优先级权重1
+    int low = 0;
+    int high = 0;
+    for (int i = 0; i < 34; ++i)
+    {
+        std::shared_ptr<Strand> strand;
+        MsgData msg;
+        uint64_t wait_us = 0;
+        ASSERT_TRUE(queue.Pop(strand, msg, wait_us));
+        if ("low" == Tag(msg))
+        {
+            ++low;
+        }
+        else
+        {
+            ++high;
+        }
+        queue.Done(strand);
+    }
+    EXPECT_EQ(2, low);
+    EXPECT_EQ(32, high);
+
+    std::array<ScheduleStats, kPriorityBand_Count> stats;
+    queue.GetStats(stats);
+    EXPECT_EQ(2, stats[kPriorityBand_Low].dispatched);
+    EXPECT_EQ(98, stats[kPriorityBand_Low].queued);
+    EXPECT_EQ(0, stats[kPriorityBand_Low].aged);
+}
+
+TEST(StrandQueueTest, AgingBoundedByStride)
+{
+    StrandQueue queue;
+    queue.SetAgingTime(0);
+    auto now = std::chrono::steady_clock::now();
+    for (int i = 0; i < 100; ++i)
+    {
+        auto low = MakeMsg(nullptr, "low", Priority::kPriority_Low_0);
+        low.recv_time = now - std::chrono::seconds(10);
+        queue.Push(low);
+        auto high = MakeMsg(nullptr, "high", Priority::kPriority_High_0);
+        high.recv_time = now - std::chrono::seconds(1);
+        queue.Push(high);
+    }
+    //所有消息都已超时,低优先级的更早,但老化调度不能领先加权公平调度超过一个步长
+    int low = 0;
+    for (int i = 0; i < 34; ++i)
+    {
+        std::shared_ptr<Strand> strand;
+        MsgData msg;
+        uint64_t wait_us = 0;
+        ASSERT_TRUE(queue.Pop(strand, msg, wait_us));
+        if ("low" == Tag(msg))
+        {
+            ++low;
+        }
+        queue.Done(strand);
+    }
+    EXPECT_GE(low, 1);
+    EXPECT_LE(low, 3);
+
+    std::array<ScheduleStats, kPriorityBand_Count> stats;
+    queue.GetStats(stats);
+    EXPECT_GT(stats[kPriorityBand_Low].aged, 0);
+    EXPECT_GE(stats[kPriorityBand_Low].max_wait_us, 10 * 1000 * 1000);
+}
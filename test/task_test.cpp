@@ -0,0 +1,145 @@
+#include "proto/node.pb.h"
+#include "socket/rpc.h"
+#include "socket/socket_manager.h"
+#include "socket/strand.h"
+#include "socket/task.h"
+#include "socket/work_pool.h"
+#include "utils/singleton.hpp"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static MsgData MakeMsg(std::shared_ptr<SocketConnection> connection, int seq)
+{
+    MsgData msg;
+    auto echo = std::make_shared<EchoReq>();
+    echo->set_base58addr(std::to_string(seq));
+    msg.msg = echo;
+    msg.connection = connection;
+    msg.ordered = true;
+    msg.priority = Priority::kPriority_Middle_0;
+    return msg;
+}
+
+static MsgData MakeClosure()
+{
+    MsgData msg;
+    msg.priority = Priority::kPriority_Middle_0;
+    msg.closure = []() {};
+    return msg;
+}
+
+TEST(StrandQueueTest, SuspendKeepsStrand)
+{
+    StrandQueue queue;
+    auto connection = std::make_shared<SocketConnection>();
+    queue.Push(MakeMsg(connection, 1));
+    queue.Push(MakeMsg(connection, 2));
+
+    std::shared_ptr<Strand> strand;
+    MsgData msg;
+    uint64_t wait_us = 0;
+    ASSERT_TRUE(queue.Pop(strand, msg, wait_us));
+    queue.Suspend(strand);
+    //挂起期间同一连接的下一条消息不能执行
+    std::shared_ptr<Strand> other;
+    EXPECT_FALSE(queue.Pop(other, msg, wait_us));
+
+    queue.PushFront(strand, MakeClosure());
+    ASSERT_TRUE(queue.Pop(other, msg, wait_us));
+    EXPECT_EQ(strand, other);
+    EXPECT_NE(nullptr, msg.closure);
+    queue.Done(other);
+
+    ASSERT_TRUE(queue.Pop(other, msg, wait_us));
+    EXPECT_EQ(strand, other);
+    EXPECT_EQ("2", std::static_pointer_cast<EchoReq>(msg.msg)->base58addr());
+}
+
+TEST(StrandQueueTest, ResumeBeforeSuspendReturns)
+{
+    StrandQueue queue;
+    auto connection = std::make_shared<SocketConnection>();
+    queue.Push(MakeMsg(connection, 1));
+
+    std::shared_ptr<Strand> strand;
+    MsgData msg;
+    uint64_t wait_us = 0;
+    ASSERT_TRUE(queue.Pop(strand, msg, wait_us));
+    //处理函数还在执行时就被恢复,不能在其他线程中同时执行
+    queue.PushFront(strand, MakeClosure());
+    std::shared_ptr<Strand> other;
+    EXPECT_FALSE(queue.Pop(other, msg, wait_us));
+
+    queue.Suspend(strand);
+    ASSERT_TRUE(queue.Pop(other, msg, wait_us));
+    EXPECT_EQ(strand, other);
+    EXPECT_NE(nullptr, msg.closure);
+    queue.Done(other);
+    EXPECT_TRUE(queue.empty());
+}
+
+class TaskTest : public testing::Test
+{
+protected:
+    static void SetUpTestSuite() { Singleton<RpcManager>::instance()->ThreadStart(); }
+    static void TearDownTestSuite() { Singleton<RpcManager>::instance()->ThreadStop(); }
+};
+
+//回复在await_suspend返回前到达,然后再挂起等待定时器,两次都在原strand中恢复
+static Task EchoTask(int seq, std::atomic<bool> &in_suspend, std::mutex &mutex, std::vector<std::string> &out_events)
+{
+    auto record = [&mutex, &out_events, seq](const std::string &event)
+    {
+        std::lock_guard<std::mutex> lck(mutex);
+        out_events.push_back(std::to_string(seq) + event);
+    };
+    record("start");
+    auto result = co_await RpcAwaiter<EchoAck>([&in_suspend](RpcCallback<EchoAck> cb)
+                                               {
+                                                   in_suspend = true;
+                                                   cb(0, std::make_shared<EchoAck>());
+                                                   std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                                                   in_suspend = false;
+                                                   return 0; });
+    if (in_suspend)
+    {
+        record("overlap");
+    }
+    record(0 == result.ret ? "reply" : "fail");
+    co_await SleepFor(10);
+    record("done");
+    co_return 0;
+}
+
+TEST_F(TaskTest, ResumeOnSameStrand)
+{
+    std::atomic<bool> in_suspend(false);
+    std::mutex mutex;
+    std::vector<std::string> events;
+    std::atomic<int> done(0);
+    WorkPool pool("task_test", [&](const MsgData &msg)
+                  {
+                      int seq = std::stoi(std::static_pointer_cast<EchoReq>(msg.msg)->base58addr());
+                      EchoTask(seq, in_suspend, mutex, events).Start(msg, [&done](int ret)
+                                                                      { ++done; }); });
+    pool.ThreadStart(4);
+    auto connection = std::make_shared<SocketConnection>();
+    pool.AddProcessData(MakeMsg(connection, 1));
+    pool.AddProcessData(MakeMsg(connection, 2));
+    for (int i = 0; i < 200 && done < 2; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    pool.ThreadStop();
+    //等待工作线程退出后再销毁线程池
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_EQ(2, done);
+
+    //同一连接的第二条消息在第一条的协程完成后才开始
+    std::vector<std::string> expected = {"1start", "1reply", "1done", "2start", "2reply", "2done"};
+    EXPECT_EQ(expected, events);
+}
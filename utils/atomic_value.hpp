@@ -0,0 +1,36 @@
+#ifndef UENC_UTILS_ATOMIC_VALUE_HPP_
+#define UENC_UTILS_ATOMIC_VALUE_HPP_
+
+#include <atomic>
+#include <utility>
+
+//可以复制的原子变量,复制时读取当前值
+//用于需要原地并发修改的字段,修改不影响对象的其他字段
+template <typename T>
+class AtomicValue
+{
+public:
+    AtomicValue() : value_(T()) {}
+    AtomicValue(T value) : value_(std::move(value)) {}
+    AtomicValue(const AtomicValue &other) : value_(other.load()) {}
+    AtomicValue &operator=(const AtomicValue &other)
+    {
+        store(other.load());
+        return *this;
+    }
+    AtomicValue &operator=(T value)
+    {
+        store(std::move(value));
+        return *this;
+    }
+
+    T load() const { return value_.load(std::memory_order_acquire); }
+    void store(T value) { value_.store(std::move(value), std::memory_order_release); }
+    T exchange(T value) { return value_.exchange(std::move(value), std::memory_order_acq_rel); }
+    operator T() const { return load(); }
+
+private:
+    std::atomic<T> value_;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include "utils/histogram.h"
+#include <cmath>
+
+Histogram::Histogram()
+{
+    Clear();
+}
+
+void Histogram::Record(uint64_t value)
+{
+    buckets_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+    uint64_t max = max_.load(std::memory_order_relaxed);
+    while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+void Histogram::Clear()
+{
+    for (auto &bucket : buckets_)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::Percentile(double percentile) const
+{
+    uint64_t total = count();
+    if (0 == total)
+    {
+        return 0;
+    }
+    if (percentile < 0)
+    {
+        percentile = 0;
+    }
+    if (percentile > 100)
+    {
+        percentile = 100;
+    }
+    uint64_t rank = (uint64_t)std::ceil(percentile / 100 * total);
+    if (0 == rank)
+    {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < kBucketCount; ++i)
+    {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+        {
+            uint64_t upper = BucketUpperBound(i);
+            return upper < max() ? upper : max();
+        }
+    }
+    return max();
+}
+
+uint32_t Histogram::BucketIndex(uint64_t value)
+{
+    if (value < kSubBucketCount)
+    {
+        return (uint32_t)value;
+    }
+    uint32_t msb = 63 - __builtin_clzll(value);
+    uint32_t shift = msb - kSubBucketBits;
+    return (msb - kSubBucketBits + 1) * kSubBucketCount + (uint32_t)((value >> shift) & (kSubBucketCount - 1));
+}
+
+uint64_t Histogram::BucketUpperBound(uint32_t index)
+{
+    if (index < kSubBucketCount)
+    {
+        return index;
+    }
+    uint32_t shift = index / kSubBucketCount - 1;
+    uint64_t sub = index % kSubBucketCount;
+    uint64_t lower = (kSubBucketCount + sub) << shift;
+    return lower + ((uint64_t)1 << shift) - 1;
+}
@@ -0,0 +1,41 @@
+#ifndef UENC_UTILS_HISTOGRAM_H_
+#define UENC_UTILS_HISTOGRAM_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+//无锁的对数分段直方图,相对误差不超过1/8
+class Histogram
+{
+public:
+    Histogram();
+    ~Histogram() = default;
+    Histogram(Histogram &&) = delete;
+    Histogram(const Histogram &) = delete;
+    Histogram &operator=(Histogram &&) = delete;
+    Histogram &operator=(const Histogram &) = delete;
+
+    void Record(uint64_t value);
+    void Clear();
+    //percentile取值范围[0, 100]
+    uint64_t Percentile(double percentile) const;
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+private:
+    static const uint32_t kSubBucketBits = 3;
+    static const uint32_t kSubBucketCount = 1 << kSubBucketBits;
+    static const uint32_t kBucketCount = (64 - kSubBucketBits + 1) * kSubBucketCount;
+    static uint32_t BucketIndex(uint64_t value);
+    static uint64_t BucketUpperBound(uint32_t index);
+
+    std::array<std::atomic<uint64_t>, kBucketCount> buckets_;
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+};
+
+#endif
@@ -0,0 +1,66 @@
+#include "utils/interned_string.h"
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+//池中的字符串数超过该值时清理不再使用的
+static const size_t kMinPurgeSize = 64;
+
+static std::mutex g_pool_mutex;
+static std::unordered_map<std::string, std::weak_ptr<const std::string>> g_pool;
+static size_t g_purge_size = kMinPurgeSize;
+
+static const std::shared_ptr<const std::string> &EmptyString()
+{
+    static const std::shared_ptr<const std::string> empty = std::make_shared<const std::string>();
+    return empty;
+}
+
+static std::shared_ptr<const std::string> Intern(const std::string &str)
+{
+    if (str.empty())
+    {
+        return EmptyString();
+    }
+    std::lock_guard<std::mutex> lck(g_pool_mutex);
+    auto &item = g_pool[str];
+    auto interned = item.lock();
+    if (nullptr != interned)
+    {
+        return interned;
+    }
+    interned = std::make_shared<const std::string>(str);
+    item = interned;
+    if (g_pool.size() >= g_purge_size)
+    {
+        for (auto it = g_pool.begin(); it != g_pool.end();)
+        {
+            if (it->second.expired())
+            {
+                it = g_pool.erase(it);
+                continue;
+            }
+            ++it;
+        }
+        g_purge_size = std::max(kMinPurgeSize, g_pool.size() * 2);
+    }
+    return interned;
+}
+
+InternedString::InternedString() : str_(EmptyString())
+{
+}
+
+InternedString::InternedString(const std::string &str) : str_(Intern(str))
+{
+}
+
+InternedString &InternedString::operator=(const std::string &str)
+{
+    //更新节点时版本号通常不变
+    if (*str_ != str)
+    {
+        str_ = Intern(str);
+    }
+    return *this;
+}
@@ -0,0 +1,25 @@
+#ifndef UENC_UTILS_INTERNED_STRING_H_
+#define UENC_UTILS_INTERNED_STRING_H_
+
+#include <memory>
+#include <string>
+
+//内容相同的字符串共享同一份数据,用于大量重复的短字符串,如节点的版本号
+class InternedString
+{
+public:
+    InternedString();
+    InternedString(const std::string &str);
+    InternedString &operator=(const std::string &str);
+
+    const std::string &str() const { return *str_; }
+    operator const std::string &() const { return *str_; }
+    bool empty() const { return str_->empty(); }
+    bool operator==(const InternedString &other) const { return str_ == other.str_; }
+    bool operator!=(const InternedString &other) const { return str_ != other.str_; }
+
+private:
+    std::shared_ptr<const std::string> str_;
+};
+
+#endif
@@ -1,6 +1,8 @@
 #include "net_utils.h"
 #include <errno.h>
+#include <chrono>
 #include <ifaddrs.h>
+#include <poll.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -107,3 +109,85 @@ bool Str2IntIPv6(const std::string &ip, uint8_t out[16])
     }
     return true;
 }
+
+void ProbeConnectTime(const std::vector<std::pair<in_addr_t, in_port_t>> &addrs, uint32_t timeout_ms, std::vector<uint32_t> &out_times)
+{
+    out_times.assign(addrs.size(), UINT32_MAX);
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed_us = [&start]()
+    {
+        return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    };
+    std::vector<struct pollfd> fds(addrs.size());
+    size_t pending = 0;
+    for (size_t i = 0; i < addrs.size(); ++i)
+    {
+        fds[i].fd = -1;
+        fds[i].events = POLLOUT;
+        fds[i].revents = 0;
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            continue;
+        }
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = addrs[i].first;
+        addr.sin_port = htons(addrs[i].second);
+        if (0 == connect(fd, (struct sockaddr *)&addr, sizeof(addr)))
+        {
+            out_times[i] = elapsed_us();
+            close(fd);
+            continue;
+        }
+        if (EINPROGRESS != errno)
+        {
+            close(fd);
+            continue;
+        }
+        fds[i].fd = fd;
+        ++pending;
+    }
+    while (pending > 0)
+    {
+        int remaining = (int)timeout_ms - (int)(elapsed_us() / 1000);
+        if (remaining <= 0)
+        {
+            break;
+        }
+        int ret = poll(fds.data(), fds.size(), remaining);
+        if (ret < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if (ret <= 0)
+        {
+            break;
+        }
+        uint32_t now = elapsed_us();
+        for (size_t i = 0; i < fds.size(); ++i)
+        {
+            if (fds[i].fd < 0 || 0 == fds[i].revents)
+            {
+                continue;
+            }
+            int error = 0;
+            socklen_t len = sizeof(error);
+            if (0 == getsockopt(fds[i].fd, SOL_SOCKET, SO_ERROR, &error, &len) && 0 == error)
+            {
+                out_times[i] = now;
+            }
+            close(fds[i].fd);
+            fds[i].fd = -1;
+            --pending;
+        }
+    }
+    for (auto &item : fds)
+    {
+        if (item.fd >= 0)
+        {
+            close(item.fd);
+        }
+    }
+}
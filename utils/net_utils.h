@@ -14,4 +14,8 @@ bool Str2IntIPv4(const std::string &ip, in_addr_t &out);
 
 bool Int2StrIPv6(uint8_t ip[16], std::string &out);
 bool Str2IntIPv6(const std::string &ip, uint8_t out[16]);
+
+//并行向各地址(网络字节序ip,主机字节序端口)发起tcp连接
+//out_times为各地址建立连接的时间(微秒),失败或超时为UINT32_MAX
+void ProbeConnectTime(const std::vector<std::pair<in_addr_t, in_port_t>> &addrs, uint32_t timeout_ms, std::vector<uint32_t> &out_times);
 #endif
@@ -0,0 +1,77 @@
+#include "thread_utils.h"
+#include <fstream>
+#include <sched.h>
+#include <sstream>
+
+static bool ParseCpuList(const std::string &list, std::vector<int> &out_cpus)
+{
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (item.empty())
+        {
+            continue;
+        }
+        try
+        {
+            size_t pos = item.find('-');
+            int first = std::stoi(item.substr(0, pos));
+            int last = (std::string::npos == pos) ? first : std::stoi(item.substr(pos + 1));
+            if (first < 0 || last < first || last >= CPU_SETSIZE)
+            {
+                return false;
+            }
+            for (int cpu = first; cpu <= last; ++cpu)
+            {
+                out_cpus.push_back(cpu);
+            }
+        }
+        catch (...)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ParseCpuSet(const std::string &spec, std::vector<int> &out_cpus)
+{
+    out_cpus.clear();
+    if (0 == spec.compare(0, 4, "node"))
+    {
+        std::ifstream file("/sys/devices/system/node/" + spec + "/cpulist");
+        std::string list;
+        if (!std::getline(file, list))
+        {
+            return false;
+        }
+        return ParseCpuList(list, out_cpus) && !out_cpus.empty();
+    }
+    return ParseCpuList(spec, out_cpus) && !out_cpus.empty();
+}
+
+bool SetThreadAffinity(pthread_t thread, const std::vector<int> &cpus)
+{
+    if (cpus.empty())
+    {
+        return false;
+    }
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (auto cpu : cpus)
+    {
+        CPU_SET(cpu, &cpu_set);
+    }
+    return 0 == pthread_setaffinity_np(thread, sizeof(cpu_set), &cpu_set);
+}
+
+bool SetThreadAffinity(pthread_t thread, const std::string &spec)
+{
+    std::vector<int> cpus;
+    if (!ParseCpuSet(spec, cpus))
+    {
+        return false;
+    }
+    return SetThreadAffinity(thread, cpus);
+}
@@ -0,0 +1,13 @@
+#ifndef UENC_UTILS_THREAD_UTILS_H_
+#define UENC_UTILS_THREAD_UTILS_H_
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+//解析cpu列表,支持"0-3,8"和"node0"(该NUMA节点上的所有cpu)
+bool ParseCpuSet(const std::string &spec, std::vector<int> &out_cpus);
+//将线程绑定到指定的cpu
+bool SetThreadAffinity(pthread_t thread, const std::vector<int> &cpus);
+bool SetThreadAffinity(pthread_t thread, const std::string &spec);
+#endif